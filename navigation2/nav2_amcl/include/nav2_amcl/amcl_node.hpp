@@ -22,6 +22,7 @@
 #define NAV2_AMCL__AMCL_NODE_HPP_
 
 #include <atomic>
+#include <future>
 #include <map>
 #include <memory>
 #include <string>
@@ -81,11 +82,36 @@ protected:
 
   // Map-related
   void mapReceived(const nav_msgs::msg::OccupancyGrid::SharedPtr msg);
-  void handleMapMessage(const nav_msgs::msg::OccupancyGrid & msg);
-  void createFreeSpaceVector();
-  void freeMapDependentMemory();
+  void handleMapMessage(const nav_msgs::msg::OccupancyGrid::SharedPtr & msg);
+  void createFreeSpaceVector(map_t * map, std::vector<std::pair<int, int>> & indices);
+  // Compute the map distances for the likelihood field models, or load them from the cache
+  void updateCspace(map_t * map);
+  // Precompute the ranges from each free cell for the beam model
+  void updateRangeTable(map_t * map);
   map_t * map_{nullptr};
   map_t * convertMap(const nav_msgs::msg::OccupancyGrid & map_msg);
+
+  // Everything that depends on the map, built for a new map by a map update
+  struct MapData
+  {
+    ~MapData();
+    map_t * map{nullptr};
+    std::vector<std::pair<int, int>> free_space_indices;
+    std::vector<nav2_amcl::Laser *> lasers;  ///< Models of the lasers in lasers_
+  };
+  // Build the data of a new map on a background thread, while the filter keeps running
+  // on the current map
+  void startMapUpdate(const nav_msgs::msg::OccupancyGrid::SharedPtr & msg);
+  std::unique_ptr<MapData> buildMapData(
+    nav_msgs::msg::OccupancyGrid::SharedPtr msg, std::vector<pf_vector_t> laser_poses);
+  // Switch to the new map once its data is built. Called for each scan and global
+  // localization request, and polled by map_update_timer_.
+  void checkMapUpdate();
+  rclcpp::TimerBase::SharedPtr map_update_timer_;
+  std::future<std::unique_ptr<MapData>> map_update_;
+  // The latest map received while another was being built
+  nav_msgs::msg::OccupancyGrid::SharedPtr pending_map_;
+
   bool first_map_only_{true};
   std::atomic<bool> first_map_received_{false};
   amcl_hyp_t * initial_pose_hyp_;
@@ -166,7 +192,7 @@ protected:
 
   // Laser scan related
   void initLaserScan();
-  nav2_amcl::Laser * createLaserObject();
+  nav2_amcl::Laser * createLaserObject(map_t * map);
   int scan_error_count_{0};
   std::vector<nav2_amcl::Laser *> lasers_;
   std::vector<bool> lasers_update_;
@@ -218,16 +244,20 @@ protected:
   double alpha4_;
   double alpha5_;
   std::string base_frame_id_;
+  int beam_range_table_angles_;
+  double beam_range_table_max_memory_;
   double beam_skip_distance_;
   double beam_skip_error_threshold_;
   double beam_skip_threshold_;
   bool do_beamskip_;
+  std::string cspace_cache_dir_;
   std::string global_frame_id_;
   double lambda_short_;
   double laser_likelihood_max_dist_;
   double laser_max_range_;
   double laser_min_range_;
   std::string sensor_model_type_;
+  int sensor_model_threads_;
   int max_beams_;
   int max_particles_;
   int min_particles_;
@@ -236,6 +266,7 @@ protected:
   double pf_z_;
   double alpha_fast_;
   double alpha_slow_;
+  int random_seed_;
   int resample_interval_;
   std::string robot_model_type_;
   tf2::Duration save_pose_period_;
@@ -28,6 +28,7 @@
 #ifndef NAV2_AMCL__MAP__MAP_HPP_
 #define NAV2_AMCL__MAP__MAP_HPP_
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -42,20 +43,6 @@ struct _rtk_fig_t;
 #define MAP_WIFI_MAX_LEVELS 8
 
 
-// Description for a single map cell.
-typedef struct
-{
-  // Occupancy state (-1 = free, 0 = unknown, +1 = occ)
-  int occ_state;
-
-  // Distance to the nearest occupied cell
-  double occ_dist;
-
-  // Wifi levels
-  // int wifi_levels[MAP_WIFI_MAX_LEVELS];
-} map_cell_t;
-
-
 // Description for a map
 typedef struct
 {
@@ -68,12 +55,32 @@ typedef struct
   // Map dimensions (number of cells)
   int size_x, size_y;
 
-  // The map data, stored as a grid
-  map_cell_t * cells;
+  // Occupancy state of the cells as two bitmaps, one bit per cell: occupied
+  // cells and free cells. Cells in neither are unknown.
+  uint8_t * occ_bits;
+  uint8_t * free_bits;
+
+  // Distance of each cell to the nearest occupied cell, allocated by
+  // map_update_cspace() or mapped from a file by map_load_cspace()
+  float * occ_dist;
+  void * occ_dist_mapping;
+  size_t occ_dist_mapping_size;
 
   // Max distance at which we care about obstacles, for constructing
   // likelihood field
   double max_occ_dist;
+
+  // Ranges precomputed by map_update_range_table() or mapped from a file by
+  // map_load_range_table(), from the free cells at range_table_angles evenly
+  // spaced angles. range_table_rows has the row of range_table of each cell, or
+  // -1 for cells that are not free. Ranges are in units of
+  // range_table_max_range / UINT16_MAX.
+  uint16_t * range_table;
+  int32_t * range_table_rows;
+  int range_table_angles;
+  double range_table_max_range;
+  void * range_table_mapping;
+  size_t range_table_mapping_size;
 } map_t;
 
 
@@ -87,8 +94,11 @@ map_t * map_alloc(void);
 // Destroy a map
 void map_free(map_t * map);
 
-// Get the cell at the given point
-map_cell_t * map_get_cell(map_t * map, double ox, double oy, double oa);
+// Allocate the occupancy bitmaps for a map of size_x * size_y cells, all unknown
+void map_alloc_cells(map_t * map);
+
+// Set the occupancy state (-1 = free, 0 = unknown, +1 = occ) of the cell at an index
+void map_set_occ_state(map_t * map, int index, int occ_state);
 
 // Load an occupancy map
 int map_load_occ(map_t * map, const char * filename, double scale, int negate);
@@ -99,6 +109,19 @@ int map_load_occ(map_t * map, const char * filename, double scale, int negate);
 // Update the cspace distances
 void map_update_cspace(map_t * map, double max_occ_dist);
 
+// Hash of everything the cspace distances depend on, to key cached distances
+uint64_t map_cspace_key(map_t * map, double max_occ_dist);
+
+// Map the cspace distances of a map from a file written by map_save_cspace().
+// Fails, returning -1, if the file is missing or was written for another key.
+int map_load_cspace(map_t * map, double max_occ_dist, uint64_t key, const char * filename);
+
+// Save the cspace distances of a map to a file
+int map_save_cspace(map_t * map, uint64_t key, const char * filename);
+
+// Free the cspace distances of a map
+void map_free_cspace(map_t * map);
+
 
 /**************************************************************************
  * Range functions
@@ -107,6 +130,32 @@ void map_update_cspace(map_t * map, double max_occ_dist);
 // Extract a single range reading from the map
 double map_calc_range(map_t * map, double ox, double oy, double oa, double max_range);
 
+// Precompute the range from every free cell at angle_count evenly spaced angles,
+// up to max_range. Returns -1, leaving the map without a table, if the table
+// cannot be allocated.
+int map_update_range_table(map_t * map, int angle_count, double max_range);
+
+// Free the precomputed ranges of a map
+void map_free_range_table(map_t * map);
+
+// Number of bytes map_update_range_table() allocates for a map
+size_t map_range_table_size(map_t * map, int angle_count);
+
+// Hash of everything the precomputed ranges depend on, to key cached ranges
+uint64_t map_range_table_key(map_t * map, int angle_count, double max_range);
+
+// Map the precomputed ranges of a map from a file written by map_save_range_table().
+// Fails, returning -1, if the file is missing or was written for another key.
+int map_load_range_table(
+  map_t * map, int angle_count, double max_range, uint64_t key, const char * filename);
+
+// Save the precomputed ranges of a map to a file
+int map_save_range_table(map_t * map, uint64_t key, const char * filename);
+
+// Look up a range reading in the table, for the nearest of its angles. The map
+// must have a range table.
+double map_lookup_range(map_t * map, double ox, double oy, double oa);
+
 
 /**************************************************************************
  * GUI/diagnostic functions
@@ -118,9 +167,6 @@ void map_draw_occ(map_t * map, struct _rtk_fig_t * fig);
 // Draw the cspace map
 void map_draw_cspace(map_t * map, struct _rtk_fig_t * fig);
 
-// Draw a wifi map
-void map_draw_wifi(map_t * map, struct _rtk_fig_t * fig, int index);
-
 
 /**************************************************************************
  * Map manipulation macros
@@ -140,6 +186,14 @@ void map_draw_wifi(map_t * map, struct _rtk_fig_t * fig, int index);
 // Compute the cell index for the given map coords.
 #define MAP_INDEX(map, i, j) ((i) + (j) * map->size_x)
 
+// Number of bytes in a bitmap of the map cells
+#define MAP_BITMAP_SIZE(map) ((map->size_x * map->size_y + 7) / 8)
+
+// Occupancy state (-1 = free, 0 = unknown, +1 = occ) of the cell at an index
+#define MAP_OCC_STATE(map, index) \
+  (((map->occ_bits[(index) >> 3] >> ((index) & 7)) & 1) - \
+  ((map->free_bits[(index) >> 3] >> ((index) & 7)) & 1))
+
 #ifdef __cplusplus
 }
 #endif
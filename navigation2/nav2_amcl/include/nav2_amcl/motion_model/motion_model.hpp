@@ -18,6 +18,7 @@
 #define NAV2_AMCL__MOTION_MODEL__MOTION_MODEL_HPP_
 
 #include <string>
+#include <vector>
 #include "nav2_amcl/pf/pf.hpp"
 #include "nav2_amcl/pf/pf_pdf.hpp"
 
@@ -47,6 +48,7 @@ private:
   double alpha3_;
   double alpha4_;
   double alpha5_;
+  std::vector<double> noise_;  // Workspace for the noise of each sample
 };
 
 class DifferentialMotionModel : public MotionModel
@@ -60,6 +62,7 @@ private:
   double alpha2_;
   double alpha3_;
   double alpha4_;
+  std::vector<double> noise_;  // Workspace for the noise of each sample
 };
 
 }  // namespace nav2_amcl
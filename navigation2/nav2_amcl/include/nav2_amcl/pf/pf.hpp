@@ -29,7 +29,8 @@
 #define NAV2_AMCL__PF__PF_HPP_
 
 #include "nav2_amcl/pf/pf_vector.hpp"
-#include "nav2_amcl/pf/pf_kdtree.hpp"
+#include "nav2_amcl/pf/pf_hist.hpp"
+#include "nav2_amcl/pf/pf_pdf.hpp"
 
 #ifdef __cplusplus
 extern "C" {
@@ -93,8 +94,8 @@ typedef struct _pf_sample_set_t
   int sample_count;
   pf_sample_t * samples;
 
-  // A kdtree encoding the histogram
-  pf_kdtree_t * kdtree;
+  // A histogram of the sample poses, in (x, y, theta) bins
+  pf_hist_t * hist;
 
   // Clusters
   int cluster_count, cluster_max_count;
@@ -134,6 +135,18 @@ typedef struct _pf_t
   double dist_threshold;  // distance threshold in each axis over which the pf is considered to not
                           // be converged
   int converged;
+
+  // Resampling workspace: the indices of the samples picked by the systematic
+  // resampler, max_samples long
+  int * resample_indices;
+
+  // Random numbers for resampling and the motion models
+  pf_rng_t rng;
+
+  // Cached results of the population size calculation for k = 0..max_samples
+  // bins (0 if not computed yet), valid for limit_cache_err and limit_cache_z
+  int * limit_cache;
+  double limit_cache_err, limit_cache_z;
 } pf_t;
 
 
@@ -177,7 +190,7 @@ void pf_cluster_stats(pf_t * pf, pf_sample_set_t * set);
 // Display the sample set
 void pf_draw_samples(pf_t * pf, struct _rtk_fig_t * fig, int max_samples);
 
-// Draw the histogram (kdtree)
+// Draw the histogram
 void pf_draw_hist(pf_t * pf, struct _rtk_fig_t * fig);
 
 // Draw the CEP statistics
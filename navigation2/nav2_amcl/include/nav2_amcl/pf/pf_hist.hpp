@@ -19,89 +19,82 @@
  *
  */
 /**************************************************************************
- * Desc: KD tree functions
+ * Desc: Pose histogram functions
  * Author: Andrew Howard
  * Date: 18 Dec 2002
  * CVS: $Id: pf_kdtree.h 6532 2008-06-11 02:45:56Z gbiggs $
  *************************************************************************/
 
-#ifndef NAV2_AMCL__PF__PF_KDTREE_HPP_
-#define NAV2_AMCL__PF__PF_KDTREE_HPP_
+#ifndef NAV2_AMCL__PF__PF_HIST_HPP_
+#define NAV2_AMCL__PF__PF_HIST_HPP_
 
 #ifdef INCLUDE_RTKGUI
 #include <rtk.h>
 #endif
 
 
-// Info for a node in the tree
-typedef struct pf_kdtree_node
+// Info for an occupied bin of the histogram
+typedef struct
 {
-  // Depth in the tree
-  int leaf, depth;
-
-  // Pivot dimension and value
-  int pivot_dim;
-  double pivot_value;
-
-  // The key for this node
+  // The (x, y, theta) key of this bin
   int key[3];
 
-  // The value for this node
+  // The value for this bin
   double value;
 
-  // The cluster label (leaf nodes)
+  // The parent of this bin while clustering, then its cluster label
   int cluster;
 
-  // Child nodes
-  struct pf_kdtree_node * children[2];
-} pf_kdtree_node_t;
+  // The hash table slot that refers to this bin
+  int slot;
+} pf_hist_bin_t;
 
 
-// A kd tree
+// A histogram of poses: a hash table on the integer bin keys, over the
+// occupied bins stored in the order they were first hit
 typedef struct
 {
   // Cell size
   double size[3];
 
-  // The root node of the tree
-  pf_kdtree_node_t * root;
-
-  // The number of nodes in the tree
-  int node_count, node_max_count;
-  pf_kdtree_node_t * nodes;
+  // The occupied bins
+  int bin_count, bin_max_count;
+  pf_hist_bin_t * bins;
 
-  // The number of leaf nodes in the tree
-  int leaf_count;
-} pf_kdtree_t;
+  // Open addressing hash table of bin indices (-1 for empty slots); the
+  // number of slots is a power of two
+  int slot_count;
+  int * slots;
+} pf_hist_t;
 
 
-// Create a tree
-extern pf_kdtree_t * pf_kdtree_alloc(int max_size);
+// Create a histogram that holds up to max_size occupied bins
+extern pf_hist_t * pf_hist_alloc(int max_size);
 
-// Destroy a tree
-extern void pf_kdtree_free(pf_kdtree_t * self);
+// Destroy a histogram
+extern void pf_hist_free(pf_hist_t * self);
 
-// Clear all entries from the tree
-extern void pf_kdtree_clear(pf_kdtree_t * self);
+// Clear all entries from the histogram
+extern void pf_hist_clear(pf_hist_t * self);
 
-// Insert a pose into the tree
-extern void pf_kdtree_insert(pf_kdtree_t * self, pf_vector_t pose, double value);
+// Insert a pose into the histogram
+extern void pf_hist_insert(pf_hist_t * self, pf_vector_t pose, double value);
 
-// Cluster the leaves in the tree
-extern void pf_kdtree_cluster(pf_kdtree_t * self);
+// Label the connected components of the occupied bins
+extern void pf_hist_cluster(pf_hist_t * self);
 
 // Determine the probability estimate for the given pose
-extern double pf_kdtree_get_prob(pf_kdtree_t * self, pf_vector_t pose);
+extern double pf_hist_get_prob(pf_hist_t * self, pf_vector_t pose);
 
 // Determine the cluster label for the given pose
-extern int pf_kdtree_get_cluster(pf_kdtree_t * self, pf_vector_t pose);
+extern int pf_hist_get_cluster(pf_hist_t * self, pf_vector_t pose);
 
 
 #ifdef INCLUDE_RTKGUI
 
-// Draw the tree
-extern void pf_kdtree_draw(pf_kdtree_t * self, rtk_fig_t * fig);
+// Draw the histogram
+extern void pf_hist_draw(pf_hist_t * self, rtk_fig_t * fig);
 
 #endif
 
-#endif  // NAV2_AMCL__PF__PF_KDTREE_HPP_
+#endif  // NAV2_AMCL__PF__PF_HIST_HPP_
@@ -28,6 +28,8 @@
 #ifndef NAV2_AMCL__PF__PF_PDF_HPP_
 #define NAV2_AMCL__PF__PF_PDF_HPP_
 
+#include <stdint.h>
+
 #include "nav2_amcl/pf/pf_vector.hpp"
 
 // #include <gsl/gsl_rng.h>
@@ -37,6 +39,29 @@
 extern "C" {
 #endif
 
+/**************************************************************************
+ * Random numbers
+ *************************************************************************/
+
+// State of a xoshiro256** random number generator.  Each generator is
+// independent of the others and of drand48(), so that every filter (or
+// thread) can own one and its draws are reproducible from its seed.
+typedef struct
+{
+  uint64_t s[4];
+} pf_rng_t;
+
+// Seed a generator
+void pf_rng_seed(pf_rng_t * rng, uint64_t seed);
+
+// Draw uniformly from [0, 1)
+double pf_rng_uniform(pf_rng_t * rng);
+
+// Fill [values] with [count] draws from a zero-mean, unit variance Gaussian
+// distribution, generated in pairs by the (trigonometric) Box-Muller transform
+void pf_rng_gaussian(pf_rng_t * rng, double * values, int count);
+
+
 /**************************************************************************
  * Gaussian
  *************************************************************************/
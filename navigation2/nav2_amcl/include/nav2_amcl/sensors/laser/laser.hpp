@@ -18,7 +18,10 @@
 #ifndef NAV2_AMCL__SENSORS__LASER__LASER_HPP_
 #define NAV2_AMCL__SENSORS__LASER__LASER_HPP_
 
+#include <cstdint>
 #include <string>
+#include <vector>
+
 #include "nav2_amcl/pf/pf.hpp"
 #include "nav2_amcl/pf/pf_pdf.hpp"
 #include "nav2_amcl/map/map.hpp"
@@ -36,6 +39,9 @@ public:
   virtual ~Laser();
   virtual bool sensorUpdate(pf_t * pf, LaserData * data) = 0;
   void SetLaserPose(pf_vector_t & laser_pose);
+  pf_vector_t GetLaserPose() const {return laser_pose_;}
+  // Number of threads the particles are weighted on, 1 weights them serially
+  void SetThreads(int threads);
 
 protected:
   double z_hit_;
@@ -49,6 +55,7 @@ protected:
   int max_samples_;
   int max_obs_;
   double ** temp_obs_;
+  int threads_;
 };
 
 class LaserData
@@ -91,6 +98,17 @@ public:
 
 private:
   static double sensorFunction(LaserData * data, pf_sample_set_t * set);
+  // Fill beam_x_ and beam_y_ with the beams of a scan the model integrates
+  void setBeams(LaserData * data);
+
+  // z_hit * exp(-occ_dist^2 / (2 * sigma_hit^2)) of every map cell, in units of
+  // hit_likelihood_scale_, and of points off the map
+  std::vector<uint16_t> hit_likelihood_;
+  double hit_likelihood_scale_;
+  double off_map_hit_likelihood_;
+  // Beam end points in the laser frame, structure of arrays
+  std::vector<double> beam_x_;
+  std::vector<double> beam_y_;
 };
 
 class LikelihoodFieldModelProb : public Laser
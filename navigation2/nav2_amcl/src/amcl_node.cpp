@@ -23,6 +23,8 @@
 #include "nav2_amcl/amcl_node.hpp"
 
 #include <algorithm>
+#include <cinttypes>
+#include <cstdio>
 #include <memory>
 #include <string>
 #include <utility>
@@ -86,11 +88,25 @@ AmclNode::AmclNode()
     "base_frame_id", rclcpp::ParameterValue(std::string("base_footprint")),
     "Which frame to use for the robot base");
 
+  add_parameter(
+    "beam_range_table_angles", rclcpp::ParameterValue(0),
+    "Number of angles to precompute the ranges from each free map cell at for the beam "
+    "model, 0 to trace the ranges");
+
+  add_parameter(
+    "beam_range_table_max_memory", rclcpp::ParameterValue(512.0),
+    "Most memory in MB to take for the beam model ranges, above which they are traced instead");
+
   add_parameter("beam_skip_distance", rclcpp::ParameterValue(0.5));
   add_parameter("beam_skip_error_threshold", rclcpp::ParameterValue(0.9));
   add_parameter("beam_skip_threshold", rclcpp::ParameterValue(0.3));
   add_parameter("do_beamskip", rclcpp::ParameterValue(false));
 
+  add_parameter(
+    "cspace_cache_dir", rclcpp::ParameterValue(std::string("")),
+    "Directory to cache the distances of the map cells to obstacles and the beam model ranges "
+    "in, empty to not cache them");
+
   add_parameter(
     "global_frame_id", rclcpp::ParameterValue(std::string("map")),
     "The name of the coordinate frame published by the localization system");
@@ -158,6 +174,11 @@ AmclNode::AmclNode()
   add_parameter("pf_err", rclcpp::ParameterValue(0.05));
   add_parameter("pf_z", rclcpp::ParameterValue(0.99));
 
+  add_parameter(
+    "random_seed", rclcpp::ParameterValue(-1),
+    "Seed of the random numbers of the particle filter, to make runs reproducible. "
+    "Negative to seed them from the clock");
+
   add_parameter(
     "recovery_alpha_fast", rclcpp::ParameterValue(0.0),
     "Exponential decay rate for the fast average weight filter, used in deciding when to recover "
@@ -183,6 +204,10 @@ AmclNode::AmclNode()
     "on subsequent runs to initialize the filter",
     "-1.0 to disable");
 
+  add_parameter(
+    "sensor_model_threads", rclcpp::ParameterValue(1),
+    "Number of threads to weight the particles on in the laser model, 1 weights them serially");
+
   add_parameter("sigma_hit", rclcpp::ParameterValue(0.2));
 
   add_parameter(
@@ -337,6 +362,11 @@ AmclNode::on_cleanup(const rclcpp_lifecycle::State & /*state*/)
   laser_scan_sub_.reset();
 
   // Map
+  map_update_timer_.reset();
+  if (map_update_.valid()) {
+    map_update_.get();
+  }
+  pending_map_.reset();
   map_free(map_);
   map_ = nullptr;
   first_map_received_ = false;
@@ -360,6 +390,9 @@ AmclNode::on_cleanup(const rclcpp_lifecycle::State & /*state*/)
   pf_ = nullptr;
 
   // Laser Scan
+  for (auto laser : lasers_) {
+    delete laser;
+  }
   lasers_.clear();
   lasers_update_.clear();
   frame_to_laser_.clear();
@@ -491,7 +524,7 @@ AmclNode::uniformPoseGenerator(void * arg)
     int i, j;
     i = MAP_GXWX(map, p.v[0]);
     j = MAP_GYWY(map, p.v[1]);
-    if (MAP_VALID(map, i, j) && (map->cells[MAP_INDEX(map, i, j)].occ_state == -1)) {
+    if (MAP_VALID(map, i, j) && (MAP_OCC_STATE(map, MAP_INDEX(map, i, j)) == -1)) {
       break;
     }
   }
@@ -505,6 +538,12 @@ AmclNode::globalLocalizationCallback(
   const std::shared_ptr<std_srvs::srv::Empty::Request>/*req*/,
   std::shared_ptr<std_srvs::srv::Empty::Response>/*res*/)
 {
+  checkMapUpdate();
+  if (map_ == nullptr) {
+    RCLCPP_WARN(get_logger(), "Can not initialize with a uniform distribution without a map");
+    return;
+  }
+
   RCLCPP_INFO(get_logger(), "Initializing with uniform distribution");
 
   pf_init_model(
@@ -629,7 +668,8 @@ AmclNode::laserReceived(sensor_msgs::msg::LaserScan::ConstSharedPtr laser_scan)
   // Since the sensor data is continually being published by the simulator or robot,
   // we don't want our callbacks to fire until we're in the active state
   if (!active_) {return;}
-  if (!first_map_received_) {
+  checkMapUpdate();
+  if (map_ == nullptr) {
     if (checkElapsedTime(2s, last_time_printed_msg_)) {
       RCLCPP_WARN(get_logger(), "Waiting for map....");
       last_time_printed_msg_ = now();
@@ -743,7 +783,8 @@ bool AmclNode::addNewScanner(
   const std::string & laser_scan_frame_id,
   geometry_msgs::msg::PoseStamped & laser_pose)
 {
-  lasers_.push_back(createLaserObject());
+  lasers_.push_back(createLaserObject(map_));
+  lasers_.back()->SetThreads(sensor_model_threads_);
   lasers_update_.push_back(true);
   laser_index = frame_to_laser_.size();
 
@@ -1028,26 +1069,26 @@ AmclNode::sendMapToOdomTransform(const tf2::TimePoint & transform_expiration)
 }
 
 nav2_amcl::Laser *
-AmclNode::createLaserObject()
+AmclNode::createLaserObject(map_t * map)
 {
   RCLCPP_INFO(get_logger(), "createLaserObject");
 
   if (sensor_model_type_ == "beam") {
     return new nav2_amcl::BeamModel(
       z_hit_, z_short_, z_max_, z_rand_, sigma_hit_, lambda_short_,
-      0.0, max_beams_, map_);
+      0.0, max_beams_, map);
   }
 
   if (sensor_model_type_ == "likelihood_field_prob") {
     return new nav2_amcl::LikelihoodFieldModelProb(
       z_hit_, z_rand_, sigma_hit_,
       laser_likelihood_max_dist_, do_beamskip_, beam_skip_distance_, beam_skip_threshold_,
-      beam_skip_error_threshold_, max_beams_, map_);
+      beam_skip_error_threshold_, max_beams_, map);
   }
 
   return new nav2_amcl::LikelihoodFieldModel(
     z_hit_, z_rand_, sigma_hit_,
-    laser_likelihood_max_dist_, max_beams_, map_);
+    laser_likelihood_max_dist_, max_beams_, map);
 }
 
 void
@@ -1062,9 +1103,12 @@ AmclNode::initParameters()
   get_parameter("alpha4", alpha4_);
   get_parameter("alpha5", alpha5_);
   get_parameter("base_frame_id", base_frame_id_);
+  get_parameter("beam_range_table_angles", beam_range_table_angles_);
+  get_parameter("beam_range_table_max_memory", beam_range_table_max_memory_);
   get_parameter("beam_skip_distance", beam_skip_distance_);
   get_parameter("beam_skip_error_threshold", beam_skip_error_threshold_);
   get_parameter("beam_skip_threshold", beam_skip_threshold_);
+  get_parameter("cspace_cache_dir", cspace_cache_dir_);
   get_parameter("do_beamskip", do_beamskip_);
   get_parameter("global_frame_id", global_frame_id_);
   get_parameter("lambda_short", lambda_short_);
@@ -1085,9 +1129,11 @@ AmclNode::initParameters()
   get_parameter("pf_z", pf_z_);
   get_parameter("recovery_alpha_fast", alpha_fast_);
   get_parameter("recovery_alpha_slow", alpha_slow_);
+  get_parameter("random_seed", random_seed_);
   get_parameter("resample_interval", resample_interval_);
   get_parameter("robot_model_type", robot_model_type_);
   get_parameter("save_pose_rate", save_pose_rate);
+  get_parameter("sensor_model_threads", sensor_model_threads_);
   get_parameter("sigma_hit", sigma_hit_);
   get_parameter("tf_broadcast", tf_broadcast_);
   get_parameter("transform_tolerance", tmp_tol);
@@ -1132,62 +1178,210 @@ AmclNode::mapReceived(const nav_msgs::msg::OccupancyGrid::SharedPtr msg)
   if (first_map_only_ && first_map_received_) {
     return;
   }
-  handleMapMessage(*msg);
+  handleMapMessage(msg);
   first_map_received_ = true;
 }
 
 void
-AmclNode::handleMapMessage(const nav_msgs::msg::OccupancyGrid & msg)
+AmclNode::handleMapMessage(const nav_msgs::msg::OccupancyGrid::SharedPtr & msg)
 {
   std::lock_guard<std::recursive_mutex> cfl(configuration_mutex_);
 
   RCLCPP_INFO(
     get_logger(), "Received a %d X %d map @ %.3f m/pix",
-    msg.info.width,
-    msg.info.height,
-    msg.info.resolution);
-  if (msg.header.frame_id != global_frame_id_) {
+    msg->info.width,
+    msg->info.height,
+    msg->info.resolution);
+  if (msg->header.frame_id != global_frame_id_) {
     RCLCPP_WARN(
       get_logger(), "Frame_id of map received:'%s' doesn't match global_frame_id:'%s'. This could"
       " cause issues with reading published topics",
-      msg.header.frame_id.c_str(),
+      msg->header.frame_id.c_str(),
       global_frame_id_.c_str());
   }
-  freeMapDependentMemory();
-  map_ = convertMap(msg);
+
+  // One map is built at a time, the latest map received meanwhile is built next
+  if (map_update_.valid()) {
+    pending_map_ = msg;
+    return;
+  }
+  startMapUpdate(msg);
+}
+
+void
+AmclNode::startMapUpdate(const nav_msgs::msg::OccupancyGrid::SharedPtr & msg)
+{
+  // The models of the lasers seen so far are built along with the map
+  std::vector<pf_vector_t> laser_poses;
+  for (auto laser : lasers_) {
+    laser_poses.push_back(laser->GetLaserPose());
+  }
+
+  map_update_ = std::async(
+    std::launch::async, &AmclNode::buildMapData, this, msg, std::move(laser_poses));
+}
+
+std::unique_ptr<AmclNode::MapData>
+AmclNode::buildMapData(
+  nav_msgs::msg::OccupancyGrid::SharedPtr msg, std::vector<pf_vector_t> laser_poses)
+{
+  auto data = std::make_unique<MapData>();
+  data->map = convertMap(*msg);
+
+  // The likelihood field models need the distance of every cell to the nearest obstacle
+  if (sensor_model_type_ != "beam") {
+    updateCspace(data->map);
+  } else if (beam_range_table_angles_ > 0) {
+    updateRangeTable(data->map);
+  }
 
 #if NEW_UNIFORM_SAMPLING
-  createFreeSpaceVector();
+  createFreeSpaceVector(data->map, data->free_space_indices);
 #endif
+
+  for (auto & laser_pose : laser_poses) {
+    data->lasers.push_back(createLaserObject(data->map));
+    data->lasers.back()->SetThreads(sensor_model_threads_);
+    data->lasers.back()->SetLaserPose(laser_pose);
+  }
+
+  return data;
 }
 
 void
-AmclNode::createFreeSpaceVector()
+AmclNode::checkMapUpdate()
 {
-  // Index of free space
-  free_space_indices.resize(0);
-  for (int i = 0; i < map_->size_x; i++) {
-    for (int j = 0; j < map_->size_y; j++) {
-      if (map_->cells[MAP_INDEX(map_, i, j)].occ_state == -1) {
-        free_space_indices.push_back(std::make_pair(i, j));
-      }
-    }
+  std::lock_guard<std::recursive_mutex> cfl(configuration_mutex_);
+
+  if (!map_update_.valid() ||
+    map_update_.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+  {
+    return;
+  }
+  std::unique_ptr<MapData> data = map_update_.get();
+
+  // Lasers seen while the map was being built get their models now
+  for (size_t i = data->lasers.size(); i < lasers_.size(); i++) {
+    pf_vector_t laser_pose = lasers_[i]->GetLaserPose();
+    data->lasers.push_back(createLaserObject(data->map));
+    data->lasers.back()->SetThreads(sensor_model_threads_);
+    data->lasers.back()->SetLaserPose(laser_pose);
+  }
+
+  // Swap in the new map, the old one is freed with data
+  std::swap(map_, data->map);
+  lasers_.swap(data->lasers);
+#if NEW_UNIFORM_SAMPLING
+  free_space_indices.swap(data->free_space_indices);
+#endif
+  pf_->random_pose_data = map_;
+
+  RCLCPP_INFO(get_logger(), "Switched to a %d X %d map", map_->size_x, map_->size_y);
+
+  if (pending_map_) {
+    startMapUpdate(pending_map_);
+    pending_map_.reset();
+  }
+}
+
+AmclNode::MapData::~MapData()
+{
+  for (auto laser : lasers) {
+    delete laser;
+  }
+  if (map != nullptr) {
+    map_free(map);
   }
 }
 
 void
-AmclNode::freeMapDependentMemory()
+AmclNode::updateCspace(map_t * map)
 {
-  if (map_ != NULL) {
-    map_free(map_);
-    map_ = NULL;
+  if (cspace_cache_dir_.empty()) {
+    map_update_cspace(map, laser_likelihood_max_dist_);
+    return;
   }
 
-  // Clear queued laser objects because they hold pointers to the existing
-  // map, #5202.
-  lasers_.clear();
-  lasers_update_.clear();
-  frame_to_laser_.clear();
+  // The distances only depend on the map and laser_likelihood_max_dist, so they
+  // are kept on disk to skip computing them again when the same map is received
+  uint64_t key = map_cspace_key(map, laser_likelihood_max_dist_);
+  char key_string[17];
+  snprintf(key_string, sizeof(key_string), "%016" PRIx64, key);
+  std::string file_name = cspace_cache_dir_ + "/amcl_cspace_" + key_string + ".bin";
+
+  if (map_load_cspace(map, laser_likelihood_max_dist_, key, file_name.c_str()) == 0) {
+    RCLCPP_INFO(get_logger(), "Loaded the map distances from %s", file_name.c_str());
+    return;
+  }
+
+  map_update_cspace(map, laser_likelihood_max_dist_);
+  if (map_save_cspace(map, key, file_name.c_str()) != 0) {
+    RCLCPP_WARN(get_logger(), "Could not save the map distances to %s", file_name.c_str());
+  }
+}
+
+void
+AmclNode::updateRangeTable(map_t * map)
+{
+  // The ranges are traced up to the max range of the scans, which is only known
+  // up front if it is set
+  if (laser_max_range_ <= 0.0) {
+    RCLCPP_WARN(
+      get_logger(), "Not precomputing the beam model ranges, laser_max_range is not set");
+    return;
+  }
+
+  // Large maps at many angles take gigabytes, in which case the ranges are
+  // traced as without the table
+  double size = map_range_table_size(map, beam_range_table_angles_) / (1024.0 * 1024.0);
+  if (size > beam_range_table_max_memory_) {
+    RCLCPP_WARN(
+      get_logger(), "Not precomputing the beam model ranges, they would take %.0f MB, "
+      "more than beam_range_table_max_memory of %.0f MB", size, beam_range_table_max_memory_);
+    return;
+  }
+
+  std::string file_name;
+  uint64_t key = 0;
+  if (!cspace_cache_dir_.empty()) {
+    key = map_range_table_key(map, beam_range_table_angles_, laser_max_range_);
+    char key_string[17];
+    snprintf(key_string, sizeof(key_string), "%016" PRIx64, key);
+    file_name = cspace_cache_dir_ + "/amcl_ranges_" + key_string + ".bin";
+
+    if (map_load_range_table(
+        map, beam_range_table_angles_, laser_max_range_, key, file_name.c_str()) == 0)
+    {
+      RCLCPP_INFO(get_logger(), "Loaded the beam model ranges from %s", file_name.c_str());
+      return;
+    }
+  }
+
+  if (map_update_range_table(map, beam_range_table_angles_, laser_max_range_) != 0) {
+    RCLCPP_WARN(get_logger(), "Could not allocate the beam model range table");
+    return;
+  }
+  RCLCPP_INFO(
+    get_logger(), "Precomputed the beam model ranges at %d angles (%.0f MB)",
+    beam_range_table_angles_, size);
+
+  if (!file_name.empty() && map_save_range_table(map, key, file_name.c_str()) != 0) {
+    RCLCPP_WARN(get_logger(), "Could not save the beam model ranges to %s", file_name.c_str());
+  }
+}
+
+void
+AmclNode::createFreeSpaceVector(map_t * map, std::vector<std::pair<int, int>> & indices)
+{
+  // Index of free space
+  indices.resize(0);
+  for (int i = 0; i < map->size_x; i++) {
+    for (int j = 0; j < map->size_y; j++) {
+      if (MAP_OCC_STATE(map, MAP_INDEX(map, i, j)) == -1) {
+        indices.push_back(std::make_pair(i, j));
+      }
+    }
+  }
 }
 
 // Convert an OccupancyGrid map message into the internal representation. This function
@@ -1203,17 +1397,14 @@ AmclNode::convertMap(const nav_msgs::msg::OccupancyGrid & map_msg)
   map->origin_x = map_msg.info.origin.position.x + (map->size_x / 2) * map->scale;
   map->origin_y = map_msg.info.origin.position.y + (map->size_y / 2) * map->scale;
 
-  map->cells =
-    reinterpret_cast<map_cell_t *>(malloc(sizeof(map_cell_t) * map->size_x * map->size_y));
+  map_alloc_cells(map);
 
   // Convert to player format
   for (int i = 0; i < map->size_x * map->size_y; i++) {
     if (map_msg.data[i] == 0) {
-      map->cells[i].occ_state = -1;
+      map_set_occ_state(map, i, -1);
     } else if (map_msg.data[i] == 100) {
-      map->cells[i].occ_state = +1;
-    } else {
-      map->cells[i].occ_state = 0;
+      map_set_occ_state(map, i, +1);
     }
   }
 
@@ -1279,6 +1470,11 @@ AmclNode::initPubSub()
     map_topic_, rclcpp::QoS(rclcpp::KeepLast(1)).transient_local().reliable(),
     std::bind(&AmclNode::mapReceived, this, std::placeholders::_1));
 
+  // Scans and global localization requests swap in a built map as well, this only
+  // covers the time without them
+  map_update_timer_ = create_wall_timer(
+    std::chrono::milliseconds(100), std::bind(&AmclNode::checkMapUpdate, this));
+
   RCLCPP_INFO(get_logger(), "Subscribed to map topic.");
 }
 
@@ -1333,6 +1529,13 @@ AmclNode::initParticleFilter()
   pf_->pop_err = pf_err_;
   pf_->pop_z = pf_z_;
 
+  // The filter seeds itself from the clock, unless a seed is set. Random poses for
+  // recovery and global localization come from drand48(), which is seeded as well.
+  if (random_seed_ >= 0) {
+    pf_rng_seed(&pf_->rng, random_seed_);
+    srand48(random_seed_);
+  }
+
   // Initialize the filter
   pf_vector_t pf_init_pose_mean = pf_vector_zero();
   pf_init_pose_mean.v[0] = init_pose_[0];
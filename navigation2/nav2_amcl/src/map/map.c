@@ -30,6 +30,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/mman.h>
 
 #include "nav2_amcl/map/map.hpp"
 
@@ -51,7 +52,17 @@ map_t * map_alloc(void)
   map->scale = 0;
 
   // Allocate storage for main map
-  map->cells = (map_cell_t *) NULL;
+  map->occ_bits = NULL;
+  map->free_bits = NULL;
+  map->occ_dist = NULL;
+  map->occ_dist_mapping = NULL;
+  map->occ_dist_mapping_size = 0;
+  map->range_table = NULL;
+  map->range_table_rows = NULL;
+  map->range_table_angles = 0;
+  map->range_table_max_range = 0.0;
+  map->range_table_mapping = NULL;
+  map->range_table_mapping_size = 0;
 
   return map;
 }
@@ -60,25 +71,51 @@ map_t * map_alloc(void)
 // Destroy a map
 void map_free(map_t * map)
 {
-  free(map->cells);
+  free(map->occ_bits);
+  free(map->free_bits);
+  map_free_cspace(map);
+  map_free_range_table(map);
   free(map);
 }
 
 
-// Get the cell at the given point
-map_cell_t * map_get_cell(map_t * map, double ox, double oy, double oa)
+// Allocate the occupancy bitmaps
+void map_alloc_cells(map_t * map)
 {
-  (void)oa;
-  int i, j;
-  map_cell_t * cell;
+  free(map->occ_bits);
+  free(map->free_bits);
+  map_free_cspace(map);
+  map_free_range_table(map);
+
+  map->occ_bits = (uint8_t *) calloc(MAP_BITMAP_SIZE(map), 1);
+  map->free_bits = (uint8_t *) calloc(MAP_BITMAP_SIZE(map), 1);
+}
 
-  i = MAP_GXWX(map, ox);
-  j = MAP_GYWY(map, oy);
 
-  if (!MAP_VALID(map, i, j)) {
-    return NULL;
+// Free the cspace distances, whether allocated or mapped from a file
+void map_free_cspace(map_t * map)
+{
+  if (map->occ_dist_mapping != NULL) {
+    munmap(map->occ_dist_mapping, map->occ_dist_mapping_size);
+  } else {
+    free(map->occ_dist);
   }
+  map->occ_dist = NULL;
+  map->occ_dist_mapping = NULL;
+  map->occ_dist_mapping_size = 0;
+}
 
-  cell = map->cells + MAP_INDEX(map, i, j);
-  return cell;
+
+// Set the occupancy state of a cell
+void map_set_occ_state(map_t * map, int index, int occ_state)
+{
+  uint8_t bit = (uint8_t) (1 << (index & 7));
+
+  map->occ_bits[index >> 3] &= (uint8_t) ~bit;
+  map->free_bits[index >> 3] &= (uint8_t) ~bit;
+  if (occ_state > 0) {
+    map->occ_bits[index >> 3] |= bit;
+  } else if (occ_state < 0) {
+    map->free_bits[index >> 3] |= bit;
+  }
 }
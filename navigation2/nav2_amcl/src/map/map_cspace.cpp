@@ -19,165 +19,149 @@
  *
  */
 
+#include <limits.h>
 #include <math.h>
+#include <stdint.h>
 #include <stdlib.h>
-#include <string.h>
-#include <queue>
+#include <algorithm>
+#include <vector>
 #include "nav2_amcl/map/map.hpp"
 
-class CellData
+// The distance of each cell to the nearest occupied cell is an exact Euclidean
+// distance transform (Felzenszwalb & Huttenlocher, "Distance Transforms of Sampled
+// Functions"), done in two separable passes that are linear in the number of cells:
+// the distance to the nearest occupied cell in the same column, then the lower
+// envelope of the parabolas those distances give along each row. Columns and rows
+// are independent, so each pass is split across threads. Distances are in cells and
+// bounded by the cell radius of max_occ_dist; cells further away get max_occ_dist.
+
+namespace
 {
-public:
-  map_t * map_;
-  unsigned int i_, j_;
-  unsigned int src_i_, src_j_;
-};
 
-class CachedDistanceMap
+// Number of columns a thread updates at once in the column pass, so that it walks
+// down the rows reading whole cache lines
+const int COLUMN_BLOCK = 64;
+
+// Squared distance of every cell of a row to the nearest occupied cell, from the
+// squared distances f to the nearest occupied cell in each column
+void row_distance_transform(const int * f, int * d, int n, int * v, double * z)
 {
-public:
-  CachedDistanceMap(double scale, double max_dist)
-  : distances_(NULL), scale_(scale), max_dist_(max_dist)
-  {
-    cell_radius_ = max_dist / scale;
-    distances_ = new double *[cell_radius_ + 2];
-    for (int i = 0; i <= cell_radius_ + 1; i++) {
-      distances_[i] = new double[cell_radius_ + 2];
-      for (int j = 0; j <= cell_radius_ + 1; j++) {
-        distances_[i][j] = sqrt(i * i + j * j);
+  // v holds the columns of the parabolas of the lower envelope, and z the
+  // boundaries between them
+  int k = 0;
+  v[0] = 0;
+  z[0] = -HUGE_VAL;
+  z[1] = HUGE_VAL;
+  for (int q = 1; q < n; q++) {
+    double s;
+    while (true) {
+      const int p = v[k];
+      // In double, as q * q overflows an int for rows over 46340 cells
+      s = ((f[q] + static_cast<double>(q) * q) - (f[p] + static_cast<double>(p) * p)) /
+        (2.0 * (q - p));
+      if (s > z[k]) {
+        break;
       }
+      k--;
     }
+    k++;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = HUGE_VAL;
   }
-  ~CachedDistanceMap()
-  {
-    if (distances_) {
-      for (int i = 0; i <= cell_radius_ + 1; i++) {
-        delete[] distances_[i];
-      }
-      delete[] distances_;
+
+  k = 0;
+  for (int q = 0; q < n; q++) {
+    while (z[k + 1] < q) {
+      k++;
     }
+    const int64_t p = v[k];
+    d[q] = static_cast<int>(std::min<int64_t>((q - p) * (q - p) + f[p], INT_MAX));
   }
-  double ** distances_;
-  double scale_;
-  double max_dist_;
-  int cell_radius_;
-};
+}
 
+}  // namespace
 
-bool operator<(const CellData & a, const CellData & b)
+// Update the cspace distance values
+void map_update_cspace(map_t * map, double max_occ_dist)
 {
-  return a.map_->cells[MAP_INDEX(
-             a.map_, a.i_,
-             a.j_)].occ_dist > a.map_->cells[MAP_INDEX(b.map_, b.i_, b.j_)].occ_dist;
-}
+  const int size_x = map->size_x;
+  const int size_y = map->size_y;
 
-CachedDistanceMap *
-get_distance_map(double scale, double max_dist)
-{
-  static CachedDistanceMap * cdm = NULL;
+  map->max_occ_dist = max_occ_dist;
 
-  if (!cdm || (cdm->scale_ != scale) || (cdm->max_dist_ != max_dist)) {
-    if (cdm) {
-      delete cdm;
-    }
-    cdm = new CachedDistanceMap(scale, max_dist);
+  // Distances mapped from a cache file are read-only
+  if (map->occ_dist_mapping != NULL) {
+    map_free_cspace(map);
   }
-
-  return cdm;
-}
-
-void enqueue(
-  map_t * map, int i, int j,
-  int src_i, int src_j,
-  std::priority_queue<CellData> & Q,
-  CachedDistanceMap * cdm,
-  unsigned char * marked)
-{
-  if (marked[MAP_INDEX(map, i, j)]) {
-    return;
+  if (map->occ_dist == NULL) {
+    map->occ_dist = static_cast<float *>(malloc(sizeof(float) * size_x * size_y));
   }
-
-  int di = abs(i - src_i);
-  int dj = abs(j - src_j);
-  double distance = cdm->distances_[di][dj];
-
-  if (distance > cdm->cell_radius_) {
+  if (size_x == 0 || size_y == 0) {
     return;
   }
 
-  map->cells[MAP_INDEX(map, i, j)].occ_dist = distance * map->scale;
+  // Distances beyond the radius are all the same, so the distances along columns
+  // are capped just past it to keep the squares small
+  const int cell_radius = max_occ_dist / map->scale;
+  const int cap = cell_radius + 1;
 
-  CellData cell;
-  cell.map_ = map;
-  cell.i_ = i;
-  cell.j_ = j;
-  cell.src_i_ = src_i;
-  cell.src_j_ = src_j;
+  std::vector<int> sq_dist(static_cast<size_t>(size_x) * size_y);
 
-  Q.push(cell);
-
-  marked[MAP_INDEX(map, i, j)] = 1;
-}
+  // Distance to the nearest occupied cell in the same column, squared
+  const int column_blocks = (size_x + COLUMN_BLOCK - 1) / COLUMN_BLOCK;
+  #pragma omp parallel for schedule(static)
+  for (int b = 0; b < column_blocks; b++) {
+    const int i0 = b * COLUMN_BLOCK;
+    const int i1 = std::min(size_x, i0 + COLUMN_BLOCK);
+    int * g = sq_dist.data();
 
-// Update the cspace distance values
-void map_update_cspace(map_t * map, double max_occ_dist)
-{
-  unsigned char * marked;
-  std::priority_queue<CellData> Q;
-
-  marked = new unsigned char[map->size_x * map->size_y];
-  memset(marked, 0, sizeof(unsigned char) * map->size_x * map->size_y);
-
-  map->max_occ_dist = max_occ_dist;
-
-  CachedDistanceMap * cdm = get_distance_map(map->scale, map->max_occ_dist);
-
-  // Enqueue all the obstacle cells
-  CellData cell;
-  cell.map_ = map;
-  for (int i = 0; i < map->size_x; i++) {
-    cell.src_i_ = cell.i_ = i;
-    for (int j = 0; j < map->size_y; j++) {
-      if (map->cells[MAP_INDEX(map, i, j)].occ_state == +1) {
-        map->cells[MAP_INDEX(map, i, j)].occ_dist = 0.0;
-        cell.src_j_ = cell.j_ = j;
-        marked[MAP_INDEX(map, i, j)] = 1;
-        Q.push(cell);
-      } else {
-        map->cells[MAP_INDEX(map, i, j)].occ_dist = max_occ_dist;
-      }
-    }
-  }
-
-  while (!Q.empty()) {
-    CellData current_cell = Q.top();
-    if (current_cell.i_ > 0) {
-      enqueue(
-        map, current_cell.i_ - 1, current_cell.j_,
-        current_cell.src_i_, current_cell.src_j_,
-        Q, cdm, marked);
+    for (int i = i0; i < i1; i++) {
+      g[i] = MAP_OCC_STATE(map, i) == +1 ? 0 : cap;
     }
-    if (current_cell.j_ > 0) {
-      enqueue(
-        map, current_cell.i_, current_cell.j_ - 1,
-        current_cell.src_i_, current_cell.src_j_,
-        Q, cdm, marked);
+    for (int j = 1; j < size_y; j++) {
+      for (int i = i0; i < i1; i++) {
+        const int index = MAP_INDEX(map, i, j);
+        g[index] = MAP_OCC_STATE(map, index) == +1 ?
+          0 : std::min(cap, g[index - size_x] + 1);
+      }
     }
-    if (static_cast<int>(current_cell.i_) < map->size_x - 1) {
-      enqueue(
-        map, current_cell.i_ + 1, current_cell.j_,
-        current_cell.src_i_, current_cell.src_j_,
-        Q, cdm, marked);
+    for (int j = size_y - 2; j >= 0; j--) {
+      for (int i = i0; i < i1; i++) {
+        const int index = MAP_INDEX(map, i, j);
+        g[index] = std::min(g[index], g[index + size_x] + 1);
+      }
     }
-    if (static_cast<int>(current_cell.j_) < map->size_y - 1) {
-      enqueue(
-        map, current_cell.i_, current_cell.j_ + 1,
-        current_cell.src_i_, current_cell.src_j_,
-        Q, cdm, marked);
+    for (int j = 0; j < size_y; j++) {
+      for (int i = i0; i < i1; i++) {
+        const int index = MAP_INDEX(map, i, j);
+        g[index] *= g[index];
+      }
     }
+  }
 
-    Q.pop();
+  // Distances in meters of the squared distances in cells within the radius
+  const int max_sq_dist = cell_radius * cell_radius;
+  std::vector<float> distances(max_sq_dist + 1);
+  for (int k = 0; k <= max_sq_dist; k++) {
+    distances[k] = sqrt(static_cast<double>(k)) * map->scale;
   }
 
-  delete[] marked;
+  // Distance to the nearest occupied cell, along the rows
+  #pragma omp parallel
+  {
+    std::vector<int> d(size_x), v(size_x);
+    std::vector<double> z(size_x + 1);
+
+    #pragma omp for schedule(static)
+    for (int j = 0; j < size_y; j++) {
+      const int * g = sq_dist.data() + MAP_INDEX(map, 0, j);
+      row_distance_transform(g, d.data(), size_x, v.data(), z.data());
+
+      float * occ_dist = map->occ_dist + MAP_INDEX(map, 0, j);
+      for (int i = 0; i < size_x; i++) {
+        occ_dist[i] = d[i] > max_sq_dist ? max_occ_dist : distances[d[i]];
+      }
+    }
+  }
 }
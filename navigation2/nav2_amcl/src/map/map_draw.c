@@ -43,7 +43,6 @@ void map_draw_occ(map_t * map, rtk_fig_t * fig)
 {
   int i, j;
   int col;
-  map_cell_t * cell;
   uint16_t * image;
   uint16_t * pixel;
 
@@ -52,10 +51,9 @@ void map_draw_occ(map_t * map, rtk_fig_t * fig)
   // Draw occupancy
   for (j = 0; j < map->size_y; j++) {
     for (i = 0; i < map->size_x; i++) {
-      cell = map->cells + MAP_INDEX(map, i, j);
       pixel = image + (j * map->size_x + i);
 
-      col = 127 - 127 * cell->occ_state;
+      col = 127 - 127 * MAP_OCC_STATE(map, MAP_INDEX(map, i, j));
       *pixel = RTK_RGB16(col, col, col);
     }
   }
@@ -75,7 +73,6 @@ void map_draw_cspace(map_t * map, rtk_fig_t * fig)
 {
   int i, j;
   int col;
-  map_cell_t * cell;
   uint16_t * image;
   uint16_t * pixel;
 
@@ -84,10 +81,9 @@ void map_draw_cspace(map_t * map, rtk_fig_t * fig)
   // Draw occupancy
   for (j = 0; j < map->size_y; j++) {
     for (i = 0; i < map->size_x; i++) {
-      cell = map->cells + MAP_INDEX(map, i, j);
       pixel = image + (j * map->size_x + i);
 
-      col = 255 * cell->occ_dist / map->max_occ_dist;
+      col = 255 * map->occ_dist[MAP_INDEX(map, i, j)] / map->max_occ_dist;
 
       *pixel = RTK_RGB16(col, col, col);
     }
@@ -102,46 +98,4 @@ void map_draw_cspace(map_t * map, rtk_fig_t * fig)
 }
 
 
-////////////////////////////////////////////////////////////////////////////
-// Draw a wifi map
-void map_draw_wifi(map_t * map, rtk_fig_t * fig, int index)
-{
-  int i, j;
-  int level, col;
-  map_cell_t * cell;
-  uint16_t * image, * mask;
-  uint16_t * ipix, * mpix;
-
-  image = malloc(map->size_x * map->size_y * sizeof(image[0]));
-  mask = malloc(map->size_x * map->size_y * sizeof(mask[0]));
-
-  // Draw wifi levels
-  for (j = 0; j < map->size_y; j++) {
-    for (i = 0; i < map->size_x; i++) {
-      cell = map->cells + MAP_INDEX(map, i, j);
-      ipix = image + (j * map->size_x + i);
-      mpix = mask + (j * map->size_x + i);
-
-      level = cell->wifi_levels[index];
-
-      if (cell->occ_state == -1 && level != 0) {
-        col = 255 * (100 + level) / 100;
-        *ipix = RTK_RGB16(col, col, col);
-        *mpix = 1;
-      } else {
-        *mpix = 0;
-      }
-    }
-  }
-
-  // Draw the entire occupancy map as an image
-  rtk_fig_image(
-    fig, map->origin_x, map->origin_y, 0,
-    map->scale, map->size_x, map->size_y, 16, image, mask);
-
-  free(mask);
-  free(image);
-}
-
-
 #endif
@@ -29,6 +29,7 @@
 #include <math.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 
 #include "nav2_amcl/map/map.hpp"
 
@@ -87,11 +88,11 @@ double map_calc_range(map_t * map, double ox, double oy, double oa, double max_r
   }
 
   if (steep) {
-    if (!MAP_VALID(map, y, x) || map->cells[MAP_INDEX(map, y, x)].occ_state > -1) {
+    if (!MAP_VALID(map, y, x) || MAP_OCC_STATE(map, MAP_INDEX(map, y, x)) > -1) {
       return sqrt((x - x0) * (x - x0) + (y - y0) * (y - y0)) * map->scale;
     }
   } else {
-    if (!MAP_VALID(map, x, y) || map->cells[MAP_INDEX(map, x, y)].occ_state > -1) {
+    if (!MAP_VALID(map, x, y) || MAP_OCC_STATE(map, MAP_INDEX(map, x, y)) > -1) {
       return sqrt((x - x0) * (x - x0) + (y - y0) * (y - y0)) * map->scale;
     }
   }
@@ -105,14 +106,125 @@ double map_calc_range(map_t * map, double ox, double oy, double oa, double max_r
     }
 
     if (steep) {
-      if (!MAP_VALID(map, y, x) || map->cells[MAP_INDEX(map, y, x)].occ_state > -1) {
+      if (!MAP_VALID(map, y, x) || MAP_OCC_STATE(map, MAP_INDEX(map, y, x)) > -1) {
         return sqrt((x - x0) * (x - x0) + (y - y0) * (y - y0)) * map->scale;
       }
     } else {
-      if (!MAP_VALID(map, x, y) || map->cells[MAP_INDEX(map, x, y)].occ_state > -1) {
+      if (!MAP_VALID(map, x, y) || MAP_OCC_STATE(map, MAP_INDEX(map, x, y)) > -1) {
         return sqrt((x - x0) * (x - x0) + (y - y0) * (y - y0)) * map->scale;
       }
     }
   }
   return max_range;
 }
+
+
+// Precompute the range from the center of every free cell. Particles in cells
+// that are not free get a range of zero from map_calc_range(), so only the free
+// cells get a row of the table.
+int map_update_range_table(map_t * map, int angle_count, double max_range)
+{
+  int i, free_count;
+  int cell_count = map->size_x * map->size_y;
+  double units;
+
+  map_free_range_table(map);
+
+  map->range_table_rows = (int32_t *) malloc(sizeof(int32_t) * cell_count);
+  if (map->range_table_rows == NULL) {
+    return -1;
+  }
+  free_count = 0;
+  for (i = 0; i < cell_count; i++) {
+    map->range_table_rows[i] = MAP_OCC_STATE(map, i) == -1 ? free_count++ : -1;
+  }
+
+  map->range_table = (uint16_t *) malloc(sizeof(uint16_t) * (size_t) free_count * angle_count);
+  if (map->range_table == NULL) {
+    map_free_range_table(map);
+    return -1;
+  }
+  map->range_table_angles = angle_count;
+  map->range_table_max_range = max_range;
+
+  units = UINT16_MAX / max_range;
+
+  // Rays from open areas are much longer than rays from next to walls, so the
+  // cells are handed out to the threads in small chunks
+  #pragma omp parallel for schedule(dynamic, 64)
+  for (i = 0; i < cell_count; i++) {
+    int k;
+    double ox, oy;
+    uint16_t * ranges;
+
+    if (map->range_table_rows[i] < 0) {
+      continue;
+    }
+    ox = MAP_WXGX(map, i % map->size_x);
+    oy = MAP_WYGY(map, i / map->size_x);
+    ranges = map->range_table + (size_t) map->range_table_rows[i] * angle_count;
+    for (k = 0; k < angle_count; k++) {
+      double range = map_calc_range(map, ox, oy, 2 * M_PI * k / angle_count, max_range);
+      ranges[k] = (uint16_t) (fmin(range, max_range) * units + 0.5);
+    }
+  }
+
+  return 0;
+}
+
+
+// Free the precomputed ranges, whether allocated or mapped from a file
+void map_free_range_table(map_t * map)
+{
+  if (map->range_table_mapping != NULL) {
+    munmap(map->range_table_mapping, map->range_table_mapping_size);
+  } else {
+    free(map->range_table);
+    free(map->range_table_rows);
+  }
+  map->range_table = NULL;
+  map->range_table_rows = NULL;
+  map->range_table_angles = 0;
+  map->range_table_max_range = 0.0;
+  map->range_table_mapping = NULL;
+  map->range_table_mapping_size = 0;
+}
+
+
+// Size of the range table: a row index per cell, and a row per free cell
+size_t map_range_table_size(map_t * map, int angle_count)
+{
+  int i;
+  int cell_count = map->size_x * map->size_y;
+  size_t free_count = 0;
+
+  for (i = 0; i < cell_count; i++) {
+    free_count += MAP_OCC_STATE(map, i) == -1;
+  }
+  return sizeof(int32_t) * (size_t) cell_count +
+         sizeof(uint16_t) * free_count * (size_t) angle_count;
+}
+
+
+// Look up a range reading in the table
+double map_lookup_range(map_t * map, double ox, double oy, double oa)
+{
+  int i, j, k, row;
+
+  i = MAP_GXWX(map, ox);
+  j = MAP_GYWY(map, oy);
+  if (!MAP_VALID(map, i, j)) {
+    return 0.0;
+  }
+  row = map->range_table_rows[MAP_INDEX(map, i, j)];
+  if (row < 0) {
+    return 0.0;
+  }
+
+  k = (int) floor(oa * map->range_table_angles / (2 * M_PI) + 0.5) % map->range_table_angles;
+  if (k < 0) {
+    k += map->range_table_angles;
+  }
+  return map->range_table[(size_t) row * map->range_table_angles + k] *
+         (map->range_table_max_range / UINT16_MAX);
+}
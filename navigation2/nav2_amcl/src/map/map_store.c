@@ -26,10 +26,14 @@
 **************************************************************************/
 
 #include <errno.h>
+#include <fcntl.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "nav2_amcl/map/map.hpp"
 
@@ -43,7 +47,6 @@ int map_load_occ(map_t * map, const char * filename, double scale, int negate)
   int i, j;
   int ch, occ;
   int width, height, depth;
-  map_cell_t * cell;
 
   // Open file
   file = fopen(filename, "r");
@@ -73,11 +76,11 @@ int map_load_occ(map_t * map, const char * filename, double scale, int negate)
   }
 
   // Allocate space in the map
-  if (map->cells == NULL) {
+  if (map->occ_bits == NULL) {
     map->scale = scale;
     map->size_x = width;
     map->size_y = height;
-    map->cells = calloc(width * height, sizeof(map->cells[0]));
+    map_alloc_cells(map);
   } else {
     if (width != map->size_x || height != map->size_y) {
       // PLAYER_ERROR("map dimensions are inconsistent with prior map dimensions");
@@ -113,8 +116,7 @@ int map_load_occ(map_t * map, const char * filename, double scale, int negate)
       if (!MAP_VALID(map, i, j)) {
         continue;
       }
-      cell = map->cells + MAP_INDEX(map, i, j);
-      cell->occ_state = occ;
+      map_set_occ_state(map, MAP_INDEX(map, i, j), occ);
     }
   }
 
@@ -124,6 +126,283 @@ int map_load_occ(map_t * map, const char * filename, double scale, int negate)
 }
 
 
+////////////////////////////////////////////////////////////////////////////
+// Header of a cspace cache file, followed by the distances of the cells as floats
+typedef struct
+{
+  char magic[8];
+  uint64_t key;
+  int32_t size_x, size_y;
+  double scale;
+  double max_occ_dist;
+} map_cspace_header_t;
+
+static const char MAP_CSPACE_MAGIC[8] = {'A', 'M', 'C', 'L', 'C', 'S', 'P', '1'};
+
+// FNV-1a
+static uint64_t map_hash(uint64_t hash, const void * data, size_t size)
+{
+  const uint8_t * bytes = (const uint8_t *) data;
+  size_t i;
+
+  for (i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Hash the inputs of the cspace distances. Only occupied cells matter, free and
+// unknown cells are alike.
+uint64_t map_cspace_key(map_t * map, double max_occ_dist)
+{
+  uint64_t hash = 14695981039346656037ULL;
+
+  hash = map_hash(hash, &map->size_x, sizeof(map->size_x));
+  hash = map_hash(hash, &map->size_y, sizeof(map->size_y));
+  hash = map_hash(hash, &map->scale, sizeof(map->scale));
+  hash = map_hash(hash, &max_occ_dist, sizeof(max_occ_dist));
+  hash = map_hash(hash, map->occ_bits, MAP_BITMAP_SIZE(map));
+  return hash;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Map cached cspace distances
+int map_load_cspace(map_t * map, double max_occ_dist, uint64_t key, const char * filename)
+{
+  map_cspace_header_t header;
+  size_t size = sizeof(header) + (size_t) map->size_x * map->size_y * sizeof(float);
+  struct stat st;
+  void * mapping;
+  int fd;
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size != size ||
+    read(fd, &header, sizeof(header)) != (ssize_t) sizeof(header) ||
+    memcmp(header.magic, MAP_CSPACE_MAGIC, sizeof(header.magic)) != 0 ||
+    header.key != key || header.size_x != map->size_x || header.size_y != map->size_y ||
+    header.scale != map->scale || header.max_occ_dist != max_occ_dist)
+  {
+    close(fd);
+    return -1;
+  }
+
+  mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return -1;
+  }
+
+  map_free_cspace(map);
+  map->occ_dist_mapping = mapping;
+  map->occ_dist_mapping_size = size;
+  map->occ_dist = (float *) ((char *) mapping + sizeof(header));
+  map->max_occ_dist = max_occ_dist;
+
+  return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Save cspace distances for map_load_cspace()
+int map_save_cspace(map_t * map, uint64_t key, const char * filename)
+{
+  map_cspace_header_t header;
+  size_t cell_count = (size_t) map->size_x * map->size_y;
+  size_t tmp_size = strlen(filename) + 32;
+  char * tmp_filename;
+  FILE * file;
+  int ok;
+
+  if (map->occ_dist == NULL) {
+    return -1;
+  }
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MAP_CSPACE_MAGIC, sizeof(header.magic));
+  header.key = key;
+  header.size_x = map->size_x;
+  header.size_y = map->size_y;
+  header.scale = map->scale;
+  header.max_occ_dist = map->max_occ_dist;
+
+  // Written to a temporary file renamed in place, so that the file is either
+  // complete or missing even if several processes write it at once
+  tmp_filename = malloc(tmp_size);
+  snprintf(tmp_filename, tmp_size, "%s.%d.tmp", filename, (int) getpid());
+
+  file = fopen(tmp_filename, "wb");
+  if (file == NULL) {
+    free(tmp_filename);
+    return -1;
+  }
+  ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+    fwrite(map->occ_dist, sizeof(float), cell_count, file) == cell_count;
+  ok = (fclose(file) == 0) && ok;
+
+  if (!ok || rename(tmp_filename, filename) != 0) {
+    unlink(tmp_filename);
+    free(tmp_filename);
+    return -1;
+  }
+
+  free(tmp_filename);
+  return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Header of a range table cache file, followed by the row index of the cells
+// and then the rows of ranges of the free cells
+typedef struct
+{
+  char magic[8];
+  uint64_t key;
+  int32_t size_x, size_y;
+  double scale;
+  double max_range;
+  int32_t angle_count;
+  int32_t free_count;
+} map_range_header_t;
+
+static const char MAP_RANGE_MAGIC[8] = {'A', 'M', 'C', 'L', 'R', 'N', 'G', '1'};
+
+
+////////////////////////////////////////////////////////////////////////////
+// Hash the inputs of the precomputed ranges. Rays stop at occupied and unknown
+// cells, and start from free cells, so all the cell states matter.
+uint64_t map_range_table_key(map_t * map, int angle_count, double max_range)
+{
+  uint64_t hash = 14695981039346656037ULL;
+
+  hash = map_hash(hash, &map->size_x, sizeof(map->size_x));
+  hash = map_hash(hash, &map->size_y, sizeof(map->size_y));
+  hash = map_hash(hash, &map->scale, sizeof(map->scale));
+  hash = map_hash(hash, &map->origin_x, sizeof(map->origin_x));
+  hash = map_hash(hash, &map->origin_y, sizeof(map->origin_y));
+  hash = map_hash(hash, &angle_count, sizeof(angle_count));
+  hash = map_hash(hash, &max_range, sizeof(max_range));
+  hash = map_hash(hash, map->occ_bits, MAP_BITMAP_SIZE(map));
+  hash = map_hash(hash, map->free_bits, MAP_BITMAP_SIZE(map));
+  return hash;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Map cached precomputed ranges
+int map_load_range_table(
+  map_t * map, int angle_count, double max_range, uint64_t key, const char * filename)
+{
+  map_range_header_t header;
+  size_t cell_count = (size_t) map->size_x * map->size_y;
+  size_t size;
+  struct stat st;
+  void * mapping;
+  int fd;
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+
+  if (fstat(fd, &st) != 0 ||
+    read(fd, &header, sizeof(header)) != (ssize_t) sizeof(header) ||
+    memcmp(header.magic, MAP_RANGE_MAGIC, sizeof(header.magic)) != 0 ||
+    header.key != key || header.size_x != map->size_x || header.size_y != map->size_y ||
+    header.scale != map->scale || header.max_range != max_range ||
+    header.angle_count != angle_count || header.free_count < 0)
+  {
+    close(fd);
+    return -1;
+  }
+
+  size = sizeof(header) + sizeof(int32_t) * cell_count +
+    sizeof(uint16_t) * (size_t) header.free_count * angle_count;
+  if ((size_t) st.st_size != size) {
+    close(fd);
+    return -1;
+  }
+
+  mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return -1;
+  }
+
+  map_free_range_table(map);
+  map->range_table_mapping = mapping;
+  map->range_table_mapping_size = size;
+  map->range_table_rows = (int32_t *) ((char *) mapping + sizeof(header));
+  map->range_table = (uint16_t *) (map->range_table_rows + cell_count);
+  map->range_table_angles = angle_count;
+  map->range_table_max_range = max_range;
+
+  return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Save precomputed ranges for map_load_range_table()
+int map_save_range_table(map_t * map, uint64_t key, const char * filename)
+{
+  map_range_header_t header;
+  size_t cell_count = (size_t) map->size_x * map->size_y;
+  size_t range_count;
+  size_t tmp_size = strlen(filename) + 32;
+  size_t i;
+  char * tmp_filename;
+  FILE * file;
+  int ok;
+
+  if (map->range_table == NULL) {
+    return -1;
+  }
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MAP_RANGE_MAGIC, sizeof(header.magic));
+  header.key = key;
+  header.size_x = map->size_x;
+  header.size_y = map->size_y;
+  header.scale = map->scale;
+  header.max_range = map->range_table_max_range;
+  header.angle_count = map->range_table_angles;
+  header.free_count = 0;
+  for (i = 0; i < cell_count; i++) {
+    header.free_count += map->range_table_rows[i] >= 0;
+  }
+  range_count = (size_t) header.free_count * header.angle_count;
+
+  // Written to a temporary file renamed in place, as for the cspace cache
+  tmp_filename = malloc(tmp_size);
+  snprintf(tmp_filename, tmp_size, "%s.%d.tmp", filename, (int) getpid());
+
+  file = fopen(tmp_filename, "wb");
+  if (file == NULL) {
+    free(tmp_filename);
+    return -1;
+  }
+  ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+    fwrite(map->range_table_rows, sizeof(int32_t), cell_count, file) == cell_count &&
+    fwrite(map->range_table, sizeof(uint16_t), range_count, file) == range_count;
+  ok = (fclose(file) == 0) && ok;
+
+  if (!ok || rename(tmp_filename, filename) != 0) {
+    unlink(tmp_filename);
+    free(tmp_filename);
+    return -1;
+  }
+
+  free(tmp_filename);
+  return 0;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////
 // Load a wifi signal strength map
 /*
@@ -83,28 +83,30 @@ DifferentialMotionModel::odometryUpdate(
     fabs(angleutils::angle_diff(delta_rot2, 0.0)),
     fabs(angleutils::angle_diff(delta_rot2, M_PI)));
 
+  // Precompute a couple of things
+  double rot1_hat_stddev = sqrt(
+    alpha1_ * delta_rot1_noise * delta_rot1_noise +
+    alpha2_ * delta_trans * delta_trans);
+  double trans_hat_stddev = sqrt(
+    alpha3_ * delta_trans * delta_trans +
+    alpha4_ * delta_rot1_noise * delta_rot1_noise +
+    alpha4_ * delta_rot2_noise * delta_rot2_noise);
+  double rot2_hat_stddev = sqrt(
+    alpha1_ * delta_rot2_noise * delta_rot2_noise +
+    alpha2_ * delta_trans * delta_trans);
+
+  // Draw the noise of the whole sample set at once
+  noise_.resize(3 * set->sample_count);
+  pf_rng_gaussian(&pf->rng, noise_.data(), noise_.size());
+
   for (int i = 0; i < set->sample_count; i++) {
     pf_sample_t * sample = set->samples + i;
+    const double * noise = noise_.data() + 3 * i;
 
     // Sample pose differences
-    delta_rot1_hat = angleutils::angle_diff(
-      delta_rot1,
-      pf_ran_gaussian(
-        sqrt(
-          alpha1_ * delta_rot1_noise * delta_rot1_noise +
-          alpha2_ * delta_trans * delta_trans)));
-    delta_trans_hat = delta_trans -
-      pf_ran_gaussian(
-      sqrt(
-        alpha3_ * delta_trans * delta_trans +
-        alpha4_ * delta_rot1_noise * delta_rot1_noise +
-        alpha4_ * delta_rot2_noise * delta_rot2_noise));
-    delta_rot2_hat = angleutils::angle_diff(
-      delta_rot2,
-      pf_ran_gaussian(
-        sqrt(
-          alpha1_ * delta_rot2_noise * delta_rot2_noise +
-          alpha2_ * delta_trans * delta_trans)));
+    delta_rot1_hat = angleutils::angle_diff(delta_rot1, rot1_hat_stddev * noise[0]);
+    delta_trans_hat = delta_trans - trans_hat_stddev * noise[1];
+    delta_rot2_hat = angleutils::angle_diff(delta_rot2, rot2_hat_stddev * noise[2]);
 
     // Apply sampled update to particle pose
     sample->pose.v[0] += delta_trans_hat *
@@ -68,8 +68,13 @@ OmniMotionModel::odometryUpdate(pf_t * pf, const pf_vector_t & pose, const pf_ve
     alpha4_ * (delta_rot * delta_rot) +
     alpha5_ * (delta_trans * delta_trans) );
 
+  // Draw the noise of the whole sample set at once
+  noise_.resize(3 * set->sample_count);
+  pf_rng_gaussian(&pf->rng, noise_.data(), noise_.size());
+
   for (int i = 0; i < set->sample_count; i++) {
     pf_sample_t * sample = set->samples + i;
+    const double * noise = noise_.data() + 3 * i;
 
     delta_bearing = angleutils::angle_diff(
       atan2(delta.v[1], delta.v[0]),
@@ -78,9 +83,9 @@ OmniMotionModel::odometryUpdate(pf_t * pf, const pf_vector_t & pose, const pf_ve
     double sn_bearing = sin(delta_bearing);
 
     // Sample pose differences
-    delta_trans_hat = delta_trans + pf_ran_gaussian(trans_hat_stddev);
-    delta_rot_hat = delta_rot + pf_ran_gaussian(rot_hat_stddev);
-    delta_strafe_hat = 0 + pf_ran_gaussian(strafe_hat_stddev);
+    delta_trans_hat = delta_trans + trans_hat_stddev * noise[0];
+    delta_rot_hat = delta_rot + rot_hat_stddev * noise[1];
+    delta_strafe_hat = 0 + strafe_hat_stddev * noise[2];
     // Apply sampled update to particle pose
     sample->pose.v[0] += (delta_trans_hat * cs_bearing +
       delta_strafe_hat * sn_bearing);
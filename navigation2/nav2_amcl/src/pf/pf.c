@@ -29,11 +29,12 @@
 #include <assert.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include "nav2_amcl/pf/pf.hpp"
 #include "nav2_amcl/pf/pf_pdf.hpp"
-#include "nav2_amcl/pf/pf_kdtree.hpp"
+#include "nav2_amcl/pf/pf_hist.hpp"
 
 #include "portable_utils.h"
 
@@ -42,6 +43,9 @@
 // with samples in them.
 static int pf_resample_limit(pf_t * pf, int k);
 
+// Pick max_samples samples of a set with the low-variance sampler
+static void pf_resample_systematic(pf_t * pf, pf_sample_set_t * set);
+
 
 // Create a new filter
 pf_t * pf_alloc(
@@ -58,6 +62,8 @@ pf_t * pf_alloc(
 
   pf = calloc(1, sizeof(pf_t));
 
+  pf_rng_seed(&pf->rng, time(NULL));
+
   pf->random_pose_fn = random_pose_fn;
   pf->random_pose_data = random_pose_data;
 
@@ -88,8 +94,8 @@ pf_t * pf_alloc(
       sample->weight = 1.0 / max_samples;
     }
 
-    // HACK: is 3 times max_samples enough?
-    set->kdtree = pf_kdtree_alloc(3 * max_samples);
+    // Each sample occupies at most one bin
+    set->hist = pf_hist_alloc(max_samples);
 
     set->cluster_count = 0;
     set->cluster_max_count = max_samples;
@@ -105,6 +111,9 @@ pf_t * pf_alloc(
   pf->alpha_slow = alpha_slow;
   pf->alpha_fast = alpha_fast;
 
+  pf->resample_indices = calloc(max_samples, sizeof(int));
+  pf->limit_cache = calloc(max_samples + 1, sizeof(int));
+
   // set converged to 0
   pf_init_converged(pf);
 
@@ -118,9 +127,11 @@ void pf_free(pf_t * pf)
 
   for (i = 0; i < 2; i++) {
     free(pf->sets[i].clusters);
-    pf_kdtree_free(pf->sets[i].kdtree);
+    pf_hist_free(pf->sets[i].hist);
     free(pf->sets[i].samples);
   }
+  free(pf->resample_indices);
+  free(pf->limit_cache);
   free(pf);
 }
 
@@ -134,8 +145,8 @@ void pf_init(pf_t * pf, pf_vector_t mean, pf_matrix_t cov)
 
   set = pf->sets + pf->current_set;
 
-  // Create the kd tree for adaptive sampling
-  pf_kdtree_clear(set->kdtree);
+  // Create the histogram for adaptive sampling
+  pf_hist_clear(set->hist);
 
   set->sample_count = pf->max_samples;
 
@@ -148,7 +159,7 @@ void pf_init(pf_t * pf, pf_vector_t mean, pf_matrix_t cov)
     sample->pose = pf_pdf_gaussian_sample(pdf);
 
     // Add sample to histogram
-    pf_kdtree_insert(set->kdtree, sample->pose, sample->weight);
+    pf_hist_insert(set->hist, sample->pose, sample->weight);
   }
 
   pf->w_slow = pf->w_fast = 0.0;
@@ -172,8 +183,8 @@ void pf_init_model(pf_t * pf, pf_init_model_fn_t init_fn, void * init_data)
 
   set = pf->sets + pf->current_set;
 
-  // Create the kd tree for adaptive sampling
-  pf_kdtree_clear(set->kdtree);
+  // Create the histogram for adaptive sampling
+  pf_hist_clear(set->hist);
 
   set->sample_count = pf->max_samples;
 
@@ -184,7 +195,7 @@ void pf_init_model(pf_t * pf, pf_init_model_fn_t init_fn, void * init_data)
     sample->pose = (*init_fn)(init_data);
 
     // Add sample to histogram
-    pf_kdtree_insert(set->kdtree, sample->pose, sample->weight);
+    pf_hist_insert(set->hist, sample->pose, sample->weight);
   }
 
   pf->w_slow = pf->w_fast = 0.0;
@@ -293,32 +304,24 @@ void pf_update_sensor(pf_t * pf, pf_sensor_model_fn_t sensor_fn, void * sensor_d
 // Resample the distribution
 void pf_update_resample(pf_t * pf)
 {
-  int i;
+  int i, j, m;
   double total;
   pf_sample_set_t * set_a, * set_b;
   pf_sample_t * sample_a, * sample_b;
-
-  // double r,c,U;
-  // int m;
-  // double count_inv;
-  double * c;
+  int * indices;
 
   double w_diff;
 
   set_a = pf->sets + pf->current_set;
   set_b = pf->sets + (pf->current_set + 1) % 2;
 
-  // Build up cumulative probability table for resampling.
-  // TODO(?): Replace this with a more efficient procedure
-  // (e.g., http://www.network-theory.co.uk/docs/gslref/GeneralDiscreteDistributions.html)
-  c = (double *)malloc(sizeof(double) * (set_a->sample_count + 1));
-  c[0] = 0.0;
-  for (i = 0; i < set_a->sample_count; i++) {
-    c[i + 1] = c[i] + set_a->samples[i].weight;
-  }
+  // Pick max_samples samples from set a in a single pass over its weights
+  pf_resample_systematic(pf, set_a);
+  indices = pf->resample_indices;
+  m = 0;
 
-  // Create the kd tree for adaptive sampling
-  pf_kdtree_clear(set_b->kdtree);
+  // Create the histogram for adaptive sampling
+  pf_hist_clear(set_b->hist);
 
   // Draw samples from set a to create set b.
   total = 0;
@@ -330,60 +333,26 @@ void pf_update_resample(pf_t * pf)
   }
   // printf("w_diff: %9.6f\n", w_diff);
 
-  // Can't (easily) combine low-variance sampler with KLD adaptive
-  // sampling, so we'll take the more traditional route.
-  /*
-  // Low-variance resampler, taken from Probabilistic Robotics, p110
-  count_inv = 1.0/set_a->sample_count;
-  r = drand48() * count_inv;
-  c = set_a->samples[0].weight;
-  i = 0;
-  m = 0;
-  */
   while (set_b->sample_count < pf->max_samples) {
     sample_b = set_b->samples + set_b->sample_count++;
 
-    if (drand48() < w_diff) {
+    if (pf_rng_uniform(&pf->rng) < w_diff) {
       sample_b->pose = (pf->random_pose_fn)(pf->random_pose_data);
     } else {
-      // Can't (easily) combine low-variance sampler with KLD adaptive
-      // sampling, so we'll take the more traditional route.
-      /*
-      // Low-variance resampler, taken from Probabilistic Robotics, p110
-      U = r + m * count_inv;
-      while(U>c)
-      {
-        i++;
-        // Handle wrap-around by resetting counters and picking a new random
-        // number
-        if(i >= set_a->sample_count)
-        {
-          r = drand48() * count_inv;
-          c = set_a->samples[0].weight;
-          i = 0;
-          m = 0;
-          U = r + m * count_inv;
-          continue;
-        }
-        c += set_a->samples[i].weight;
+      // KLD adaptive sampling stops after an unknown number of samples, so take
+      // the picked samples in random order (an incremental Fisher-Yates
+      // shuffle); the samples taken before stopping are then an unbiased draw.
+      j = m + (int)(pf_rng_uniform(&pf->rng) * (pf->max_samples - m));
+      if (j >= pf->max_samples) {
+        j = pf->max_samples - 1;
       }
+      i = indices[j];
+      indices[j] = indices[m];
+      indices[m] = i;
       m++;
-      */
-
-      // Naive discrete event sampler
-      double r;
-      r = drand48();
-      for (i = 0; i < set_a->sample_count; i++) {
-        if ((c[i] <= r) && (r < c[i + 1])) {
-          break;
-        }
-      }
-      assert(i < set_a->sample_count);
 
       sample_a = set_a->samples + i;
 
-      assert(sample_a->weight > 0);
-
       // Add sample to list
       sample_b->pose = sample_a->pose;
     }
@@ -392,10 +361,10 @@ void pf_update_resample(pf_t * pf)
     total += sample_b->weight;
 
     // Add sample to histogram
-    pf_kdtree_insert(set_b->kdtree, sample_b->pose, sample_b->weight);
+    pf_hist_insert(set_b->hist, sample_b->pose, sample_b->weight);
 
     // See if we have enough samples yet
-    if (set_b->sample_count > pf_resample_limit(pf, set_b->kdtree->leaf_count)) {
+    if (set_b->sample_count > pf_resample_limit(pf, set_b->hist->bin_count)) {
       break;
     }
   }
@@ -420,8 +389,35 @@ void pf_update_resample(pf_t * pf)
   pf->current_set = (pf->current_set + 1) % 2;
 
   pf_update_converged(pf);
+}
+
 
-  free(c);
+// Low-variance resampler, taken from Probabilistic Robotics, p110: max_samples
+// pointers spaced evenly over the cumulative weights, from a single random
+// offset, pick each sample about weight * max_samples times.
+void pf_resample_systematic(pf_t * pf, pf_sample_set_t * set)
+{
+  int i, m;
+  double total, step, u, c;
+
+  total = 0.0;
+  for (i = 0; i < set->sample_count; i++) {
+    total += set->samples[i].weight;
+  }
+
+  step = total / pf->max_samples;
+  u = pf_rng_uniform(&pf->rng) * step;
+  c = set->samples[0].weight;
+  i = 0;
+  for (m = 0; m < pf->max_samples; m++) {
+    // The last sample takes any pointer rounding leaves past the total
+    while (u > c && i < set->sample_count - 1) {
+      i++;
+      c += set->samples[i].weight;
+    }
+    pf->resample_indices[m] = i;
+    u += step;
+  }
 }
 
 
@@ -436,6 +432,16 @@ int pf_resample_limit(pf_t * pf, int k)
     return pf->max_samples;
   }
 
+  // The limit is looked up for every sample drawn; compute it once per k
+  if (pf->limit_cache_err != pf->pop_err || pf->limit_cache_z != pf->pop_z) {
+    memset(pf->limit_cache, 0, (pf->max_samples + 1) * sizeof(int));
+    pf->limit_cache_err = pf->pop_err;
+    pf->limit_cache_z = pf->pop_z;
+  }
+  if (k <= pf->max_samples && pf->limit_cache[k] > 0) {
+    return pf->limit_cache[k];
+  }
+
   a = 1;
   b = 2 / (9 * ((double) k - 1));
   c = sqrt(2 / (9 * ((double) k - 1))) * pf->pop_z;
@@ -444,12 +450,15 @@ int pf_resample_limit(pf_t * pf, int k)
   n = (int) ceil((k - 1) / (2 * pf->pop_err) * x * x * x);
 
   if (n < pf->min_samples) {
-    return pf->min_samples;
+    n = pf->min_samples;
   }
   if (n > pf->max_samples) {
-    return pf->max_samples;
+    n = pf->max_samples;
   }
 
+  if (k <= pf->max_samples) {
+    pf->limit_cache[k] = n;
+  }
   return n;
 }
 
@@ -468,7 +477,7 @@ void pf_cluster_stats(pf_t * pf, pf_sample_set_t * set)
   double weight;
 
   // Cluster the samples
-  pf_kdtree_cluster(set->kdtree);
+  pf_hist_cluster(set->hist);
 
   // Initialize cluster stats
   set->cluster_count = 0;
@@ -511,7 +520,7 @@ void pf_cluster_stats(pf_t * pf, pf_sample_set_t * set)
     // printf("%d %f %f %f\n", i, sample->pose.v[0], sample->pose.v[1], sample->pose.v[2]);
 
     // Get the cluster label for this sample
-    cidx = pf_kdtree_get_cluster(set->kdtree, sample->pose);
+    cidx = pf_hist_get_cluster(set->hist, sample->pose);
     assert(cidx >= 0);
     if (cidx >= set->cluster_max_count) {
       continue;
@@ -0,0 +1,297 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  Brian Gerkey   &  Kasper Stoy
+ *                      gerkey@usc.edu    kaspers@robotics.usc.edu
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+/**************************************************************************
+ * Desc: Pose histogram functions
+ * Author: Andrew Howard
+ * Date: 18 Dec 2002
+ * CVS: $Id: pf_kdtree.c 7057 2008-10-02 00:44:06Z gbiggs $
+ *************************************************************************/
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#include "nav2_amcl/pf/pf_vector.hpp"
+#include "nav2_amcl/pf/pf_hist.hpp"
+
+
+// Compute the bin key of a pose
+static void pf_hist_key(pf_hist_t * self, pf_vector_t pose, int key[]);
+
+// Find the slot of a key: the slot holding its bin, or the empty slot where
+// the bin would go
+static int pf_hist_find_slot(pf_hist_t * self, const int key[]);
+
+// Find the root of the cluster tree of a bin, halving the path on the way
+static int pf_hist_find_root(pf_hist_t * self, int i);
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Create a histogram
+pf_hist_t * pf_hist_alloc(int max_size)
+{
+  pf_hist_t * self;
+
+  self = calloc(1, sizeof(pf_hist_t));
+
+  self->size[0] = 0.50;
+  self->size[1] = 0.50;
+  self->size[2] = (10 * M_PI / 180);
+
+  self->bin_count = 0;
+  self->bin_max_count = max_size;
+  self->bins = calloc(self->bin_max_count, sizeof(pf_hist_bin_t));
+
+  // Keep the table at most half full, so that probe sequences stay short
+  self->slot_count = 1;
+  while (self->slot_count < 2 * max_size) {
+    self->slot_count *= 2;
+  }
+  self->slots = malloc(self->slot_count * sizeof(int));
+  memset(self->slots, -1, self->slot_count * sizeof(int));
+
+  return self;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Destroy a histogram
+void pf_hist_free(pf_hist_t * self)
+{
+  free(self->slots);
+  free(self->bins);
+  free(self);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Clear all entries from the histogram; only the slots in use are reset
+void pf_hist_clear(pf_hist_t * self)
+{
+  int i;
+
+  for (i = 0; i < self->bin_count; i++) {
+    self->slots[self->bins[i].slot] = -1;
+  }
+  self->bin_count = 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Insert a pose into the histogram.
+void pf_hist_insert(pf_hist_t * self, pf_vector_t pose, double value)
+{
+  int key[3];
+  int slot;
+  pf_hist_bin_t * bin;
+
+  pf_hist_key(self, pose, key);
+
+  slot = pf_hist_find_slot(self, key);
+  if (self->slots[slot] >= 0) {
+    self->bins[self->slots[slot]].value += value;
+    return;
+  }
+
+  assert(self->bin_count < self->bin_max_count);
+  self->slots[slot] = self->bin_count;
+  bin = self->bins + self->bin_count++;
+  bin->key[0] = key[0];
+  bin->key[1] = key[1];
+  bin->key[2] = key[2];
+  bin->value = value;
+  bin->cluster = -1;
+  bin->slot = slot;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Determine the probability estimate for the given pose. TODO: this
+// should do a kernel density estimate rather than a simple histogram.
+double pf_hist_get_prob(pf_hist_t * self, pf_vector_t pose)
+{
+  int key[3];
+  int slot;
+
+  pf_hist_key(self, pose, key);
+
+  slot = pf_hist_find_slot(self, key);
+  if (self->slots[slot] < 0) {
+    return 0.0;
+  }
+  return self->bins[self->slots[slot]].value;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Determine the cluster label for the given pose
+int pf_hist_get_cluster(pf_hist_t * self, pf_vector_t pose)
+{
+  int key[3];
+  int slot;
+
+  pf_hist_key(self, pose, key);
+
+  slot = pf_hist_find_slot(self, key);
+  if (self->slots[slot] < 0) {
+    return -1;
+  }
+  return self->bins[self->slots[slot]].cluster;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Compute the bin key of a pose
+void pf_hist_key(pf_hist_t * self, pf_vector_t pose, int key[])
+{
+  key[0] = floor(pose.v[0] / self->size[0]);
+  key[1] = floor(pose.v[1] / self->size[1]);
+  key[2] = floor(pose.v[2] / self->size[2]);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Find the slot of a key, probing linearly from its hash
+int pf_hist_find_slot(pf_hist_t * self, const int key[])
+{
+  unsigned int hash;
+  int slot, i;
+  const pf_hist_bin_t * bin;
+
+  hash = (unsigned int) key[0] * 73856093u ^
+    (unsigned int) key[1] * 19349663u ^
+    (unsigned int) key[2] * 83492791u;
+
+  slot = hash & (self->slot_count - 1);
+  while ((i = self->slots[slot]) >= 0) {
+    bin = self->bins + i;
+    if (bin->key[0] == key[0] && bin->key[1] == key[1] && bin->key[2] == key[2]) {
+      break;
+    }
+    slot = (slot + 1) & (self->slot_count - 1);
+  }
+  return slot;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Find the root of the cluster tree of a bin
+int pf_hist_find_root(pf_hist_t * self, int i)
+{
+  pf_hist_bin_t * bins = self->bins;
+
+  while (bins[i].cluster != i) {
+    bins[i].cluster = bins[bins[i].cluster].cluster;
+    i = bins[i].cluster;
+  }
+  return i;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Label the connected components of the occupied bins, where bins are
+// connected to the 26 bins around them.  Each bin starts as a cluster of its
+// own, and the clusters of neighbouring bins are merged (union-find); the
+// root of a cluster is kept at its first bin, so that the clusters are
+// labelled in the order their bins were first hit.
+void pf_hist_cluster(pf_hist_t * self)
+{
+  int i, n, a, b, slot;
+  int nkey[3];
+  pf_hist_bin_t * bin;
+
+  for (i = 0; i < self->bin_count; i++) {
+    self->bins[i].cluster = i;
+  }
+
+  for (i = 0; i < self->bin_count; i++) {
+    bin = self->bins + i;
+
+    // Each pair of neighbours needs merging once, so only the 13 neighbours
+    // that come after this bin are looked up
+    for (n = 3 * 3 * 3 / 2 + 1; n < 3 * 3 * 3; n++) {
+      nkey[0] = bin->key[0] + (n / 9) - 1;
+      nkey[1] = bin->key[1] + ((n % 9) / 3) - 1;
+      nkey[2] = bin->key[2] + ((n % 9) % 3) - 1;
+
+      slot = pf_hist_find_slot(self, nkey);
+      if (self->slots[slot] < 0) {
+        continue;
+      }
+
+      a = pf_hist_find_root(self, i);
+      b = pf_hist_find_root(self, self->slots[slot]);
+      if (a < b) {
+        self->bins[b].cluster = a;
+      } else if (b < a) {
+        self->bins[a].cluster = b;
+      }
+    }
+  }
+
+  // Parents always come before their children, so in bin order the parent of
+  // each bin already points at its root, and then each root is labelled
+  // before the rest of its cluster
+  for (i = 0; i < self->bin_count; i++) {
+    self->bins[i].cluster = self->bins[self->bins[i].cluster].cluster;
+  }
+  n = 0;
+  for (i = 0; i < self->bin_count; i++) {
+    a = self->bins[i].cluster;
+    if (a == i) {
+      self->bins[i].cluster = n++;
+    } else {
+      self->bins[i].cluster = self->bins[a].cluster;
+    }
+  }
+}
+
+
+#ifdef INCLUDE_RTKGUI
+
+////////////////////////////////////////////////////////////////////////////////
+// Draw the histogram
+void pf_hist_draw(pf_hist_t * self, rtk_fig_t * fig)
+{
+  int i;
+  double ox, oy;
+  char text[64];
+  pf_hist_bin_t * bin;
+
+  for (i = 0; i < self->bin_count; i++) {
+    bin = self->bins + i;
+
+    ox = (bin->key[0] + 0.5) * self->size[0];
+    oy = (bin->key[1] + 0.5) * self->size[1];
+
+    rtk_fig_rectangle(fig, ox, oy, 0.0, self->size[0], self->size[1], 0);
+
+    // snprintf(text, sizeof(text), "%0.3f", bin->value);
+    // rtk_fig_text(fig, ox, oy, 0.0, text);
+
+    snprintf(text, sizeof(text), "%d", bin->cluster);
+    rtk_fig_text(fig, ox, oy, 0.0, text);
+  }
+}
+
+#endif
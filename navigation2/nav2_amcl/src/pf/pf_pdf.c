@@ -40,6 +40,67 @@
 static unsigned int pf_pdf_seed;
 
 
+/**************************************************************************
+ * Random numbers
+ *************************************************************************/
+
+static inline uint64_t pf_rng_rotl(uint64_t x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+// The state is expanded from the seed with splitmix64, as recommended by the
+// authors of xoshiro, so that similar seeds still give unrelated sequences
+void pf_rng_seed(pf_rng_t * rng, uint64_t seed)
+{
+  int i;
+  uint64_t z;
+
+  for (i = 0; i < 4; i++) {
+    seed += 0x9e3779b97f4a7c15ULL;
+    z = seed;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    rng->s[i] = z ^ (z >> 31);
+  }
+}
+
+// xoshiro256** (Blackman & Vigna), taking the top 53 bits as the mantissa
+double pf_rng_uniform(pf_rng_t * rng)
+{
+  uint64_t * s = rng->s;
+  const uint64_t result = pf_rng_rotl(s[1] * 5, 7) * 9;
+  const uint64_t t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = pf_rng_rotl(s[3], 45);
+
+  return (result >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Unlike the polar form in pf_ran_gaussian(), this form has no rejection
+// loop, so a batch takes a fixed number of draws and calls
+void pf_rng_gaussian(pf_rng_t * rng, double * values, int count)
+{
+  int i;
+  double r, a;
+
+  for (i = 0; i < count; i += 2) {
+    // 1 - u is in (0, 1], so the log is finite
+    r = sqrt(-2.0 * log(1.0 - pf_rng_uniform(rng)));
+    a = 2.0 * M_PI * pf_rng_uniform(rng);
+    values[i] = r * cos(a);
+    if (i + 1 < count) {
+      values[i + 1] = r * sin(a);
+    }
+  }
+}
+
+
 /**************************************************************************
  * Gaussian
  *************************************************************************/
@@ -21,6 +21,7 @@
 
 #include <math.h>
 #include <assert.h>
+#include <algorithm>
 
 #include "nav2_amcl/sensors/laser/laser.hpp"
 
@@ -46,42 +47,54 @@ double
 BeamModel::sensorFunction(LaserData * data, pf_sample_set_t * set)
 {
   BeamModel * self;
-  int i, j, step;
-  double z, pz;
-  double p;
-  double map_range;
-  double obs_range, obs_bearing;
+  int j, step;
   double total_weight;
-  pf_sample_t * sample;
-  pf_vector_t pose;
 
   self = reinterpret_cast<BeamModel *>(data->laser);
 
-  total_weight = 0.0;
+  step = (data->range_count - 1) / (self->max_beams_ - 1);
+
+  // Step size must be at least 1
+  if (step < 1) {
+    step = 1;
+  }
 
-  // Compute the sample weights
+  // The ranges according to the map are looked up rather than traced if the map has
+  // them precomputed far enough
+  const bool use_range_table = self->map_->range_table != NULL &&
+    data->range_max <= self->map_->range_table_max_range;
+
+  // Compute the sample weights. Each particle only touches its own sample and the
+  // map is read-only here, so the particles are split across threads.
+  #pragma omp parallel for num_threads(self->threads_) schedule(static)
   for (j = 0; j < set->sample_count; j++) {
-    sample = set->samples + j;
-    pose = sample->pose;
+    pf_sample_t * sample = set->samples + j;
+    pf_vector_t pose = sample->pose;
 
     // Take account of the laser pose relative to the robot
     pose = pf_vector_coord_add(self->laser_pose_, pose);
 
-    p = 1.0;
+    double p = 1.0;
 
-    step = (data->range_count - 1) / (self->max_beams_ - 1);
-    for (i = 0; i < data->range_count; i += step) {
-      obs_range = data->ranges[i][0];
-      obs_bearing = data->ranges[i][1];
+    for (int i = 0; i < data->range_count; i += step) {
+      double obs_range = data->ranges[i][0];
+      double obs_bearing = data->ranges[i][1];
 
       // Compute the range according to the map
-      map_range = map_calc_range(
-        self->map_, pose.v[0], pose.v[1],
-        pose.v[2] + obs_bearing, data->range_max);
-      pz = 0.0;
+      double map_range;
+      if (use_range_table) {
+        map_range = std::min(
+          map_lookup_range(self->map_, pose.v[0], pose.v[1], pose.v[2] + obs_bearing),
+          data->range_max);
+      } else {
+        map_range = map_calc_range(
+          self->map_, pose.v[0], pose.v[1],
+          pose.v[2] + obs_bearing, data->range_max);
+      }
+      double pz = 0.0;
 
       // Part 1: good, but noisy, hit
-      z = obs_range - map_range;
+      double z = obs_range - map_range;
       pz += self->z_hit_ * exp(-(z * z) / (2 * self->sigma_hit_ * self->sigma_hit_));
 
       // Part 2: short reading from unexpected obstacle (e.g., a person)
@@ -110,7 +123,12 @@ BeamModel::sensorFunction(LaserData * data, pf_sample_set_t * set)
     }
 
     sample->weight *= p;
-    total_weight += sample->weight;
+  }
+
+  // Summed in sample order so the total does not depend on the number of threads
+  total_weight = 0.0;
+  for (j = 0; j < set->sample_count; j++) {
+    total_weight += set->samples[j].weight;
   }
 
   return total_weight;
@@ -30,7 +30,7 @@ namespace nav2_amcl
 {
 
 Laser::Laser(size_t max_beams, map_t * map)
-: max_samples_(0), max_obs_(0), temp_obs_(NULL)
+: max_samples_(0), max_obs_(0), temp_obs_(NULL), threads_(1)
 {
   max_beams_ = max_beams;
   map_ = map;
@@ -70,4 +70,10 @@ Laser::SetLaserPose(pf_vector_t & laser_pose)
   laser_pose_ = laser_pose;
 }
 
+void
+Laser::SetThreads(int threads)
+{
+  threads_ = threads < 1 ? 1 : threads;
+}
+
 }  // namespace nav2_amcl
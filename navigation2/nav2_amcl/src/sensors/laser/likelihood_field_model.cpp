@@ -20,7 +20,6 @@
  */
 
 #include <math.h>
-#include <assert.h>
 
 #include "nav2_amcl/sensors/laser/laser.hpp"
 
@@ -35,89 +34,122 @@ LikelihoodFieldModel::LikelihoodFieldModel(
   z_hit_ = z_hit;
   z_rand_ = z_rand;
   sigma_hit_ = sigma_hit;
-  map_update_cspace(map, max_occ_dist);
+  // The distances may already be up to date, computed for another laser or loaded
+  // from a cache by the node
+  if (map->occ_dist == NULL || map->max_occ_dist != max_occ_dist) {
+    map_update_cspace(map, max_occ_dist);
+  }
+
+  // The Gaussian part of the model only depends on the cell a beam ends in, so it
+  // is computed once per cell rather than once per beam and particle, and stored
+  // in 16 bits to keep the grid small enough for random access to stay in cache
+  // NOTE: this should have a normalization of 1/(sqrt(2pi)*sigma)
+  double z_hit_denom = 2 * sigma_hit_ * sigma_hit_;
+  int cell_count = map_->size_x * map_->size_y;
+  hit_likelihood_.resize(cell_count);
+  for (int k = 0; k < cell_count; k++) {
+    double z = map_->occ_dist[k];
+    hit_likelihood_[k] = static_cast<uint16_t>(exp(-(z * z) / z_hit_denom) * UINT16_MAX + 0.5);
+  }
+  hit_likelihood_scale_ = z_hit_ / UINT16_MAX;
+
+  // Off-map penalized as max distance
+  off_map_hit_likelihood_ =
+    z_hit_ * exp(-(map_->max_occ_dist * map_->max_occ_dist) / z_hit_denom);
+}
+
+void
+LikelihoodFieldModel::setBeams(LaserData * data)
+{
+  int step = (data->range_count - 1) / (max_beams_ - 1);
+
+  // Step size must be at least 1
+  if (step < 1) {
+    step = 1;
+  }
+
+  beam_x_.clear();
+  beam_y_.clear();
+  for (int i = 0; i < data->range_count; i += step) {
+    double obs_range = data->ranges[i][0];
+    double obs_bearing = data->ranges[i][1];
+
+    // This model ignores max range readings
+    if (obs_range >= data->range_max) {
+      continue;
+    }
+
+    // Check for NaN
+    if (obs_range != obs_range) {
+      continue;
+    }
+
+    beam_x_.push_back(obs_range * cos(obs_bearing));
+    beam_y_.push_back(obs_range * sin(obs_bearing));
+  }
 }
 
 double
 LikelihoodFieldModel::sensorFunction(LaserData * data, pf_sample_set_t * set)
 {
   LikelihoodFieldModel * self;
-  int i, j, step;
-  double z, pz;
-  double p;
-  double obs_range, obs_bearing;
+  int j;
   double total_weight;
-  pf_sample_t * sample;
-  pf_vector_t pose;
-  pf_vector_t hit;
 
   self = reinterpret_cast<LikelihoodFieldModel *>(data->laser);
 
-  total_weight = 0.0;
-
-  // Compute the sample weights
+  self->setBeams(data);
+
+  // Pre-compute a couple of things
+  const map_t * map = self->map_;
+  const double z_rand = self->z_rand_ * (1.0 / data->range_max);
+  const double inv_scale = 1.0 / map->scale;
+  const double size_x = map->size_x;
+  const double size_y = map->size_y;
+  const double center_x = 0.5 + map->size_x / 2;
+  const double center_y = 0.5 + map->size_y / 2;
+  const int beam_count = self->beam_x_.size();
+  const double * beam_x = self->beam_x_.data();
+  const double * beam_y = self->beam_y_.data();
+  const uint16_t * hit_likelihood = self->hit_likelihood_.data();
+  const double hit_likelihood_scale = self->hit_likelihood_scale_;
+  const double off_map_hit_likelihood = self->off_map_hit_likelihood_;
+
+  // Compute the sample weights, splitting the particles across threads
+  #pragma omp parallel for num_threads(self->threads_) schedule(static)
   for (j = 0; j < set->sample_count; j++) {
-    sample = set->samples + j;
-    pose = sample->pose;
+    pf_sample_t * sample = set->samples + j;
+    pf_vector_t pose = sample->pose;
 
     // Take account of the laser pose relative to the robot
     pose = pf_vector_coord_add(self->laser_pose_, pose);
 
-    p = 1.0;
+    // The beam end points are the beams rotated by the pose heading and shifted by its
+    // position, done here directly in map grid coords
+    const double rot_cos = cos(pose.v[2]) * inv_scale;
+    const double rot_sin = sin(pose.v[2]) * inv_scale;
+    const double origin_x = (pose.v[0] - map->origin_x) * inv_scale + center_x;
+    const double origin_y = (pose.v[1] - map->origin_y) * inv_scale + center_y;
 
-    // Pre-compute a couple of things
-    double z_hit_denom = 2 * self->sigma_hit_ * self->sigma_hit_;
-    double z_rand_mult = 1.0 / data->range_max;
+    double p = 1.0;
 
-    step = (data->range_count - 1) / (self->max_beams_ - 1);
+    // Without branches or calls, so that the compiler can vectorize it
+    #pragma omp simd reduction(+:p)
+    for (int i = 0; i < beam_count; i++) {
+      double gx = origin_x + rot_cos * beam_x[i] - rot_sin * beam_y[i];
+      double gy = origin_y + rot_sin * beam_x[i] + rot_cos * beam_y[i];
 
-    // Step size must be at least 1
-    if (step < 1) {
-      step = 1;
-    }
+      // Part 1: Likelihood of the distance from the hit to closest obstacle
+      // The grid coords are floor(gx), floor(gy), which truncation gives on the map
+      bool valid = (gx >= 0.0) & (gx < size_x) & (gy >= 0.0) & (gy < size_y);
+      int index = valid ? static_cast<int>(gx) + static_cast<int>(gy) * map->size_x : 0;
+      double pz = valid ? hit_likelihood[index] * hit_likelihood_scale : off_map_hit_likelihood;
 
-    for (i = 0; i < data->range_count; i += step) {
-      obs_range = data->ranges[i][0];
-      obs_bearing = data->ranges[i][1];
-
-      // This model ignores max range readings
-      if (obs_range >= data->range_max) {
-        continue;
-      }
-
-      // Check for NaN
-      if (obs_range != obs_range) {
-        continue;
-      }
-
-      pz = 0.0;
-
-      // Compute the endpoint of the beam
-      hit.v[0] = pose.v[0] + obs_range * cos(pose.v[2] + obs_bearing);
-      hit.v[1] = pose.v[1] + obs_range * sin(pose.v[2] + obs_bearing);
-
-      // Convert to map grid coords.
-      int mi, mj;
-      mi = MAP_GXWX(self->map_, hit.v[0]);
-      mj = MAP_GYWY(self->map_, hit.v[1]);
-
-      // Part 1: Get distance from the hit to closest obstacle.
-      // Off-map penalized as max distance
-      if (!MAP_VALID(self->map_, mi, mj)) {
-        z = self->map_->max_occ_dist;
-      } else {
-        z = self->map_->cells[MAP_INDEX(self->map_, mi, mj)].occ_dist;
-      }
-      // Gaussian model
-      // NOTE: this should have a normalization of 1/(sqrt(2pi)*sigma)
-      pz += self->z_hit_ * exp(-(z * z) / z_hit_denom);
       // Part 2: random measurements
-      pz += self->z_rand_ * z_rand_mult;
+      pz += z_rand;
 
       // TODO(?): outlier rejection for short readings
 
-      assert(pz <= 1.0);
-      assert(pz >= 0.0);
       //      p *= pz;
       // here we have an ad-hoc weighting scheme for combining beam probs
       // works well, though...
@@ -125,7 +157,12 @@ LikelihoodFieldModel::sensorFunction(LaserData * data, pf_sample_set_t * set)
     }
 
     sample->weight *= p;
-    total_weight += sample->weight;
+  }
+
+  // Summed in sample order so the total does not depend on the number of threads
+  total_weight = 0.0;
+  for (j = 0; j < set->sample_count; j++) {
+    total_weight += set->samples[j].weight;
   }
 
   return total_weight;
@@ -44,7 +44,11 @@ LikelihoodFieldModelProb::LikelihoodFieldModelProb(
   beam_skip_distance_ = beam_skip_distance;
   beam_skip_threshold_ = beam_skip_threshold;
   beam_skip_error_threshold_ = beam_skip_error_threshold;
-  map_update_cspace(map, max_occ_dist);
+  // The distances may already be up to date, computed for another laser or loaded
+  // from a cache by the node
+  if (map->occ_dist == NULL || map->max_occ_dist != max_occ_dist) {
+    map_update_cspace(map, max_occ_dist);
+  }
 }
 
 // Determine the probability for the given pose
@@ -52,19 +56,11 @@ double
 LikelihoodFieldModelProb::sensorFunction(LaserData * data, pf_sample_set_t * set)
 {
   LikelihoodFieldModelProb * self;
-  int i, j, step;
-  double z, pz;
-  double log_p;
-  double obs_range, obs_bearing;
+  int j, step;
   double total_weight;
-  pf_sample_t * sample;
-  pf_vector_t pose;
-  pf_vector_t hit;
 
   self = reinterpret_cast<LikelihoodFieldModelProb *>(data->laser);
 
-  total_weight = 0.0;
-
   step = ceil((data->range_count) / static_cast<double>(self->max_beams_));
 
   // Step size must be at least 1
@@ -98,8 +94,6 @@ LikelihoodFieldModelProb::sensorFunction(LaserData * data, pf_sample_set_t * set
   // all particles)
   bool * obs_mask = new bool[self->max_beams_]();
 
-  int beam_ind = 0;
-
   // realloc indicates if we need to reallocate the temp data structure needed to do beamskipping
   bool realloc = false;
 
@@ -118,21 +112,26 @@ LikelihoodFieldModelProb::sensorFunction(LaserData * data, pf_sample_set_t * set
     }
   }
 
-  // Compute the sample weights
+  // Compute the sample weights, splitting the particles across threads. Each
+  // particle writes only its own sample and row of temp_obs_; the per beam counts
+  // of agreeing particles are summed over the threads.
+  const int max_beams = self->max_beams_;
+  #pragma omp parallel for num_threads(self->threads_) schedule(static) \
+  reduction(+:obs_count[:max_beams])
   for (j = 0; j < set->sample_count; j++) {
-    sample = set->samples + j;
-    pose = sample->pose;
+    pf_sample_t * sample = set->samples + j;
+    pf_vector_t pose = sample->pose;
 
     // Take account of the laser pose relative to the robot
     pose = pf_vector_coord_add(self->laser_pose_, pose);
 
-    log_p = 0;
+    double log_p = 0;
 
-    beam_ind = 0;
+    int beam_ind = 0;
 
-    for (i = 0; i < data->range_count; i += step, beam_ind++) {
-      obs_range = data->ranges[i][0];
-      obs_bearing = data->ranges[i][1];
+    for (int i = 0; i < data->range_count; i += step, beam_ind++) {
+      double obs_range = data->ranges[i][0];
+      double obs_bearing = data->ranges[i][1];
 
       // This model ignores max range readings
       if (obs_range >= data->range_max) {
@@ -144,7 +143,8 @@ LikelihoodFieldModelProb::sensorFunction(LaserData * data, pf_sample_set_t * set
         continue;
       }
 
-      pz = 0.0;
+      double z, pz = 0.0;
+      pf_vector_t hit;
 
       // Compute the endpoint of the beam
       hit.v[0] = pose.v[0] + obs_range * cos(pose.v[2] + obs_bearing);
@@ -161,7 +161,7 @@ LikelihoodFieldModelProb::sensorFunction(LaserData * data, pf_sample_set_t * set
       if (!MAP_VALID(self->map_, mi, mj)) {
         pz += self->z_hit_ * max_dist_prob;
       } else {
-        z = self->map_->cells[MAP_INDEX(self->map_, mi, mj)].occ_dist;
+        z = self->map_->occ_dist[MAP_INDEX(self->map_, mi, mj)];
         if (z < beam_skip_distance) {
           obs_count[beam_ind] += 1;
         }
@@ -187,11 +187,11 @@ LikelihoodFieldModelProb::sensorFunction(LaserData * data, pf_sample_set_t * set
     }
     if (!do_beamskip) {
       sample->weight *= exp(log_p);
-      total_weight += sample->weight;
     }
   }
 
   if (do_beamskip) {
+    int beam_ind;
     int skipped_beam_count = 0;
     for (beam_ind = 0; beam_ind < self->max_beams_; beam_ind++) {
       if ((obs_count[beam_ind] / static_cast<double>(set->sample_count)) > beam_skip_threshold) {
@@ -217,24 +217,26 @@ LikelihoodFieldModelProb::sensorFunction(LaserData * data, pf_sample_set_t * set
       error = true;
     }
 
+    #pragma omp parallel for num_threads(self->threads_) schedule(static)
     for (j = 0; j < set->sample_count; j++) {
-      sample = set->samples + j;
-      pose = sample->pose;
-
-      log_p = 0;
+      double log_p = 0;
 
-      for (beam_ind = 0; beam_ind < self->max_beams_; beam_ind++) {
-        if (error || obs_mask[beam_ind]) {
-          log_p += log(self->temp_obs_[j][beam_ind]);
+      for (int k = 0; k < max_beams; k++) {
+        if (error || obs_mask[k]) {
+          log_p += log(self->temp_obs_[j][k]);
         }
       }
 
-      sample->weight *= exp(log_p);
-
-      total_weight += sample->weight;
+      set->samples[j].weight *= exp(log_p);
     }
   }
 
+  // Summed in sample order so the total does not depend on the number of threads
+  total_weight = 0.0;
+  for (j = 0; j < set->sample_count; j++) {
+    total_weight += set->samples[j].weight;
+  }
+
   delete[] obs_count;
   delete[] obs_mask;
   return total_weight;
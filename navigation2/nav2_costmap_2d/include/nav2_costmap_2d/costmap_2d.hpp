@@ -262,7 +262,8 @@ public:
   }
 
   /**
-   * @brief  Sets the cost of a convex polygon to a desired value
+   * @brief  Sets the cost of a polygon to a desired value. The polygon does not
+   * need to be convex, see rasterizePolygon() for the cells covered.
    * @param polygon The polygon to perform the operation on
    * @param cost_value The value to set costs to
    * @return True if the polygon was filled... false if it could not be filled
@@ -281,7 +282,7 @@ public:
     std::vector<MapLocation> & polygon_cells);
 
   /**
-   * @brief  Get the map cells that fill a convex polygon
+   * @brief  Get the map cells that fill a polygon, see rasterizePolygon()
    * @param polygon The polygon in map coordinates to rasterize
    * @param polygon_cells Will be set to the cells that fill the polygon
    */
@@ -289,6 +290,53 @@ public:
     const std::vector<MapLocation> & polygon,
     std::vector<MapLocation> & polygon_cells);
 
+  /**
+   * @brief  Rasterize a polygon row by row and apply some action to each span of
+   * cells it covers. Covered are the cells along its outline, stepped like
+   * raytraceLine(), and the cells whose center lies inside it (even-odd rule), so
+   * the polygon does not need to be convex. Polygons with fewer than 3 vertices
+   * cover no cells.
+   * @param  at The action to take... a functor called as at(y, x_begin, x_end)
+   * for the cells [x_begin, x_end) of row y, each row's spans disjoint and in order
+   * @param  polygon The polygon in map coordinates to rasterize
+   */
+  template<class SpanActionType>
+  void rasterizePolygon(SpanActionType at, const std::vector<MapLocation> & polygon) const
+  {
+    const unsigned int num_vertices = polygon.size();
+    if (num_vertices < 3) {
+      return;
+    }
+
+    unsigned int min_y = polygon[0].y, max_y = polygon[0].y;
+    for (unsigned int i = 1; i < num_vertices; ++i) {
+      min_y = std::min(min_y, polygon[i].y);
+      max_y = std::max(max_y, polygon[i].y);
+    }
+
+    // A row holds at most one span per edge and one per pair of crossings; keep
+    // the buffers on the stack for footprint sized polygons
+    MapSpan stack_spans[2 * MAX_STACK_POLYGON_VERTICES];
+    double stack_crossings[MAX_STACK_POLYGON_VERTICES];
+    std::vector<MapSpan> heap_spans;
+    std::vector<double> heap_crossings;
+    MapSpan * spans = stack_spans;
+    double * crossings = stack_crossings;
+    if (num_vertices > MAX_STACK_POLYGON_VERTICES) {
+      heap_spans.resize(2 * num_vertices);
+      heap_crossings.resize(num_vertices);
+      spans = heap_spans.data();
+      crossings = heap_crossings.data();
+    }
+
+    for (unsigned int y = min_y; y <= max_y; ++y) {
+      unsigned int num_spans = polygonRowSpans(polygon, y, spans, crossings);
+      for (unsigned int i = 0; i < num_spans; ++i) {
+        at(y, spans[i].begin, spans[i].end);
+      }
+    }
+  }
+
   /**
    * @brief  Move the origin of the costmap to a new location.... keeping data when it can
    * @param  new_origin_x The x coordinate of the new origin
@@ -452,6 +500,26 @@ private:
     return x > 0 ? 1.0 : -1.0;
   }
 
+  /// Cells [begin, end) of a map row
+  struct MapSpan
+  {
+    unsigned int begin;
+    unsigned int end;
+  };
+
+  static constexpr unsigned int MAX_STACK_POLYGON_VERTICES = 32;
+
+  /**
+   * @brief  Compute the sorted, disjoint spans of row y covered by a polygon of
+   * at least 3 vertices
+   * @param  spans Output buffer for at least twice as many spans as polygon vertices
+   * @param  crossings Scratch buffer for as many values as polygon vertices
+   * @return The number of spans
+   */
+  unsigned int polygonRowSpans(
+    const std::vector<MapLocation> & polygon, unsigned int y,
+    MapSpan * spans, double * crossings) const;
+
   mutex_t * access_;
 
 protected:
@@ -481,6 +549,24 @@ protected:
     unsigned char value_;
   };
 
+  class MarkSpan
+  {
+  public:
+    MarkSpan(unsigned char * costmap, unsigned int size_x, unsigned char value)
+    : costmap_(costmap), size_x_(size_x), value_(value)
+    {
+    }
+    inline void operator()(unsigned int y, unsigned int x_begin, unsigned int x_end)
+    {
+      memset(costmap_ + y * size_x_ + x_begin, value_, x_end - x_begin);
+    }
+
+  private:
+    unsigned char * costmap_;
+    unsigned int size_x_;
+    unsigned char value_;
+  };
+
   class PolygonOutlineCells
   {
   public:
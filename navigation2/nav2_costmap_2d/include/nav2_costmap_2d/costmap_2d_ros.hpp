@@ -185,6 +185,18 @@ public:
     return layered_costmap_;
   }
 
+  /**
+   * @brief Return the max-pooled pyramid of the master costmap, or nullptr if
+   * the pyramid_levels parameter is 0.
+   *
+   * Same as calling getLayeredCostmap()->getPyramid(). Lock the master costmap
+   * while reading it.
+   */
+  CostmapPyramid * getCostmapPyramid()
+  {
+    return layered_costmap_->getPyramid();
+  }
+
   /** @brief Returns the current padded footprint as a geometry_msgs::msg::Polygon. */
   geometry_msgs::msg::Polygon getRobotFootprintPolygon()
   {
@@ -300,6 +312,8 @@ protected:
   std::vector<std::string> default_types_;
   std::vector<std::string> plugin_names_;
   std::vector<std::string> plugin_types_;
+  int pyramid_levels_{0};
+  std::string record_file_;
   double resolution_{0};
   std::string robot_base_frame_;   ///< The frame_id of the robot base
   double robot_radius_;
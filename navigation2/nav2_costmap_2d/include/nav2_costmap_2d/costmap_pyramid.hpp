@@ -0,0 +1,96 @@
+// Copyright (c) 2020 Navigation2 contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NAV2_COSTMAP_2D__COSTMAP_PYRAMID_HPP_
+#define NAV2_COSTMAP_2D__COSTMAP_PYRAMID_HPP_
+
+#include <memory>
+#include <vector>
+
+#include "nav2_costmap_2d/costmap_2d.hpp"
+
+namespace nav2_costmap_2d
+{
+
+/**
+ * @class CostmapPyramid
+ * @brief Max-pooled copies of a costmap at 2x, 4x, 8x ... coarser resolutions.
+ * Each cell of a level holds the highest cost of the cells it covers in the
+ * costmap, so a free coarse cell guarantees free fine cells. Levels are
+ * refreshed only around the window of the costmap that changed.
+ */
+class CostmapPyramid
+{
+public:
+  /**
+   * @brief  Constructor
+   * @param  num_levels Number of levels, the coarsest one downsampling by 2^num_levels
+   */
+  explicit CostmapPyramid(unsigned int num_levels);
+
+  /**
+   * @brief  Refresh the levels after the cells of costmap in [x0, xn) x [y0, yn)
+   * changed. All levels are rebuilt when the size, resolution or origin of the
+   * costmap changed since the last update, or after invalidate().
+   */
+  void update(
+    const Costmap2D & costmap, unsigned int x0, unsigned int y0,
+    unsigned int xn, unsigned int yn);
+
+  /**
+   * @brief  Rebuild all levels on the next update, e.g. after the costmap was
+   * changed outside of its update cycle
+   */
+  void invalidate()
+  {
+    need_full_update_ = true;
+  }
+
+  unsigned int getNumLevels() const
+  {
+    return levels_.size();
+  }
+
+  /**
+   * @brief  Get a level of the pyramid
+   * @param  level From 1, downsampling by 2, to getNumLevels()
+   * @return The level, or nullptr if there is no such level
+   */
+  Costmap2D * getLevel(unsigned int level);
+
+  /**
+   * @brief  Get the level downsampling the costmap by factor
+   * @return The level, or nullptr if factor is not a power of two covered by the pyramid
+   */
+  Costmap2D * getLevelForFactor(unsigned int factor);
+
+protected:
+  /**
+   * @brief  Set each cell of coarse in [x0, xn) x [y0, yn) to the highest cost
+   * of the 2x2 cells of fine it covers
+   */
+  void poolLevel(
+    const Costmap2D & fine, Costmap2D & coarse,
+    unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn);
+
+  std::vector<std::unique_ptr<Costmap2D>> levels_;
+  bool need_full_update_;
+
+  unsigned int size_x_, size_y_;
+  double resolution_, origin_x_, origin_y_;
+};
+
+}  // namespace nav2_costmap_2d
+
+#endif  // NAV2_COSTMAP_2D__COSTMAP_PYRAMID_HPP_
@@ -0,0 +1,206 @@
+// Copyright (c) 2020 Navigation2 contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NAV2_COSTMAP_2D__COSTMAP_RECORDING_HPP_
+#define NAV2_COSTMAP_2D__COSTMAP_RECORDING_HPP_
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "geometry_msgs/msg/point.hpp"
+#include "map_msgs/msg/occupancy_grid_update.hpp"
+#include "nav_msgs/msg/occupancy_grid.hpp"
+#include "nav2_costmap_2d/costmap_2d.hpp"
+#include "nav2_costmap_2d/observation.hpp"
+
+namespace nav2_costmap_2d
+{
+
+/*
+ * A costmap recording holds the inputs of every LayeredCostmap::updateMap() call,
+ * so that the same cycles can be run again offline. Layout, in host byte order:
+ *
+ *   CostmapRecordingHeader
+ *   records, each a CostmapRecordHeader, the layer name and the record data
+ *
+ * A cycle is bracketed by RECORD_CYCLE_BEGIN (robot pose) and RECORD_CYCLE_END
+ * (size and checksum of the resulting master grid). Inputs that layers fetch
+ * during the cycle, such as observations, are written between the two; inputs
+ * that arrive asynchronously, such as maps, are written as they arrive and so
+ * belong to the next cycle.
+ */
+
+const uint32_t COSTMAP_RECORDING_VERSION = 1;
+
+/// Flags of CostmapRecordingHeader
+const uint32_t RECORDING_ROLLING_WINDOW = 1;
+const uint32_t RECORDING_TRACK_UNKNOWN = 2;
+
+struct CostmapRecordingHeader
+{
+  char magic[4];          ///< "N2CR"
+  uint32_t version;
+  uint32_t flags;
+  uint32_t reserved;
+};
+
+enum CostmapRecordType : uint32_t
+{
+  RECORD_CYCLE_BEGIN = 0,           ///< Robot pose given to updateMap()
+  RECORD_CYCLE_END = 1,             ///< Geometry and checksum of the master grid
+  RECORD_FOOTPRINT = 2,             ///< Footprint given to setFootprint()
+  RECORD_MARKING_OBSERVATIONS = 3,  ///< Marking observations a layer used
+  RECORD_CLEARING_OBSERVATIONS = 4, ///< Clearing observations a layer used
+  RECORD_MAP = 5,                   ///< Map a layer received
+  RECORD_MAP_UPDATE = 6             ///< Map update a layer received
+};
+
+struct CostmapRecordHeader
+{
+  uint32_t type;          ///< CostmapRecordType
+  uint32_t name_size;     ///< Length of the layer name following the header
+  uint64_t data_size;     ///< Length of the data following the layer name
+};
+
+/**
+ * @brief A layer input read back from a recording
+ */
+struct CostmapRecord
+{
+  CostmapRecordType type;
+  std::string layer;
+  std::vector<unsigned char> data;
+};
+
+/**
+ * @brief Everything recorded for one updateMap() call
+ */
+struct CostmapCycle
+{
+  double robot_x{0.0}, robot_y{0.0}, robot_yaw{0.0};
+
+  bool has_footprint{false};
+  std::vector<geometry_msgs::msg::Point> footprint;
+
+  /// Layer inputs in the order they were recorded
+  std::vector<CostmapRecord> records;
+
+  /// The master grid the cycle produced when recorded
+  unsigned int size_x{0}, size_y{0};
+  double resolution{0.0}, origin_x{0.0}, origin_y{0.0};
+  uint64_t checksum{0};
+
+  /**
+   * @brief  Append the observations of a type recorded for a layer
+   * @return True if any were recorded, even an empty set
+   */
+  bool getObservations(
+    const std::string & layer, CostmapRecordType type,
+    std::vector<Observation> & observations) const;
+};
+
+/**
+ * @class CostmapRecorder
+ * @brief Writes a costmap recording. All methods may be called from any thread.
+ */
+class CostmapRecorder
+{
+public:
+  /**
+   * @brief  Create the recording file and write its header
+   * @throw std::runtime_error if the file can not be written
+   */
+  CostmapRecorder(const std::string & file_name, bool rolling_window, bool track_unknown);
+
+  void beginCycle(double robot_x, double robot_y, double robot_yaw);
+
+  /**
+   * @brief  Close the cycle with the master grid it produced and flush the file
+   */
+  void endCycle(const Costmap2D & costmap);
+
+  void writeFootprint(const std::vector<geometry_msgs::msg::Point> & footprint);
+
+  void writeObservations(
+    const std::string & layer, CostmapRecordType type,
+    const std::vector<Observation> & observations);
+
+  void writeMap(const std::string & layer, const nav_msgs::msg::OccupancyGrid & map);
+
+  void writeMapUpdate(
+    const std::string & layer, const map_msgs::msg::OccupancyGridUpdate & update);
+
+protected:
+  void writeRecord(
+    CostmapRecordType type, const std::string & layer, const std::vector<unsigned char> & data);
+
+  std::ofstream file_;
+  std::mutex mutex_;
+  std::vector<unsigned char> buffer_;  ///< Scratch for encoding records
+};
+
+/**
+ * @class CostmapReplay
+ * @brief Reads a costmap recording back one cycle at a time
+ */
+class CostmapReplay
+{
+public:
+  /**
+   * @brief  Open a recording and check its header
+   * @throw std::runtime_error if the file can not be read or is not a recording
+   */
+  explicit CostmapReplay(const std::string & file_name);
+
+  const CostmapRecordingHeader & getHeader() const {return header_;}
+
+  /**
+   * @brief  Read the next complete cycle
+   * @return False at the end of the recording; a trailing cycle cut short is dropped
+   * @throw std::runtime_error if a record is malformed
+   */
+  bool readCycle(CostmapCycle & cycle);
+
+protected:
+  bool readRecord(CostmapRecord & record);
+
+  std::ifstream file_;
+  uint64_t file_size_;
+  CostmapRecordingHeader header_;
+};
+
+/**
+ * @brief  FNV-1a hash of the costs of a costmap, to compare grids across runs
+ */
+uint64_t costmapChecksum(const Costmap2D & costmap);
+
+/**
+ * @brief  Decode a RECORD_MAP record
+ * @throw std::runtime_error if the record is malformed
+ */
+nav_msgs::msg::OccupancyGrid::SharedPtr decodeMap(const CostmapRecord & record);
+
+/**
+ * @brief  Decode a RECORD_MAP_UPDATE record
+ * @throw std::runtime_error if the record is malformed
+ */
+map_msgs::msg::OccupancyGridUpdate::SharedPtr decodeMapUpdate(const CostmapRecord & record);
+
+}  // namespace nav2_costmap_2d
+
+#endif  // NAV2_COSTMAP_2D__COSTMAP_RECORDING_HPP_
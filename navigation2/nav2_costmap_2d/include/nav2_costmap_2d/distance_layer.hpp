@@ -0,0 +1,121 @@
+// Copyright (c) 2020 Navigation2 contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NAV2_COSTMAP_2D__DISTANCE_LAYER_HPP_
+#define NAV2_COSTMAP_2D__DISTANCE_LAYER_HPP_
+
+#include <mutex>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "nav2_costmap_2d/layer.hpp"
+#include "nav2_costmap_2d/layered_costmap.hpp"
+
+namespace nav2_costmap_2d
+{
+
+/**
+ * @class DistanceLayer
+ * @brief Maintains the Euclidean distance from every cell of the master grid to the
+ * nearest lethal cell, capped at max_distance. The layer does not change any cost;
+ * each cycle it recomputes the distances only around the updated window.
+ */
+class DistanceLayer : public Layer
+{
+public:
+  DistanceLayer();
+
+  ~DistanceLayer();
+
+  void onInitialize() override;
+  void updateBounds(
+    double robot_x, double robot_y, double robot_yaw, double * min_x,
+    double * min_y,
+    double * max_x,
+    double * max_y) override;
+  void updateCosts(
+    nav2_costmap_2d::Costmap2D & master_grid,
+    int min_i, int min_j, int max_i, int max_j) override;
+
+  void matchSize() override;
+
+  void reset() override
+  {
+    matchSize();
+  }
+
+  /**
+   * @brief  Distance from a cell to the nearest lethal cell
+   * @param  mx The x coordinate of the cell
+   * @param  my The y coordinate of the cell
+   * @return Distance in meters, at most getMaxDistance()
+   */
+  inline float getDistance(unsigned int mx, unsigned int my) const
+  {
+    return distances_[my * size_x_ + mx];
+  }
+
+  /**
+   * @brief  Gradient of the distance field at a cell, by central differences
+   * @param  mx The x coordinate of the cell
+   * @param  my The y coordinate of the cell
+   * @param  gx Set to the change of distance per meter along x
+   * @param  gy Set to the change of distance per meter along y
+   */
+  void getGradient(unsigned int mx, unsigned int my, float & gx, float & gy) const;
+
+  double getMaxDistance() const
+  {
+    return max_distance_;
+  }
+
+  typedef std::recursive_mutex mutex_t;
+  mutex_t * getMutex()
+  {
+    return access_;
+  }
+
+private:
+  /**
+   * @brief  Recompute the distances of the cells in [x0, x1) x [y0, y1) from the
+   * lethal cells of the master grid within cell_max_distance_ of them
+   */
+  void updateDistances(
+    const nav2_costmap_2d::Costmap2D & master_grid,
+    int x0, int y0, int x1, int y1);
+
+  /**
+   * @brief  One dimensional squared distance transform of sampled function f
+   * (Felzenszwalb and Huttenlocher), writing the result to d
+   */
+  void distanceTransform1D(const double * f, double * d, int n);
+
+  double max_distance_;
+  int cell_max_distance_;
+  bool need_full_update_;
+
+  unsigned int size_x_, size_y_;
+  double resolution_, origin_x_, origin_y_;
+  std::vector<float> distances_;
+
+  // Scratch buffers for the transform
+  std::vector<double> grid_, column_in_, column_out_, parabola_bounds_;
+  std::vector<int> parabola_vertices_;
+
+  mutex_t * access_;
+};
+
+}  // namespace nav2_costmap_2d
+
+#endif  // NAV2_COSTMAP_2D__DISTANCE_LAYER_HPP_
@@ -45,8 +45,47 @@ public:
   double pointCost(int x, int y) const;
   void setCostmap(CostmapT costmap);
 
+  /**
+   * @brief Max cost over the footprint's outline and interior at a pose. The footprint
+   * is rasterized once per discretized heading and the masks are reused until the
+   * footprint or the costmap resolution changes. A mask covers the outline cells of
+   * every pose in its cell and heading bin, so the cost is never below
+   * footprintCostAtPose().
+   * @return LETHAL_OBSTACLE if any footprint cell lies off the map
+   */
+  double footprintAreaCostAtPose(
+    double x, double y, double theta, const Footprint & footprint);
+
+  /**
+   * @brief Set the number of headings footprint masks are discretized to
+   * @param num_headings Number of heading bins over a full turn
+   */
+  void setNumMaskHeadings(unsigned int num_headings);
+
 protected:
+  /**
+   * @struct MaskSpan
+   * @brief A row of footprint cells, as offsets from the pose's cell
+   */
+  struct MaskSpan
+  {
+    int dy;
+    int x0;
+    int x1;
+  };
+
+  const std::vector<MaskSpan> & footprintMask(
+    unsigned int heading_bin, const Footprint & footprint);
+  void rasterizeFootprint(
+    double theta, const Footprint & footprint, std::vector<MaskSpan> & mask) const;
+
   CostmapT costmap_;
+
+  Footprint mask_footprint_;  ///< @brief Footprint the cached masks were rasterized from
+  double mask_resolution_;  ///< @brief Costmap resolution the cached masks were rasterized at
+  unsigned int num_mask_headings_;
+  std::vector<std::vector<MaskSpan>> masks_;
+  std::vector<bool> mask_valid_;
 };
 
 }  // namespace nav2_costmap_2d
@@ -38,7 +38,9 @@
 #ifndef NAV2_COSTMAP_2D__INFLATION_LAYER_HPP_
 #define NAV2_COSTMAP_2D__INFLATION_LAYER_HPP_
 
+#include <atomic>
 #include <map>
+#include <memory>
 #include <vector>
 #include <mutex>
 
@@ -48,6 +50,8 @@
 
 namespace nav2_costmap_2d
 {
+class StaticLayer;
+
 /**
  * @class CellData
  * @brief Storage for cell information used during obstacle inflation
@@ -174,6 +178,28 @@ private:
     unsigned int index, unsigned int mx, unsigned int my,
     unsigned int src_x, unsigned int src_y);
 
+  /**
+   * @brief  Propagate inflation from the cells queued in inflation_cells_[0]
+   * @param  apply Called once per reached cell with its index and inflated cost
+   */
+  template<typename ApplyT>
+  void propagate(unsigned int size_x, unsigned int size_y, ApplyT apply);
+
+  /**
+   * @brief  Find the static layer updated before this one, if its map lines up with the master grid
+   */
+  std::shared_ptr<StaticLayer> findStaticLayer(unsigned int size_x, unsigned int size_y);
+
+  /**
+   * @brief  Inflate the obstacles of the static map snapshot into static_inflation_
+   */
+  void inflateStaticMap(unsigned int size_x, unsigned int size_y);
+
+  inline bool isInflationSource(unsigned char cost) const
+  {
+    return cost == LETHAL_OBSTACLE || (inflate_around_unknown_ && cost == NO_INFORMATION);
+  }
+
   double inflation_radius_, inscribed_radius_, cost_scaling_factor_;
   bool inflate_unknown_, inflate_around_unknown_;
   unsigned int cell_inflation_radius_;
@@ -190,6 +216,13 @@ private:
   unsigned int cache_length_;
   double last_min_x_, last_min_y_, last_max_x_, last_max_y_;
 
+  // Static obstacles are inflated once per static map revision and max-combined
+  // with the per-cycle inflation of everything else
+  std::vector<unsigned char> static_map_;  ///< @brief Snapshot of the static layer's costs
+  std::vector<unsigned char> static_inflation_;  ///< @brief Costs inflated from static_map_
+  unsigned int static_map_revision_;
+  std::atomic<bool> static_inflation_dirty_;
+
   // Indicates that the entire costmap should be reinflated next time around.
   bool need_reinflation_;
   mutex_t * access_;
@@ -45,6 +45,8 @@
 #include "nav2_costmap_2d/cost_values.hpp"
 #include "nav2_costmap_2d/layer.hpp"
 #include "nav2_costmap_2d/costmap_2d.hpp"
+#include "nav2_costmap_2d/costmap_pyramid.hpp"
+#include "nav2_costmap_2d/costmap_recording.hpp"
 
 namespace nav2_costmap_2d
 {
@@ -136,6 +138,65 @@ public:
     return initialized_;
   }
 
+  /**
+   * @brief  Maintain a max-pooled pyramid of the costmap, refreshed within the
+   * updated bounds at the end of each updateMap()
+   * @param  num_levels Number of levels, the coarsest one downsampling by 2^num_levels
+   */
+  void enablePyramid(unsigned int num_levels);
+
+  /** @brief Returns the costmap pyramid, or nullptr if it is not enabled. */
+  CostmapPyramid * getPyramid()
+  {
+    return pyramid_.get();
+  }
+
+  /**
+   * @brief  Record the inputs and results of every following updateMap() into a
+   * recording, or stop recording if recorder is nullptr
+   */
+  void setRecorder(std::shared_ptr<CostmapRecorder> recorder);
+
+  /** @brief Returns the recorder layers write their inputs to, or nullptr. */
+  CostmapRecorder * getRecorder()
+  {
+    return recorder_.get();
+  }
+
+  /**
+   * @brief  Make layers take their inputs from a recorded cycle instead of their
+   * live sources, or from their live sources again if cycle is nullptr
+   */
+  void setReplayCycle(const CostmapCycle * cycle)
+  {
+    replay_cycle_ = cycle;
+  }
+
+  /** @brief Returns the recorded cycle being replayed, or nullptr. */
+  const CostmapCycle * getReplayCycle() const
+  {
+    return replay_cycle_;
+  }
+
+  /// Time spent by a plugin in its updates
+  struct PluginTiming
+  {
+    double update_bounds_time{0.0};  ///< Seconds spent in updateBounds()
+    double update_costs_time{0.0};  ///< Seconds spent in updateCosts()
+  };
+
+  /**
+   * @brief  Accumulate the time each plugin spends in updateMap(), starting from zero
+   * @param  enable Whether to time the plugins
+   */
+  void enablePluginTimings(bool enable);
+
+  /** @brief Returns the accumulated timings, in the order of getPlugins(). */
+  const std::vector<PluginTiming> & getPluginTimings() const
+  {
+    return plugin_timings_;
+  }
+
   /** @brief Updates the stored footprint, updates the circumscribed
    * and inscribed radii, and calls onFootprintChanged() in all
    * layers. */
@@ -163,6 +224,11 @@ public:
   bool isOutofBounds(double robot_x, double robot_y);
 
 private:
+  /**
+   * @brief  Body of updateMap(), run with the costmap locked
+   */
+  void updateLayers(double robot_x, double robot_y, double robot_yaw);
+
   Costmap2D costmap_;
   std::string global_frame_;
 
@@ -174,6 +240,14 @@ private:
 
   std::vector<std::shared_ptr<Layer>> plugins_;
 
+  std::unique_ptr<CostmapPyramid> pyramid_;
+
+  std::shared_ptr<CostmapRecorder> recorder_;
+  const CostmapCycle * replay_cycle_;
+
+  bool time_plugins_;
+  std::vector<PluginTiming> plugin_timings_;
+
   bool initialized_;
   bool size_locked_;
   double circumscribed_radius_, inscribed_radius_;
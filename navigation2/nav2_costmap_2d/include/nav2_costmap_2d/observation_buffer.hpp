@@ -37,8 +37,9 @@
 #ifndef NAV2_COSTMAP_2D__OBSERVATION_BUFFER_HPP_
 #define NAV2_COSTMAP_2D__OBSERVATION_BUFFER_HPP_
 
+#include <atomic>
+#include <limits>
 #include <vector>
-#include <list>
 #include <string>
 
 #include "tf2_geometry_msgs/tf2_geometry_msgs.h"
@@ -54,6 +55,18 @@ namespace nav2_costmap_2d
 /**
  * @class ObservationBuffer
  * @brief Takes in point clouds from sensors, transforms them to the desired frame, and stores them
+ *
+ * Observations live in a fixed-capacity ring of preallocated slots. The buffer is
+ * single-producer/single-consumer: one sensor callback writes with bufferCloud() while
+ * the costmap update thread reads with getObservations(), and neither side ever blocks
+ * on the other. The reader publishes the oldest sequence number it is copying (its epoch)
+ * and the writer never recycles a slot at or after that epoch; if the ring is full of
+ * pinned slots the incoming cloud is dropped instead of waiting.
+ *
+ * The ring also bounds how many observations are kept: once it wraps, the oldest
+ * observations are recycled even if they are still within the persistence window.
+ * By default the capacity is derived from the persistence and the expected update
+ * rate so that a sensor running at its expected rate never hits that limit.
  */
 class ObservationBuffer
 {
@@ -71,6 +84,8 @@ public:
    * @param  global_frame The frame to transform PointClouds into
    * @param  sensor_frame The frame of the origin of the sensor, can be left blank to be read from the messages
    * @param  tf_tolerance The amount of time to wait for a transform to be available when setting a new global frame
+   * @param  capacity The number of preallocated observation slots, bounding how many observations can be kept,
+   * 0 derives it from observation_keep_time and expected_update_rate
    */
   ObservationBuffer(
     nav2_util::LifecycleNode::SharedPtr nh,
@@ -80,7 +95,8 @@ public:
     double min_obstacle_height, double max_obstacle_height, double obstacle_range,
     double raytrace_range, tf2_ros::Buffer & tf2_buffer, std::string global_frame,
     std::string sensor_frame,
-    double tf_tolerance);
+    double tf_tolerance,
+    unsigned int capacity = 0);
 
   /**
    * @brief  Destructor... cleans up
@@ -90,7 +106,7 @@ public:
   /**
    * @brief Sets the global frame of an observation buffer. This will
    * transform all the currently cached observations to the new global
-   * frame
+   * frame. Must not be called concurrently with bufferCloud()
    * @param new_global_frame The name of the new global frame.
    * @return True if the operation succeeds, false otherwise
    */
@@ -104,7 +120,8 @@ public:
   void bufferCloud(const sensor_msgs::msg::PointCloud2 & cloud);
 
   /**
-   * @brief  Pushes copies of all current observations onto the end of the vector passed in
+   * @brief  Pushes copies of all current observations onto the end of the vector passed in,
+   * newest first. Only one thread may consume from a buffer at a time
    * @param  observations The vector to be filled
    */
   void getObservations(std::vector<Observation> & observations);
@@ -116,45 +133,65 @@ public:
   bool isCurrent() const;
 
   /**
-   * @brief  Lock the observation buffer
+   * @brief Reset last updated timestamp
    */
-  inline void lock()
-  {
-    lock_.lock();
-  }
+  void resetLastUpdated();
 
   /**
-   * @brief  Lock the observation buffer
+   * @brief  Get the number of observation slots needed to keep every observation within
+   * the persistence window of a sensor updating at its expected rate
+   * @param  observation_keep_time The persistence of observations in seconds
+   * @param  expected_update_rate How often the buffer is expected to be updated in seconds, 0 if unknown
+   * @return The number of slots, at least DEFAULT_CAPACITY unless only the latest observation is kept
    */
-  inline void unlock()
-  {
-    lock_.unlock();
-  }
+  static unsigned int capacityFor(double observation_keep_time, double expected_update_rate);
+
+  static constexpr unsigned int DEFAULT_CAPACITY = 64;
 
+protected:
   /**
-   * @brief Reset last updated timestamp
+   * @brief  Removes any stale observations from the buffer by advancing its tail
+   * @param  head One past the newest sequence number visible to the consumer
    */
-  void resetLastUpdated();
+  void purgeStaleObservations(uint64_t head);
 
-private:
   /**
-   * @brief  Removes any stale observations from the buffer list
+   * @brief  Get the slot holding an observation sequence number
    */
-  void purgeStaleObservations();
+  inline Observation & slot(uint64_t seq)
+  {
+    return slots_[seq % slots_.size()];
+  }
+
+  /**
+   * @brief  Get the time of the last successful update
+   */
+  rclcpp::Time lastUpdated() const;
 
   tf2_ros::Buffer & tf2_buffer_;
   const rclcpp::Duration observation_keep_time_;
   const rclcpp::Duration expected_update_rate_;
   nav2_util::LifecycleNode::SharedPtr nh_;
-  rclcpp::Time last_updated_;
+  rcl_clock_type_t clock_type_;
+  std::atomic<int64_t> last_updated_ns_;  ///< @brief Written by the producer, read by the consumer
   std::string global_frame_;
   std::string sensor_frame_;
-  std::list<Observation> observation_list_;
   std::string topic_name_;
   double min_obstacle_height_, max_obstacle_height_;
-  std::recursive_mutex lock_;  ///< @brief A lock for accessing data in callbacks safely
   double obstacle_range_, raytrace_range_;
   double tf_tolerance_;
+
+  static constexpr uint64_t NO_READER = std::numeric_limits<uint64_t>::max();
+  static constexpr double DROP_WARNING_PERIOD = 5.0;  ///< @brief Seconds between drop warnings
+  static constexpr double MAX_DERIVED_CAPACITY = 65536.0;
+
+  std::vector<Observation> slots_;  ///< @brief Preallocated ring of observations
+  std::atomic<uint64_t> head_;  ///< @brief One past the newest published sequence number
+  std::atomic<uint64_t> claimed_;  ///< @brief One past the sequence the producer is writing
+  std::atomic<uint64_t> reader_epoch_;  ///< @brief Oldest sequence pinned by the consumer
+  uint64_t tail_;  ///< @brief Oldest retained sequence number, owned by the consumer
+  unsigned int dropped_;  ///< @brief Clouds dropped because the ring was pinned
+  rclcpp::Time last_drop_warning_;  ///< @brief When the producer last warned about drops
 };
 }  // namespace nav2_costmap_2d
 #endif  // NAV2_COSTMAP_2D__OBSERVATION_BUFFER_HPP_
@@ -38,6 +38,8 @@
 #ifndef NAV2_COSTMAP_2D__OBSTACLE_LAYER_HPP_
 #define NAV2_COSTMAP_2D__OBSTACLE_LAYER_HPP_
 
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <string>
 #include <vector>
@@ -65,6 +67,7 @@ class ObstacleLayer : public CostmapLayer
 {
 public:
   ObstacleLayer()
+  : endpoint_shift_(0)
   {
     costmap_ = NULL;  // this is the unsigned char* member of parent class Costmap2D.
   }
@@ -137,7 +140,7 @@ protected:
     std::vector<nav2_costmap_2d::Observation> & clearing_observations) const;
 
   /**
-   * @brief  Clear freespace based on one observation
+   * @brief  Clear freespace based on one observation, tracing rays on raytrace_threads_ threads
    * @param clearing_observation The observation used to raytrace
    * @param min_x
    * @param min_y
@@ -150,6 +153,32 @@ protected:
     double * max_x,
     double * max_y);
 
+  /**
+   * @brief  Start a new endpoint deduplication pass, forgetting every seen cell
+   * @param max_endpoints Most endpoints the pass will see
+   */
+  void beginEndpointPass(size_t max_endpoints);
+
+  /**
+   * @brief  Record a cell as seen in the current endpoint pass
+   * @param index The index of the cell
+   * @return True if the cell was not yet seen in this pass
+   */
+  inline bool firstEndpointInCell(unsigned int index)
+  {
+    // multiplicative hash into a table at most half full, probed linearly
+    const size_t mask = endpoint_cells_.size() - 1;
+    size_t slot = static_cast<uint32_t>(index * 2654435761u) >> endpoint_shift_;
+    while (endpoint_cells_[slot] != NO_ENDPOINT) {
+      if (endpoint_cells_[slot] == index) {
+        return false;
+      }
+      slot = (slot + 1) & mask;
+    }
+    endpoint_cells_[slot] = index;
+    return true;
+  }
+
   void updateRaytraceBounds(
     double ox, double oy, double wx, double wy, double range,
     double * min_x, double * min_y,
@@ -186,6 +215,15 @@ protected:
 
   bool rolling_window_;
   int combination_method_;
+  int raytrace_threads_;  ///< @brief Number of threads clearing rays are traced on, 1 is serial
+
+  /// @brief Hash set of the endpoint cells seen in the current pass, sized to the
+  /// observation rather than the map
+  std::vector<unsigned int> endpoint_cells_;
+  int endpoint_shift_;  ///< @brief 32 minus the log2 of the endpoint_cells_ size
+  static constexpr unsigned int NO_ENDPOINT = std::numeric_limits<unsigned int>::max();
+  /// @brief Unique endpoint cells of the clearing observation being traced
+  std::vector<unsigned int> clearing_endpoints_;
 };
 
 }  // namespace nav2_costmap_2d
@@ -37,6 +37,7 @@
 #define NAV2_COSTMAP_2D__RANGE_SENSOR_LAYER_HPP_
 
 #include <list>
+#include <map>
 #include <string>
 #include <vector>
 #include <mutex>
@@ -78,7 +79,7 @@ public:
 
   void bufferIncomingRangeMsg(const sensor_msgs::msg::Range::SharedPtr range_message);
 
-private:
+protected:
   void updateCostmap();
   void updateCostmap(sensor_msgs::msg::Range & range_message, bool clear_sensor_cone);
 
@@ -90,12 +91,51 @@ private:
 
   inline double gamma(double theta);
   inline double delta(double phi);
-  inline double sensor_model(double r, double phi, double theta);
+  double sensor_model(double r, double phi, double theta);
+  inline double sensor_model_lambda(double r, double phi, double lbda);
+
+  /**
+   * @brief Tabulate delta(phi) so the sensor model avoids a tanh per cell
+   */
+  void buildDeltaTable();
+
+  /**
+   * @brief Set the half field of view of the current reading and select the
+   * gamma table of that field of view, tabulating it the first time it is seen
+   */
+  void setMaxAngle(double max_angle);
+
+  /**
+   * @brief gamma() of a cell from its coordinates along and across the sensor
+   * axis, looked up in the gamma table instead of taking an atan2
+   */
+  inline double tabulated_gamma(double along, double across, double phi2);
+
+  /**
+   * @brief Sensor model of a cell, at (dx, dy) from the sensor origin, for a
+   * reading of range r along (cos_ot, sin_ot)
+   */
+  double cell_sensor_model(
+    double dx, double dy, double cos_ot, double sin_ot, double r);
+
+  /**
+   * @brief Set the sensor cone, in map cells, that clipConeRow clips to
+   */
+  void setCone(int ox, int oy, int ax, int ay, int bx, int by);
+
+  /**
+   * @brief Clip a row of the bounding box to the (partially inflated) sensor cone
+   * @param y Row to clip
+   * @param x0 First column of the row, updated in place
+   * @param x1 Last column of the row, updated in place
+   * @return false if no cell of the row lies within the cone
+   */
+  bool clipConeRow(int y, int & x0, int & x1);
 
   inline void get_deltas(double angle, double * dx, double * dy);
   inline void update_cell(
-    double ox, double oy, double ot,
-    double r, double nx, double ny, bool clear);
+    unsigned int index, double dx, double dy, double cos_ot, double sin_ot,
+    double r, bool clear);
 
   inline double to_prob(unsigned char c)
   {
@@ -112,6 +152,21 @@ private:
 
   double max_angle_, phi_v_;
   double inflate_cone_;
+
+  std::vector<double> delta_table_;  ///< @brief delta(phi) sampled every DELTA_TABLE_STEP meters
+  static constexpr double DELTA_TABLE_STEP = 0.005;
+
+  /// gamma(theta) per half field of view, sampled evenly over sin(theta)^2
+  /// from 0 to sin(max_angle)^2
+  std::map<double, std::vector<double>> gamma_tables_;
+  static constexpr unsigned int GAMMA_TABLE_SIZE = 256;
+  static constexpr unsigned int MAX_GAMMA_TABLES = 16;
+  const std::vector<double> * gamma_table_{nullptr};  ///< Table of max_angle_, if any
+  double gamma_table_scale_{0.0};  ///< Samples per unit of sin(theta)^2
+
+  // Sensor cone projected on the costmap, as used by clipConeRow
+  int cone_ox_, cone_oy_, cone_ax_, cone_ay_, cone_bx_, cone_by_;
+  float cone_threshold_;
   std::string global_frame_;
 
   double clear_threshold_, mark_threshold_;
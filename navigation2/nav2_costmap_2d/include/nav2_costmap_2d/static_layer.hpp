@@ -38,6 +38,9 @@
 #ifndef NAV2_COSTMAP_2D__STATIC_LAYER_HPP_
 #define NAV2_COSTMAP_2D__STATIC_LAYER_HPP_
 
+#include <array>
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <string>
 
@@ -72,9 +75,25 @@ public:
 
   virtual void matchSize();
 
+  /**
+   * @brief Revision of the static map, bumped whenever a new map or a map update is applied
+   */
+  unsigned int getMapRevision() const
+  {
+    return map_revision_.load();
+  }
+
 private:
   void getParameters();
-  void processMap(const nav_msgs::msg::OccupancyGrid & new_map);
+
+  /**
+   * @brief  Copy a map into the layer, resizing the layered costmap if needed
+   * @param new_map The map to process
+   * @param costs The map data already translated by translateValues
+   */
+  void processMap(
+    const nav_msgs::msg::OccupancyGrid & new_map,
+    std::unique_ptr<unsigned char[]> costs);
 
   /**
    * @brief  Callback to update the costmap's map from the map_server
@@ -87,6 +106,14 @@ private:
 
   unsigned char interpretValue(unsigned char value);
 
+  /**
+   * @brief  Translate occupancy values to costs through cost_translation_table_
+   * @param data Occupancy values
+   * @param size Number of values
+   * @param costs Output, at least size long
+   */
+  void translateValues(const int8_t * data, size_t size, unsigned char * costs) const;
+
   std::string global_frame_;  ///< @brief The global frame for the costmap
   std::string map_frame_;  /// @brief frame that map is located in
 
@@ -113,6 +140,9 @@ private:
   tf2::Duration transform_tolerance_;
   std::atomic<bool> update_in_progress_;
   nav_msgs::msg::OccupancyGrid::SharedPtr map_buffer_;
+  std::unique_ptr<unsigned char[]> map_buffer_costs_;  ///< @brief map_buffer_, translated
+  std::array<unsigned char, 256> cost_translation_table_;  ///< @brief interpretValue per value
+  std::atomic<unsigned int> map_revision_{0};
 };
 
 }  // namespace nav2_costmap_2d
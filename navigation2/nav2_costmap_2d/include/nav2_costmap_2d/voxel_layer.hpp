@@ -59,7 +59,7 @@ class VoxelLayer : public ObstacleLayer
 {
 public:
   VoxelLayer()
-  : voxel_grid_(0, 0, 0)
+  : voxel_grid_(0, 0, 0), tall_voxel_grid_(0, 0, 0)
   {
     costmap_ = NULL;  // this is the unsigned char* member of parent class's parent class Costmap2D
   }
@@ -96,9 +96,35 @@ private:
   bool publish_voxel_;
   rclcpp_lifecycle::LifecyclePublisher<nav2_msgs::msg::VoxelGrid>::SharedPtr voxel_pub_;
   nav2_voxel_grid::VoxelGrid voxel_grid_;
+  /// @brief Used instead of voxel_grid_ when more z levels are requested than it can hold
+  nav2_voxel_grid::VoxelGrid64 tall_voxel_grid_;
   double z_resolution_, origin_z_;
   int unknown_threshold_, mark_threshold_, size_z_;
   rclcpp::Publisher<sensor_msgs::msg::PointCloud>::SharedPtr clearing_endpoints_pub_;
+  /// @brief Grid coordinates of the clearing endpoints of the observation being traced
+  std::vector<double> clearing_voxel_endpoints_;
+
+  /**
+   * @brief  Whether z_voxels needs the 64 bit voxel grid
+   */
+  inline bool useTallVoxelGrid() const
+  {
+    return size_z_ > static_cast<int>(nav2_voxel_grid::VoxelGrid::MAX_SIZE_Z);
+  }
+
+  /**
+   * @brief  Calls a function with the voxel grid in use
+   * @param f A function taking either voxel grid type
+   */
+  template<typename FunctionT>
+  inline void withVoxelGrid(FunctionT f)
+  {
+    if (useTallVoxelGrid()) {
+      f(tall_voxel_grid_);
+    } else {
+      f(voxel_grid_);
+    }
+  }
 
   inline bool worldToMap3DFloat(
     double wx, double wy, double wz, double & mx, double & my,
@@ -0,0 +1,239 @@
+// Copyright (c) 2020 Navigation2 contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nav2_costmap_2d/distance_layer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "pluginlib/class_list_macros.hpp"
+
+PLUGINLIB_EXPORT_CLASS(nav2_costmap_2d::DistanceLayer, nav2_costmap_2d::Layer)
+
+using nav2_costmap_2d::LETHAL_OBSTACLE;
+
+namespace nav2_costmap_2d
+{
+
+// Squared distance standing for "no lethal cell"; large enough to dominate any
+// squared distance on a map, small enough for doubles to add to it exactly
+static constexpr double NO_OBSTACLE = 1e12;
+
+DistanceLayer::DistanceLayer()
+: max_distance_(0),
+  cell_max_distance_(0),
+  need_full_update_(true),
+  size_x_(0),
+  size_y_(0),
+  resolution_(0),
+  origin_x_(0),
+  origin_y_(0)
+{
+  access_ = new mutex_t();
+}
+
+DistanceLayer::~DistanceLayer()
+{
+  delete access_;
+}
+
+void
+DistanceLayer::onInitialize()
+{
+  declareParameter("enabled", rclcpp::ParameterValue(true));
+  declareParameter("max_distance", rclcpp::ParameterValue(2.0));
+
+  node_->get_parameter(name_ + "." + "enabled", enabled_);
+  node_->get_parameter(name_ + "." + "max_distance", max_distance_);
+
+  current_ = true;
+  matchSize();
+}
+
+void
+DistanceLayer::matchSize()
+{
+  std::lock_guard<mutex_t> guard(*getMutex());
+  nav2_costmap_2d::Costmap2D * costmap = layered_costmap_->getCostmap();
+  size_x_ = costmap->getSizeInCellsX();
+  size_y_ = costmap->getSizeInCellsY();
+  resolution_ = costmap->getResolution();
+  origin_x_ = costmap->getOriginX();
+  origin_y_ = costmap->getOriginY();
+  cell_max_distance_ = static_cast<int>(std::ceil(max_distance_ / resolution_)) + 1;
+  distances_.assign(size_x_ * size_y_, static_cast<float>(max_distance_));
+  need_full_update_ = true;
+}
+
+void
+DistanceLayer::updateBounds(
+  double /*robot_x*/, double /*robot_y*/, double /*robot_yaw*/, double * /*min_x*/,
+  double * /*min_y*/, double * /*max_x*/, double * /*max_y*/)
+{
+  // A rolling window shifts the master grid under us; start over when it does
+  nav2_costmap_2d::Costmap2D * costmap = layered_costmap_->getCostmap();
+  if (costmap->getOriginX() != origin_x_ || costmap->getOriginY() != origin_y_) {
+    origin_x_ = costmap->getOriginX();
+    origin_y_ = costmap->getOriginY();
+    need_full_update_ = true;
+  }
+}
+
+void
+DistanceLayer::updateCosts(
+  nav2_costmap_2d::Costmap2D & master_grid, int min_i, int min_j,
+  int max_i,
+  int max_j)
+{
+  std::lock_guard<mutex_t> guard(*getMutex());
+  if (!enabled_) {
+    need_full_update_ = true;
+    return;
+  }
+
+  if (master_grid.getSizeInCellsX() != size_x_ || master_grid.getSizeInCellsY() != size_y_) {
+    RCLCPP_WARN(
+      rclcpp::get_logger(
+        "nav2_costmap_2d"), "DistanceLayer::updateCosts(): distance grid size is wrong");
+    matchSize();
+  }
+
+  if (need_full_update_) {
+    updateDistances(master_grid, 0, 0, size_x_, size_y_);
+    need_full_update_ = false;
+    return;
+  }
+
+  // Lethal cells changed only inside the window, so only distances within
+  // cell_max_distance_ of it can change
+  updateDistances(
+    master_grid,
+    std::max(0, min_i - cell_max_distance_), std::max(0, min_j - cell_max_distance_),
+    std::min(static_cast<int>(size_x_), max_i + cell_max_distance_),
+    std::min(static_cast<int>(size_y_), max_j + cell_max_distance_));
+}
+
+void
+DistanceLayer::getGradient(unsigned int mx, unsigned int my, float & gx, float & gy) const
+{
+  unsigned int x0 = mx > 0 ? mx - 1 : mx;
+  unsigned int x1 = mx + 1 < size_x_ ? mx + 1 : mx;
+  unsigned int y0 = my > 0 ? my - 1 : my;
+  unsigned int y1 = my + 1 < size_y_ ? my + 1 : my;
+
+  gx = x1 == x0 ? 0.0f :
+    (getDistance(x1, my) - getDistance(x0, my)) / static_cast<float>((x1 - x0) * resolution_);
+  gy = y1 == y0 ? 0.0f :
+    (getDistance(mx, y1) - getDistance(mx, y0)) / static_cast<float>((y1 - y0) * resolution_);
+}
+
+void
+DistanceLayer::updateDistances(
+  const nav2_costmap_2d::Costmap2D & master_grid,
+  int x0, int y0, int x1, int y1)
+{
+  if (x0 >= x1 || y0 >= y1) {
+    return;
+  }
+
+  // Every lethal cell closer than max_distance_ to the updated cells lies
+  // within cell_max_distance_ of them
+  const int rx0 = std::max(0, x0 - cell_max_distance_);
+  const int ry0 = std::max(0, y0 - cell_max_distance_);
+  const int rx1 = std::min(static_cast<int>(size_x_), x1 + cell_max_distance_);
+  const int ry1 = std::min(static_cast<int>(size_y_), y1 + cell_max_distance_);
+  const int width = rx1 - rx0;
+  const int height = ry1 - ry0;
+
+  const unsigned char * master_array = master_grid.getCharMap();
+  grid_.resize(width * height);
+  for (int j = 0; j < height; j++) {
+    const unsigned char * row = master_array + (ry0 + j) * size_x_ + rx0;
+    double * out = &grid_[j * width];
+    for (int i = 0; i < width; i++) {
+      out[i] = row[i] == LETHAL_OBSTACLE ? 0.0 : NO_OBSTACLE;
+    }
+  }
+
+  const int longest = std::max(width, height);
+  column_in_.resize(longest);
+  column_out_.resize(longest);
+  parabola_vertices_.resize(longest);
+  parabola_bounds_.resize(longest + 1);
+
+  // Squared distances along the columns, then along the rows
+  for (int i = 0; i < width; i++) {
+    for (int j = 0; j < height; j++) {
+      column_in_[j] = grid_[j * width + i];
+    }
+    distanceTransform1D(column_in_.data(), column_out_.data(), height);
+    for (int j = 0; j < height; j++) {
+      grid_[j * width + i] = column_out_[j];
+    }
+  }
+
+  const double max_sq_cells = (max_distance_ / resolution_) * (max_distance_ / resolution_);
+  const float max_distance = static_cast<float>(max_distance_);
+  for (int j = y0; j < y1; j++) {
+    double * row = &grid_[(j - ry0) * width];
+    std::copy(row, row + width, column_in_.begin());
+    distanceTransform1D(column_in_.data(), column_out_.data(), width);
+
+    float * out = &distances_[j * size_x_];
+    for (int i = x0; i < x1; i++) {
+      const double sq_cells = column_out_[i - rx0];
+      out[i] = sq_cells >= max_sq_cells ?
+        max_distance : static_cast<float>(std::sqrt(sq_cells) * resolution_);
+    }
+  }
+}
+
+void
+DistanceLayer::distanceTransform1D(const double * f, double * d, int n)
+{
+  int * v = parabola_vertices_.data();
+  double * z = parabola_bounds_.data();
+  int k = 0;
+  v[0] = 0;
+  z[0] = -std::numeric_limits<double>::max();
+  z[1] = std::numeric_limits<double>::max();
+
+  // Lower envelope of the parabolas rooted at each sample
+  // Squares are taken in double, as q * q overflows an int for rows over 46340 cells
+  for (int q = 1; q < n; q++) {
+    const double fq = f[q] + static_cast<double>(q) * q;
+    double s = (fq - (f[v[k]] + static_cast<double>(v[k]) * v[k])) / (2.0 * (q - v[k]));
+    while (s <= z[k]) {
+      k--;
+      s = (fq - (f[v[k]] + static_cast<double>(v[k]) * v[k])) / (2.0 * (q - v[k]));
+    }
+    k++;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = std::numeric_limits<double>::max();
+  }
+
+  k = 0;
+  for (int q = 0; q < n; q++) {
+    while (z[k + 1] < q) {
+      k++;
+    }
+    const double dq = q - v[k];
+    d[q] = dq * dq + f[v[k]];
+  }
+}
+
+}  // namespace nav2_costmap_2d
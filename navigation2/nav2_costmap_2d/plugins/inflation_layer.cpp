@@ -45,6 +45,7 @@
 
 #include "nav2_costmap_2d/costmap_math.hpp"
 #include "nav2_costmap_2d/footprint.hpp"
+#include "nav2_costmap_2d/static_layer.hpp"
 #include "pluginlib/class_list_macros.hpp"
 #include "rclcpp/parameter_events_filter.hpp"
 
@@ -70,7 +71,9 @@ InflationLayer::InflationLayer()
   last_min_x_(std::numeric_limits<double>::lowest()),
   last_min_y_(std::numeric_limits<double>::lowest()),
   last_max_x_(std::numeric_limits<double>::max()),
-  last_max_y_(std::numeric_limits<double>::max())
+  last_max_y_(std::numeric_limits<double>::max()),
+  static_map_revision_(0),
+  static_inflation_dirty_(true)
 {
   access_ = new mutex_t();
 }
@@ -167,6 +170,26 @@ InflationLayer::updateCosts(
   int max_i,
   int max_j)
 {
+  unsigned int size_x = master_grid.getSizeInCellsX(), size_y = master_grid.getSizeInCellsY();
+
+  // Snapshot a changed static map before taking our own lock: the static layer
+  // holds its lock while resizing the layered costmap, which takes ours
+  std::shared_ptr<StaticLayer> static_layer;
+  bool static_map_changed = false;
+  if (enabled_ && cell_inflation_radius_ != 0) {
+    static_layer = findStaticLayer(size_x, size_y);
+  }
+  if (static_layer) {
+    std::lock_guard<Costmap2D::mutex_t> static_guard(*static_layer->getMutex());
+    unsigned int revision = static_layer->getMapRevision();
+    if (static_inflation_dirty_.exchange(false) || revision != static_map_revision_) {
+      const unsigned char * static_array = static_layer->getCharMap();
+      static_map_.assign(static_array, static_array + size_x * size_y);
+      static_map_revision_ = revision;
+      static_map_changed = true;
+    }
+  }
+
   std::lock_guard<Costmap2D::mutex_t> guard(*getMutex());
   if (!enabled_ || (cell_inflation_radius_ == 0)) {
     return;
@@ -180,7 +203,6 @@ InflationLayer::updateCosts(
   }
 
   unsigned char * master_array = master_grid.getCharMap();
-  unsigned int size_x = master_grid.getSizeInCellsX(), size_y = master_grid.getSizeInCellsY();
 
   if (seen_.size() != size_x * size_y) {
     RCLCPP_WARN(
@@ -189,6 +211,10 @@ InflationLayer::updateCosts(
     seen_ = std::vector<bool>(size_x * size_y, false);
   }
 
+  if (static_map_changed) {
+    inflateStaticMap(size_x, size_y);
+  }
+
   std::fill(begin(seen_), end(seen_), false);
 
   // We need to include in the inflation cells outside the bounding
@@ -211,17 +237,70 @@ InflationLayer::updateCosts(
   // with a notable performance boost
 
   // Start with lethal obstacles: by definition distance is 0.0
+  // Static obstacles are already inflated in static_inflation_, unless a layer
+  // above the static one cleared some of them; then inflate everything
+  bool use_static_inflation = static_layer && static_map_.size() == size_x * size_y &&
+    static_inflation_.size() == size_x * size_y;
   auto & obs_bin = inflation_cells_[0];
-  for (int j = min_j; j < max_j; j++) {
+  for (int j = min_j; j < max_j && use_static_inflation; j++) {
     for (int i = min_i; i < max_i; i++) {
       int index = static_cast<int>(master_grid.getIndex(i, j));
-      unsigned char cost = master_array[index];
-      if (cost == LETHAL_OBSTACLE || (inflate_around_unknown_ && cost == NO_INFORMATION)) {
+      bool static_source = isInflationSource(static_map_[index]);
+      if (!isInflationSource(master_array[index])) {
+        if (static_source) {
+          use_static_inflation = false;
+          break;
+        }
+      } else if (!static_source) {
         obs_bin.emplace_back(index, i, j, i, j);
       }
     }
   }
 
+  if (!use_static_inflation) {
+    obs_bin.clear();
+    for (int j = min_j; j < max_j; j++) {
+      for (int i = min_i; i < max_i; i++) {
+        int index = static_cast<int>(master_grid.getIndex(i, j));
+        if (isInflationSource(master_array[index])) {
+          obs_bin.emplace_back(index, i, j, i, j);
+        }
+      }
+    }
+  }
+
+  // assign the cost associated with the distance from an obstacle to the cell
+  auto apply_cost = [this, master_array](unsigned int index, unsigned char cost) {
+      unsigned char old_cost = master_array[index];
+      if (old_cost == NO_INFORMATION &&
+        (inflate_unknown_ ? (cost > FREE_SPACE) : (cost >= INSCRIBED_INFLATED_OBSTACLE)))
+      {
+        master_array[index] = cost;
+      } else {
+        master_array[index] = std::max(old_cost, cost);
+      }
+    };
+
+  // Costs only fall off with distance, so taking the max of the static and the
+  // dynamic inflation gives the cost of the nearest obstacle of either kind. In the
+  // few cells where one pass over both would let the wavefront of one obstacle
+  // shadow a nearer one, this is the higher, nearest obstacle cost
+  if (use_static_inflation) {
+    for (int j = min_j; j < max_j; j++) {
+      unsigned int index = master_grid.getIndex(min_i, j);
+      for (int i = min_i; i < max_i; i++, index++) {
+        apply_cost(index, static_inflation_[index]);
+      }
+    }
+  }
+
+  propagate(size_x, size_y, apply_cost);
+}
+
+template<typename ApplyT>
+void
+InflationLayer::propagate(unsigned int size_x, unsigned int size_y, ApplyT apply)
+{
   // Process cells by increasing distance; new cells are appended to the
   // corresponding distance bin, so they
   // can overtake previously inserted but farther away cells
@@ -244,16 +323,7 @@ InflationLayer::updateCosts(
       unsigned int sx = dist_bin[i].src_x_;
       unsigned int sy = dist_bin[i].src_y_;
 
-      // assign the cost associated with the distance from an obstacle to the cell
-      unsigned char cost = costLookup(mx, my, sx, sy);
-      unsigned char old_cost = master_array[index];
-      if (old_cost == NO_INFORMATION &&
-        (inflate_unknown_ ? (cost > FREE_SPACE) : (cost >= INSCRIBED_INFLATED_OBSTACLE)))
-      {
-        master_array[index] = cost;
-      } else {
-        master_array[index] = std::max(old_cost, cost);
-      }
+      apply(index, costLookup(mx, my, sx, sy));
 
       // attempt to put the neighbors of the current cell onto the inflation list
       if (mx > 0) {
@@ -277,6 +347,51 @@ InflationLayer::updateCosts(
   }
 }
 
+std::shared_ptr<StaticLayer>
+InflationLayer::findStaticLayer(unsigned int size_x, unsigned int size_y)
+{
+  // A rolling window's static layer keeps the whole map in its own frame
+  if (layered_costmap_->isRolling()) {
+    return nullptr;
+  }
+
+  // Only a static layer updated before this one has its obstacles in the master grid
+  for (auto & plugin : *layered_costmap_->getPlugins()) {
+    if (plugin.get() == this) {
+      break;
+    }
+    auto static_layer = std::dynamic_pointer_cast<StaticLayer>(plugin);
+    if (static_layer && static_layer->getMapRevision() != 0 &&
+      static_layer->getSizeInCellsX() == size_x && static_layer->getSizeInCellsY() == size_y)
+    {
+      return static_layer;
+    }
+  }
+  return nullptr;
+}
+
+void
+InflationLayer::inflateStaticMap(unsigned int size_x, unsigned int size_y)
+{
+  static_inflation_.assign(size_x * size_y, FREE_SPACE);
+  std::fill(begin(seen_), end(seen_), false);
+
+  auto & obs_bin = inflation_cells_[0];
+  unsigned int index = 0;
+  for (unsigned int j = 0; j < size_y; j++) {
+    for (unsigned int i = 0; i < size_x; i++, index++) {
+      if (isInflationSource(static_map_[index])) {
+        obs_bin.emplace_back(index, i, j, i, j);
+      }
+    }
+  }
+
+  propagate(
+    size_x, size_y, [this](unsigned int index, unsigned char cost) {
+      static_inflation_[index] = cost;
+    });
+}
+
 /**
  * @brief  Given an index of a cell in the costmap, place it into a list pending for obstacle inflation
  * @param  grid The costmap
@@ -340,6 +455,9 @@ InflationLayer::computeCaches()
     }
   }
 
+  // Costs or the inflation radius changed, so the static map has to be reinflated
+  static_inflation_dirty_ = true;
+
   int max_dist = generateIntegerDistances();
   inflation_cells_.clear();
   inflation_cells_.resize(max_dist + 1);
@@ -59,6 +59,8 @@ using nav2_costmap_2d::Observation;
 namespace nav2_costmap_2d
 {
 
+constexpr unsigned int ObstacleLayer::NO_ENDPOINT;
+
 ObstacleLayer::~ObstacleLayer()
 {
   for (auto & notifier : observation_notifiers_) {
@@ -82,6 +84,7 @@ void ObstacleLayer::onInitialize()
   declareParameter("max_obstacle_height", rclcpp::ParameterValue(2.0));
   declareParameter("combination_method", rclcpp::ParameterValue(1));
   declareParameter("observation_sources", rclcpp::ParameterValue(std::string("")));
+  declareParameter("raytrace_threads", rclcpp::ParameterValue(1));
 
   node_->get_parameter(name_ + "." + "enabled", enabled_);
   node_->get_parameter(name_ + "." + "footprint_clearing_enabled", footprint_clearing_enabled_);
@@ -90,6 +93,8 @@ void ObstacleLayer::onInitialize()
   node_->get_parameter("track_unknown_space", track_unknown_space);
   node_->get_parameter("transform_tolerance", transform_tolerance);
   node_->get_parameter(name_ + "." + "observation_sources", topics_string);
+  node_->get_parameter(name_ + "." + "raytrace_threads", raytrace_threads_);
+  raytrace_threads_ = std::max(1, raytrace_threads_);
 
   RCLCPP_INFO(node_->get_logger(), "Subscribed to Topics: %s", topics_string.c_str());
 
@@ -128,6 +133,7 @@ void ObstacleLayer::onInitialize()
     declareParameter(source + "." + "clearing", rclcpp::ParameterValue(false));
     declareParameter(source + "." + "obstacle_range", rclcpp::ParameterValue(2.5));
     declareParameter(source + "." + "raytrace_range", rclcpp::ParameterValue(3.0));
+    declareParameter(source + "." + "observation_capacity", rclcpp::ParameterValue(0));
 
     node_->get_parameter(name_ + "." + source + "." + "topic", topic);
     node_->get_parameter(name_ + "." + source + "." + "sensor_frame", sensor_frame);
@@ -160,6 +166,13 @@ void ObstacleLayer::onInitialize()
     double raytrace_range;
     node_->get_parameter(name_ + "." + source + "." + "raytrace_range", raytrace_range);
 
+    // get the number of observation slots to preallocate for the sensor,
+    // 0 lets the buffer size itself from the persistence and expected update rate
+    int observation_capacity;
+    node_->get_parameter(
+      name_ + "." + source + "." + "observation_capacity",
+      observation_capacity);
+
     RCLCPP_DEBUG(
       node_->get_logger(),
       "Creating an observation buffer for source %s, topic %s, frame %s",
@@ -174,7 +187,7 @@ void ObstacleLayer::onInitialize()
           node_, topic, observation_keep_time, expected_update_rate,
           min_obstacle_height,
           max_obstacle_height, obstacle_range, raytrace_range, *tf_, global_frame_,
-          sensor_frame, transform_tolerance)));
+          sensor_frame, transform_tolerance, std::max(observation_capacity, 0))));
 
     // check if we'll add this buffer to our marking observation buffers
     if (marking) {
@@ -281,9 +294,7 @@ ObstacleLayer::laserScanCallback(
   }
 
   // buffer the point cloud
-  buffer->lock();
   buffer->bufferCloud(cloud);
-  buffer->unlock();
 }
 
 void
@@ -317,9 +328,7 @@ ObstacleLayer::laserScanValidInfCallback(
   }
 
   // buffer the point cloud
-  buffer->lock();
   buffer->bufferCloud(cloud);
-  buffer->unlock();
 }
 
 void
@@ -328,9 +337,7 @@ ObstacleLayer::pointCloud2Callback(
   const std::shared_ptr<ObservationBuffer> & buffer)
 {
   // buffer the point cloud
-  buffer->lock();
   buffer->bufferCloud(*message);
-  buffer->unlock();
 }
 
 void
@@ -482,34 +489,49 @@ ObstacleLayer::clearStaticObservations(bool marking, bool clearing)
 bool
 ObstacleLayer::getMarkingObservations(std::vector<Observation> & marking_observations) const
 {
+  // when replaying a recording, the recorded observations stand in for the buffers
+  if (const CostmapCycle * cycle = layered_costmap_->getReplayCycle()) {
+    cycle->getObservations(name_, RECORD_MARKING_OBSERVATIONS, marking_observations);
+    return true;
+  }
+
   bool current = true;
   // get the marking observations
   for (unsigned int i = 0; i < marking_buffers_.size(); ++i) {
-    marking_buffers_[i]->lock();
     marking_buffers_[i]->getObservations(marking_observations);
     current = marking_buffers_[i]->isCurrent() && current;
-    marking_buffers_[i]->unlock();
   }
   marking_observations.insert(
     marking_observations.end(),
     static_marking_observations_.begin(), static_marking_observations_.end());
+
+  if (CostmapRecorder * recorder = layered_costmap_->getRecorder()) {
+    recorder->writeObservations(name_, RECORD_MARKING_OBSERVATIONS, marking_observations);
+  }
   return current;
 }
 
 bool
 ObstacleLayer::getClearingObservations(std::vector<Observation> & clearing_observations) const
 {
+  if (const CostmapCycle * cycle = layered_costmap_->getReplayCycle()) {
+    cycle->getObservations(name_, RECORD_CLEARING_OBSERVATIONS, clearing_observations);
+    return true;
+  }
+
   bool current = true;
   // get the clearing observations
   for (unsigned int i = 0; i < clearing_buffers_.size(); ++i) {
-    clearing_buffers_[i]->lock();
     clearing_buffers_[i]->getObservations(clearing_observations);
     current = clearing_buffers_[i]->isCurrent() && current;
-    clearing_buffers_[i]->unlock();
   }
   clearing_observations.insert(
     clearing_observations.end(),
     static_clearing_observations_.begin(), static_clearing_observations_.end());
+
+  if (CostmapRecorder * recorder = layered_costmap_->getRecorder()) {
+    recorder->writeObservations(name_, RECORD_CLEARING_OBSERVATIONS, clearing_observations);
+  }
   return current;
 }
 
@@ -542,6 +564,13 @@ ObstacleLayer::raytraceFreespace(
 
   touch(ox, oy, min_x, min_y, max_x, max_y);
 
+  unsigned int cell_raytrace_range = cellDistance(clearing_observation.raytrace_range_);
+
+  // dense clouds put many points into the same cell, and every ray from the origin cell to
+  // the same endpoint cell walks the same line, so only unique endpoints are traced
+  beginEndpointPass(static_cast<size_t>(cloud.width) * cloud.height);
+  clearing_endpoints_.clear();
+
   // for each point in the cloud, we want to trace a line from the origin
   // and clear obstacles along it
   sensor_msgs::PointCloud2ConstIterator<float> iter_x(cloud, "x");
@@ -588,15 +617,41 @@ ObstacleLayer::raytraceFreespace(
       continue;
     }
 
-    unsigned int cell_raytrace_range = cellDistance(clearing_observation.raytrace_range_);
+    // the bounds still grow with every point since the range clipped end may differ
+    updateRaytraceBounds(
+      ox, oy, wx, wy, clearing_observation.raytrace_range_, min_x, min_y, max_x,
+      max_y);
+
+    unsigned int index = getIndex(x1, y1);
+    if (firstEndpointInCell(index)) {
+      clearing_endpoints_.push_back(index);
+    }
+  }
+
+  // clearing only ever writes FREE_SPACE, so rays can be traced in any order and on any thread
+  const int num_endpoints = static_cast<int>(clearing_endpoints_.size());
+
+  #pragma omp parallel for num_threads(raytrace_threads_) schedule(static)
+  for (int i = 0; i < num_endpoints; ++i) {
+    unsigned int x1, y1;
+    indexToCells(clearing_endpoints_[i], x1, y1);
+
     MarkCell marker(costmap_, FREE_SPACE);
     // and finally... we can execute our trace to clear obstacles along that line
     raytraceLine(marker, x0, y0, x1, y1, cell_raytrace_range);
+  }
+}
 
-    updateRaytraceBounds(
-      ox, oy, wx, wy, clearing_observation.raytrace_range_, min_x, min_y, max_x,
-      max_y);
+void
+ObstacleLayer::beginEndpointPass(size_t max_endpoints)
+{
+  // a power of two at least twice the endpoints keeps the probe sequences short
+  int bits = 4;
+  while ((size_t(1) << bits) < 2 * max_endpoints && bits < 31) {
+    bits++;
   }
+  endpoint_cells_.assign(size_t(1) << bits, NO_ENDPOINT);
+  endpoint_shift_ = 32 - bits;
 }
 
 void
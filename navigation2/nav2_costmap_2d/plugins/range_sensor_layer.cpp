@@ -33,8 +33,8 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <angles/angles.h>
 #include <algorithm>
+#include <cmath>
 #include <list>
 #include <limits>
 #include <string>
@@ -55,6 +55,10 @@ using namespace std::literals::chrono_literals;
 namespace nav2_costmap_2d
 {
 
+constexpr double RangeSensorLayer::DELTA_TABLE_STEP;
+constexpr unsigned int RangeSensorLayer::GAMMA_TABLE_SIZE;
+constexpr unsigned int RangeSensorLayer::MAX_GAMMA_TABLES;
+
 RangeSensorLayer::RangeSensorLayer() {}
 
 void RangeSensorLayer::onInitialize()
@@ -71,6 +75,7 @@ void RangeSensorLayer::onInitialize()
   node_->get_parameter(name_ + "." + "enabled", enabled_);
   declareParameter("phi", rclcpp::ParameterValue(1.2));
   node_->get_parameter(name_ + "." + "phi", phi_v_);
+  buildDeltaTable();
   declareParameter("inflate_cone", rclcpp::ParameterValue(1.0));
   node_->get_parameter(name_ + "." + "inflate_cone", inflate_cone_);
   declareParameter("no_readings_timeout", rclcpp::ParameterValue(0.0));
@@ -162,13 +167,112 @@ double RangeSensorLayer::gamma(double theta)
   if (fabs(theta) > max_angle_) {
     return 0.0;
   } else {
-    return 1 - pow(theta / max_angle_, 2);
+    double t = theta / max_angle_;
+    return 1 - t * t;
   }
 }
 
 double RangeSensorLayer::delta(double phi)
 {
-  return 1 - (1 + tanh(2 * (phi - phi_v_))) / 2;
+  // Linear interpolation in the table; past its end delta is 0 to within 1e-9
+  double f = phi / DELTA_TABLE_STEP;
+  if (f >= delta_table_.size() - 1) {
+    return delta_table_.back();
+  }
+  unsigned int i = static_cast<unsigned int>(f);
+  f -= i;
+  return delta_table_[i] + f * (delta_table_[i + 1] - delta_table_[i]);
+}
+
+void RangeSensorLayer::buildDeltaTable()
+{
+  // delta(phi) falls from 1 to 0 around phi_v_; 10 meters past it tanh has saturated
+  unsigned int n =
+    static_cast<unsigned int>((std::max(phi_v_, 0.0) + 10.0) / DELTA_TABLE_STEP) + 2;
+  delta_table_.resize(n);
+  for (unsigned int i = 0; i < n; ++i) {
+    delta_table_[i] = 1 - (1 + tanh(2 * (i * DELTA_TABLE_STEP - phi_v_))) / 2;
+  }
+}
+
+void RangeSensorLayer::setMaxAngle(double max_angle)
+{
+  max_angle_ = max_angle;
+
+  // Past 90 degrees off the axis sin(theta)^2 decreases again, and close to
+  // it theta changes too fast with sin(theta)^2 to interpolate, so cones wider
+  // than 80 degrees each side are not tabulated and take the atan2
+  if (!(max_angle_ > 0.0 && max_angle_ <= M_PI * 4 / 9)) {
+    gamma_table_ = nullptr;
+    return;
+  }
+
+  // A layer sees the fields of view of a few sensors, so the tables are kept
+  // for as long as they are few
+  auto it = gamma_tables_.find(max_angle_);
+  if (it == gamma_tables_.end()) {
+    if (gamma_tables_.size() >= MAX_GAMMA_TABLES) {
+      gamma_tables_.clear();
+    }
+    std::vector<double> table(GAMMA_TABLE_SIZE);
+    double max_sin2 = sin(max_angle_) * sin(max_angle_);
+    for (unsigned int i = 0; i < GAMMA_TABLE_SIZE; ++i) {
+      double sin2 = max_sin2 * i / (GAMMA_TABLE_SIZE - 1);
+      table[i] = gamma(std::min(asin(sqrt(sin2)), max_angle_));
+    }
+    it = gamma_tables_.emplace(max_angle_, std::move(table)).first;
+  }
+  gamma_table_ = &it->second;
+  gamma_table_scale_ = (GAMMA_TABLE_SIZE - 1) / (sin(max_angle_) * sin(max_angle_));
+}
+
+double RangeSensorLayer::tabulated_gamma(double along, double across, double phi2)
+{
+  // Behind the sensor, the bearing is past 90 degrees and so past max_angle_
+  if (along < 0.0) {
+    return 0.0;
+  }
+  double f = phi2 > 0.0 ? across * across / phi2 * gamma_table_scale_ : 0.0;
+  // gamma is 0 at max_angle_, the end of the table, and beyond
+  if (f >= GAMMA_TABLE_SIZE - 1) {
+    return 0.0;
+  }
+  const std::vector<double> & table = *gamma_table_;
+  unsigned int i = static_cast<unsigned int>(f);
+  f -= i;
+  return table[i] + f * (table[i + 1] - table[i]);
+}
+
+double RangeSensorLayer::cell_sensor_model(
+  double dx, double dy, double cos_ot, double sin_ot, double r)
+{
+  // Coordinates in the sensor frame
+  double along = dx * cos_ot + dy * sin_ot;
+  double across = dy * cos_ot - dx * sin_ot;
+  double phi2 = along * along + across * across;
+  double phi = sqrt(phi2);
+
+  double g;
+  if (gamma_table_ != nullptr) {
+    g = tabulated_gamma(along, across, phi2);
+  } else {
+    // Bearing relative to the sensor axis, already normalized to [-pi, pi]
+    g = gamma(atan2(across, along));
+  }
+  return sensor_model_lambda(r, phi, delta(phi) * g);
+}
+
+void RangeSensorLayer::setCone(int ox, int oy, int ax, int ay, int bx, int by)
+{
+  // Barycentric coordinates inside area threshold; this is not mathematically
+  // sound at all, but it works!
+  cone_ox_ = ox;
+  cone_oy_ = oy;
+  cone_ax_ = ax;
+  cone_ay_ = ay;
+  cone_bx_ = bx;
+  cone_by_ = by;
+  cone_threshold_ = -static_cast<float>(inflate_cone_) * area(ax, ay, bx, by, ox, oy);
 }
 
 void RangeSensorLayer::get_deltas(double angle, double * dx, double * dy)
@@ -186,18 +290,21 @@ void RangeSensorLayer::get_deltas(double angle, double * dx, double * dy)
 
 double RangeSensorLayer::sensor_model(double r, double phi, double theta)
 {
-  double lbda = delta(phi) * gamma(theta);
+  return sensor_model_lambda(r, phi, delta(phi) * gamma(theta));
+}
 
+double RangeSensorLayer::sensor_model_lambda(double r, double phi, double lbda)
+{
   double delta = resolution_;
 
   if (phi >= 0.0 && phi < r - 2 * delta * r) {
     return (1 - lbda) * (0.5);
   } else if (phi < r - delta * r) {
-    return lbda * 0.5 * pow((phi - (r - 2 * delta * r)) / (delta * r), 2) +
-           (1 - lbda) * .5;
+    double J = (phi - (r - 2 * delta * r)) / (delta * r);
+    return lbda * 0.5 * J * J + (1 - lbda) * .5;
   } else if (phi < r + delta * r) {
     double J = (r - phi) / (delta * r);
-    return lbda * ((1 - (0.5) * pow(J, 2)) - 0.5) + 0.5;
+    return lbda * ((1 - (0.5) * J * J) - 0.5) + 0.5;
   } else {
     return 0.5;
   }
@@ -280,7 +387,7 @@ void RangeSensorLayer::updateCostmap(
   sensor_msgs::msg::Range & range_message,
   bool clear_sensor_cone)
 {
-  max_angle_ = range_message.field_of_view / 2;
+  setMaxAngle(range_message.field_of_view / 2);
 
   geometry_msgs::msg::PointStamped in, out;
   in.header.stamp = range_message.header.stamp;
@@ -354,35 +461,32 @@ void RangeSensorLayer::updateCostmap(
   // Limit Bounds to Grid
   bx0 = std::max(0, bx0);
   by0 = std::max(0, by0);
-  bx1 = std::min(static_cast<int>(size_x_), bx1);
-  by1 = std::min(static_cast<int>(size_y_), by1);
-
-  for (unsigned int x = bx0; x <= (unsigned int)bx1; x++) {
-    for (unsigned int y = by0; y <= (unsigned int)by1; y++) {
-      bool update_xy_cell = true;
-
-      // Unless inflate_cone_ is set to 100 %, we update cells only within the
-      // (partially inflated) sensor cone, projected on the costmap as a triangle.
-      // 0 % corresponds to just the triangle, but if your sensor fov is very
-      // narrow, the covered area can become zero due to cell discretization.
-      // See wiki description for more details
-      if (inflate_cone_ < 1.0) {
-        // Determine barycentric coordinates
-        int w0 = orient2d(Ax, Ay, Bx, By, x, y);
-        int w1 = orient2d(Bx, By, Ox, Oy, x, y);
-        int w2 = orient2d(Ox, Oy, Ax, Ay, x, y);
-
-        // Barycentric coordinates inside area threshold; this is not mathematically
-        // sound at all, but it works!
-        float bcciath = -static_cast<float>(inflate_cone_) * area(Ax, Ay, Bx, By, Ox, Oy);
-        update_xy_cell = w0 >= bcciath && w1 >= bcciath && w2 >= bcciath;
-      }
+  bx1 = std::min(static_cast<int>(size_x_) - 1, bx1);
+  by1 = std::min(static_cast<int>(size_y_) - 1, by1);
 
-      if (update_xy_cell) {
-        double wx, wy;
-        mapToWorld(x, y, wx, wy);
-        update_cell(ox, oy, theta, range_message.range, wx, wy, clear_sensor_cone);
-      }
+  setCone(Ox, Oy, Ax, Ay, Bx, By);
+
+  double cos_theta = cos(theta), sin_theta = sin(theta);
+
+  for (int y = by0; y <= by1; y++) {
+    int x0 = bx0, x1 = bx1;
+
+    // Unless inflate_cone_ is set to 100 %, we update cells only within the
+    // (partially inflated) sensor cone, projected on the costmap as a triangle.
+    // 0 % corresponds to just the triangle, but if your sensor fov is very
+    // narrow, the covered area can become zero due to cell discretization.
+    // See wiki description for more details
+    if (inflate_cone_ < 1.0 && !clipConeRow(y, x0, x1)) {
+      continue;
+    }
+
+    double wy = origin_y_ + (y + 0.5) * resolution_;
+    unsigned int index = getIndex(x0, y);
+    for (int x = x0; x <= x1; x++, index++) {
+      double wx = origin_x_ + (x + 0.5) * resolution_;
+      update_cell(
+        index, wx - ox, wy - oy, cos_theta, sin_theta, range_message.range,
+        clear_sensor_cone);
     }
   }
 
@@ -390,30 +494,66 @@ void RangeSensorLayer::updateCostmap(
   last_reading_time_ = node_->now();
 }
 
+bool RangeSensorLayer::clipConeRow(int y, int & x0, int & x1)
+{
+  // Each barycentric coordinate is linear in x along a row, so the cone covers
+  // one contiguous span of it. Solve for the span bounds, widened by a cell to
+  // absorb rounding, then tighten them with the exact per-cell test.
+  auto inside = [this, y](int x) {
+      int w0 = orient2d(cone_ax_, cone_ay_, cone_bx_, cone_by_, x, y);
+      int w1 = orient2d(cone_bx_, cone_by_, cone_ox_, cone_oy_, x, y);
+      int w2 = orient2d(cone_ox_, cone_oy_, cone_ax_, cone_ay_, x, y);
+      return w0 >= cone_threshold_ && w1 >= cone_threshold_ && w2 >= cone_threshold_;
+    };
+
+  double lo = x0, hi = x1;
+  auto clip = [this, y, &lo, &hi](int ax, int ay, int bx, int by) {
+      // orient2d(A, B, x, y) = a * x + b
+      double a = ay - by;
+      double b = static_cast<double>(bx - ax) * (y - ay) + static_cast<double>(by - ay) * ax;
+      double bound = (cone_threshold_ - b) / a;
+      if (a > 0) {
+        lo = std::max(lo, std::ceil(bound) - 1);
+      } else if (a < 0) {
+        hi = std::min(hi, std::floor(bound) + 1);
+      } else if (b < cone_threshold_) {
+        hi = lo - 1;
+      }
+    };
+  clip(cone_ax_, cone_ay_, cone_bx_, cone_by_);
+  clip(cone_bx_, cone_by_, cone_ox_, cone_oy_);
+  clip(cone_ox_, cone_oy_, cone_ax_, cone_ay_);
+  if (lo > hi) {
+    return false;
+  }
+
+  x0 = static_cast<int>(lo);
+  x1 = static_cast<int>(hi);
+  while (x0 <= x1 && !inside(x0)) {
+    x0++;
+  }
+  while (x1 >= x0 && !inside(x1)) {
+    x1--;
+  }
+  return x0 <= x1;
+}
+
 void RangeSensorLayer::update_cell(
-  double ox, double oy, double ot, double r,
-  double nx, double ny, bool clear)
+  unsigned int index, double dx, double dy, double cos_ot, double sin_ot,
+  double r, bool clear)
 {
-  unsigned int x, y;
-  if (worldToMap(nx, ny, x, y)) {
-    double dx = nx - ox, dy = ny - oy;
-    double theta = atan2(dy, dx) - ot;
-    theta = angles::normalize_angle(theta);
-    double phi = sqrt(dx * dx + dy * dy);
-    double sensor = 0.0;
-    if (!clear) {
-      sensor = sensor_model(r, phi, theta);
-    }
-    double prior = to_prob(getCost(x, y));
-    double prob_occ = sensor * prior;
-    double prob_not = (1 - sensor) * (1 - prior);
-    double new_prob = prob_occ / (prob_occ + prob_not);
-
-    RCLCPP_DEBUG(node_->get_logger(), "%f %f | %f %f = %f", dx, dy, theta, phi, sensor);
-    RCLCPP_DEBUG(node_->get_logger(), "%f | %f %f | %f", prior, prob_occ, prob_not, new_prob);
-    unsigned char c = to_cost(new_prob);
-    setCost(x, y, c);
+  double sensor = 0.0;
+  if (!clear) {
+    sensor = cell_sensor_model(dx, dy, cos_ot, sin_ot, r);
+    RCLCPP_DEBUG(node_->get_logger(), "%f %f = %f", dx, dy, sensor);
   }
+  double prior = to_prob(costmap_[index]);
+  double prob_occ = sensor * prior;
+  double prob_not = (1 - sensor) * (1 - prior);
+  double new_prob = prob_occ / (prob_occ + prob_not);
+
+  RCLCPP_DEBUG(node_->get_logger(), "%f | %f %f | %f", prior, prob_occ, prob_not, new_prob);
+  costmap_[index] = to_cost(new_prob);
 }
 
 void RangeSensorLayer::resetRange()
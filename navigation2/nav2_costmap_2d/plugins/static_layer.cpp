@@ -42,6 +42,8 @@
 #include <algorithm>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "nav2_costmap_2d/costmap_math.hpp"
 #include "pluginlib/class_list_macros.hpp"
@@ -149,13 +151,20 @@ StaticLayer::getParameters()
   // Enforce bounds
   lethal_threshold_ = std::max(std::min(temp_lethal_threshold, 100), 0);
   map_received_ = false;
+
+  // Occupancy values are bytes, so interpret each possible one up front
+  for (unsigned int value = 0; value < cost_translation_table_.size(); ++value) {
+    cost_translation_table_[value] = interpretValue(static_cast<unsigned char>(value));
+  }
   update_in_progress_.store(false);
 
   transform_tolerance_ = tf2::durationFromSec(temp_tf_tol);
 }
 
 void
-StaticLayer::processMap(const nav_msgs::msg::OccupancyGrid & new_map)
+StaticLayer::processMap(
+  const nav_msgs::msg::OccupancyGrid & new_map,
+  std::unique_ptr<unsigned char[]> costs)
 {
   RCLCPP_DEBUG(node_->get_logger(), "StaticLayer: Process map");
 
@@ -198,19 +207,22 @@ StaticLayer::processMap(const nav_msgs::msg::OccupancyGrid & new_map)
   }
 
 
-  unsigned int index = 0;
   std::lock_guard<Costmap2D::mutex_t> guard(*getMutex());
   // initialize the costmap with static data
-  for (unsigned int i = 0; i < size_y_; ++i) {
-    for (unsigned int j = 0; j < size_x_; ++j) {
-      if(i>=size_y || j>=size_x){
-        costmap_[master->getIndex(j,i)] = NO_INFORMATION;
-      }
-      else{
-        unsigned char value = new_map.data[index];
-        costmap_[master->getIndex(j,i)] =interpretValue(value);
-        ++index;
+  if (size_x == size_x_ && size_y == size_y_ && master->getSizeInCellsX() == size_x_) {
+    // The translated map already has the layer's layout, so just take it over
+    delete[] costmap_;
+    costmap_ = costs.release();
+  } else {
+    unsigned int copy_x = std::min(size_x, size_x_);
+    for (unsigned int i = 0; i < size_y_; ++i) {
+      unsigned char * row = costmap_ + master->getIndex(0, i);
+      if (i >= size_y) {
+        std::fill(row, row + size_x_, NO_INFORMATION);
+        continue;
       }
+      std::copy(costs.get() + i * size_x, costs.get() + i * size_x + copy_x, row);
+      std::fill(row + copy_x, row + size_x_, NO_INFORMATION);
     }
   }
 
@@ -221,6 +233,7 @@ StaticLayer::processMap(const nav_msgs::msg::OccupancyGrid & new_map)
   width_ = size_x_;
   height_ = size_y_;
   has_updated_data_ = true;
+  map_revision_++;
 
   current_ = true;
 }
@@ -256,25 +269,57 @@ StaticLayer::interpretValue(unsigned char value)
   return scale * LETHAL_OBSTACLE;
 }
 
+void
+StaticLayer::translateValues(const int8_t * data, size_t size, unsigned char * costs) const
+{
+  const unsigned char * table = cost_translation_table_.data();
+  for (size_t i = 0; i < size; ++i) {
+    costs[i] = table[static_cast<unsigned char>(data[i])];
+  }
+}
+
 void
 StaticLayer::incomingMap(const nav_msgs::msg::OccupancyGrid::SharedPtr new_map)
 {
+  if (CostmapRecorder * recorder = layered_costmap_->getRecorder()) {
+    recorder->writeMap(name_, *new_map);
+  }
+
+  // Translate the whole map before taking the lock; only the copy or swap into
+  // the layer happens under it
+  size_t size = static_cast<size_t>(new_map->info.width) * new_map->info.height;
+  if (new_map->data.size() < size) {
+    RCLCPP_ERROR(
+      node_->get_logger(),
+      "StaticLayer: Map ignored. It has %zu cells of data for a %d X %d map",
+      new_map->data.size(), new_map->info.width, new_map->info.height);
+    return;
+  }
+  std::unique_ptr<unsigned char[]> costs(new unsigned char[size]);
+  translateValues(new_map->data.data(), size, costs.get());
+
   std::lock_guard<Costmap2D::mutex_t> guard(*getMutex());
-  if (!map_received_) {
+  if (!map_received_ || !update_in_progress_.load()) {
     map_received_ = true;
-    processMap(*new_map);
-  }
-  if (update_in_progress_.load()) {
-    map_buffer_ = new_map;
-  } else {
-    processMap(*new_map);
+    processMap(*new_map, std::move(costs));
     map_buffer_ = nullptr;
+    map_buffer_costs_.reset();
+  } else {
+    map_buffer_ = new_map;
+    map_buffer_costs_ = std::move(costs);
   }
 }
 
 void
 StaticLayer::incomingUpdate(map_msgs::msg::OccupancyGridUpdate::ConstSharedPtr update)
 {
+  if (CostmapRecorder * recorder = layered_costmap_->getRecorder()) {
+    recorder->writeMapUpdate(name_, *update);
+  }
+
+  std::vector<unsigned char> costs(update->data.size());
+  translateValues(update->data.data(), costs.size(), costs.data());
+
   std::lock_guard<Costmap2D::mutex_t> guard(*getMutex());
   if (update->y < static_cast<int32_t>(y_) ||
     y_ + height_ < update->y + update->height ||
@@ -299,13 +344,9 @@ StaticLayer::incomingUpdate(map_msgs::msg::OccupancyGridUpdate::ConstSharedPtr u
       map_frame_.c_str(), update->header.frame_id.c_str());
   }
 
-  unsigned int di = 0;
   for (unsigned int y = 0; y < update->height; y++) {
-    unsigned int index_base = (update->y + y) * size_x_;
-    for (unsigned int x = 0; x < update->width; x++) {
-      unsigned int index = index_base + x + update->x;
-      costmap_[index] = interpretValue(update->data[di++]);
-    }
+    auto row = costs.begin() + y * update->width;
+    std::copy(row, row + update->width, costmap_ + (update->y + y) * size_x_ + update->x);
   }
 
   x_ = update->x;
@@ -313,6 +354,7 @@ StaticLayer::incomingUpdate(map_msgs::msg::OccupancyGridUpdate::ConstSharedPtr u
   width_ = update->width;
   height_ = update->height;
   has_updated_data_ = true;
+  map_revision_++;
 }
 
 
@@ -323,6 +365,21 @@ StaticLayer::updateBounds(
   double * max_x,
   double * max_y)
 {
+  // when replaying a recording, apply the maps recorded for this cycle as if
+  // they had just arrived
+  if (const CostmapCycle * cycle = layered_costmap_->getReplayCycle()) {
+    for (const CostmapRecord & record : cycle->records) {
+      if (record.layer != name_) {
+        continue;
+      }
+      if (record.type == RECORD_MAP) {
+        incomingMap(decodeMap(record));
+      } else if (record.type == RECORD_MAP_UPDATE) {
+        incomingUpdate(decodeMapUpdate(record));
+      }
+    }
+  }
+
   if (!map_received_) {
     return;
   }
@@ -332,7 +389,7 @@ StaticLayer::updateBounds(
 
   // If there is a new available map, load it.
   if (map_buffer_) {
-    processMap(*map_buffer_);
+    processMap(*map_buffer_, std::move(map_buffer_costs_));
     map_buffer_ = nullptr;
   }
 
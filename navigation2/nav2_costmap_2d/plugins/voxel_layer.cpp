@@ -43,11 +43,11 @@
 #include <vector>
 #include <memory>
 #include <utility>
+#include <type_traits>
 
 #include "pluginlib/class_list_macros.hpp"
 #include "sensor_msgs/point_cloud2_iterator.hpp"
 
-#define VOXEL_BITS 16
 PLUGINLIB_EXPORT_CLASS(nav2_costmap_2d::VoxelLayer, nav2_costmap_2d::Layer)
 
 using nav2_costmap_2d::NO_INFORMATION;
@@ -85,17 +85,29 @@ void VoxelLayer::onInitialize()
 
   auto custom_qos = rclcpp::QoS(rclcpp::KeepLast(1)).transient_local().reliable();
 
+  // the voxel grid message only carries 32 bit columns
+  if (publish_voxel_ && useTallVoxelGrid()) {
+    RCLCPP_WARN(
+      node_->get_logger(),
+      "publish_voxel_map is only supported for up to %u z_voxels, not publishing the voxel map.",
+      nav2_voxel_grid::VoxelGrid::MAX_SIZE_Z);
+    publish_voxel_ = false;
+  }
+
   if (publish_voxel_) {
     voxel_pub_ = node_->create_publisher<nav2_msgs::msg::VoxelGrid>(
       "voxel_grid", custom_qos);
+    voxel_pub_->on_activate();
   }
 
-  voxel_pub_->on_activate();
-
   clearing_endpoints_pub_ = node_->create_publisher<sensor_msgs::msg::PointCloud>(
     "clearing_endpoints", custom_qos);
 
-  unknown_threshold_ += (VOXEL_BITS - size_z_);
+  // levels above size_z_ in a column stay unknown, so they must not count against the threshold
+  int column_levels = useTallVoxelGrid() ?
+    static_cast<int>(nav2_voxel_grid::VoxelGrid64::MAX_SIZE_Z) :
+    static_cast<int>(nav2_voxel_grid::VoxelGrid::MAX_SIZE_Z);
+  unknown_threshold_ += (column_levels - size_z_);
   matchSize();
 }
 
@@ -106,8 +118,11 @@ VoxelLayer::~VoxelLayer()
 void VoxelLayer::matchSize()
 {
   ObstacleLayer::matchSize();
-  voxel_grid_.resize(size_x_, size_y_, size_z_);
-  assert(voxel_grid_.sizeX() == size_x_ && voxel_grid_.sizeY() == size_y_);
+  withVoxelGrid(
+    [this](auto & grid) {
+      grid.resize(size_x_, size_y_, size_z_);
+      assert(grid.sizeX() == size_x_ && grid.sizeY() == size_y_);
+    });
 }
 
 void VoxelLayer::reset()
@@ -124,7 +139,7 @@ void VoxelLayer::resetMaps()
   // resetMaps so this goes to the next layer down Costmap2DLayer which also
   // doesn't implement this, so it actually goes all the way to Costmap2D
   ObstacleLayer::resetMaps();
-  voxel_grid_.reset();
+  withVoxelGrid([](auto & grid) {grid.reset();});
 }
 
 void VoxelLayer::updateBounds(
@@ -197,7 +212,12 @@ void VoxelLayer::updateBounds(
       }
 
       // mark the cell in the voxel grid and check if we should also mark it in the costmap
-      if (voxel_grid_.markVoxelInMap(mx, my, mz, mark_threshold_)) {
+      bool mark_in_map = false;
+      withVoxelGrid(
+        [&](auto & grid) {
+          mark_in_map = grid.markVoxelInMap(mx, my, mz, mark_threshold_);
+        });
+      if (mark_in_map) {
         unsigned int index = getIndex(mx, my);
 
         costmap_[index] = LETHAL_OBSTACLE;
@@ -275,7 +295,7 @@ void VoxelLayer::clearNonLethal(
       if (*current != LETHAL_OBSTACLE) {
         if (clear_no_info || *current != NO_INFORMATION) {
           *current = FREE_SPACE;
-          voxel_grid_.clearVoxelColumn(index);
+          withVoxelGrid([index](auto & grid) {grid.clearVoxelColumn(index);});
         }
       }
       current++;
@@ -324,6 +344,12 @@ void VoxelLayer::raytraceFreespace(
   double map_end_y = origin_y_ + getSizeInMetersY();
   double map_end_z = origin_z_ + getSizeInMetersZ();
 
+  unsigned int cell_raytrace_range = cellDistance(clearing_observation.raytrace_range_);
+
+  // the endpoints are gathered first so the lines can be cleared as one batch
+  clearing_voxel_endpoints_.clear();
+  clearing_voxel_endpoints_.reserve(3 * clearing_observation_cloud_size);
+
   sensor_msgs::PointCloud2ConstIterator<float> iter_x(*(clearing_observation.cloud_), "x");
   sensor_msgs::PointCloud2ConstIterator<float> iter_y(*(clearing_observation.cloud_), "y");
   sensor_msgs::PointCloud2ConstIterator<float> iter_z(*(clearing_observation.cloud_), "z");
@@ -377,14 +403,9 @@ void VoxelLayer::raytraceFreespace(
 
     double point_x, point_y, point_z;
     if (worldToMap3DFloat(wpx, wpy, wpz, point_x, point_y, point_z)) {
-      unsigned int cell_raytrace_range = cellDistance(clearing_observation.raytrace_range_);
-
-      // voxel_grid_.markVoxelLine(sensor_x, sensor_y, sensor_z, point_x, point_y, point_z);
-      voxel_grid_.clearVoxelLineInMap(
-        sensor_x, sensor_y, sensor_z, point_x, point_y, point_z,
-        costmap_,
-        unknown_threshold_, mark_threshold_, FREE_SPACE, NO_INFORMATION,
-        cell_raytrace_range);
+      clearing_voxel_endpoints_.push_back(point_x);
+      clearing_voxel_endpoints_.push_back(point_y);
+      clearing_voxel_endpoints_.push_back(point_z);
 
       updateRaytraceBounds(
         ox, oy, wpx, wpy, clearing_observation.raytrace_range_, min_x, min_y,
@@ -401,6 +422,15 @@ void VoxelLayer::raytraceFreespace(
     }
   }
 
+  withVoxelGrid(
+    [&](auto & grid) {
+      grid.clearVoxelLinesInMap(
+        sensor_x, sensor_y, sensor_z, clearing_voxel_endpoints_,
+        costmap_,
+        unknown_threshold_, mark_threshold_, FREE_SPACE, NO_INFORMATION,
+        cell_raytrace_range, raytrace_threads_);
+    });
+
   if (publish_clearing_points) {
     clearing_endpoints_->header.frame_id = global_frame_;
     clearing_endpoints_->header.stamp = clearing_observation.cloud_->header.stamp;
@@ -436,44 +466,49 @@ void VoxelLayer::updateOrigin(double new_origin_x, double new_origin_y)
   unsigned int cell_size_x = upper_right_x - lower_left_x;
   unsigned int cell_size_y = upper_right_y - lower_left_y;
 
-  // we need a map to store the obstacles in the window temporarily
-  unsigned char * local_map = new unsigned char[cell_size_x * cell_size_y];
-  unsigned int * local_voxel_map = new unsigned int[cell_size_x * cell_size_y];
-  unsigned int * voxel_map = voxel_grid_.getData();
-
-  // copy the local window in the costmap to the local map
-  copyMapRegion(
-    costmap_, lower_left_x, lower_left_y, size_x_, local_map, 0, 0, cell_size_x,
-    cell_size_x,
-    cell_size_y);
-  copyMapRegion(
-    voxel_map, lower_left_x, lower_left_y, size_x_, local_voxel_map, 0, 0, cell_size_x,
-    cell_size_x,
-    cell_size_y);
-
-  // we'll reset our maps to unknown space if appropriate
-  resetMaps();
-
-  // update the origin with the appropriate world coordinates
-  origin_x_ = new_grid_ox;
-  origin_y_ = new_grid_oy;
-
-  // compute the starting cell location for copying data back in
-  int start_x = lower_left_x - cell_ox;
-  int start_y = lower_left_y - cell_oy;
-
-  // now we want to copy the overlapping information back into the map, but in its new location
-  copyMapRegion(
-    local_map, 0, 0, cell_size_x, costmap_, start_x, start_y, size_x_, cell_size_x,
-    cell_size_y);
-  copyMapRegion(
-    local_voxel_map, 0, 0, cell_size_x, voxel_map, start_x, start_y, size_x_,
-    cell_size_x,
-    cell_size_y);
-
-  // make sure to clean up
-  delete[] local_map;
-  delete[] local_voxel_map;
+  withVoxelGrid(
+    [&](auto & grid) {
+      using ColumnT = typename std::remove_pointer<decltype(grid.getData())>::type;
+
+      // we need a map to store the obstacles in the window temporarily
+      unsigned char * local_map = new unsigned char[cell_size_x * cell_size_y];
+      ColumnT * local_voxel_map = new ColumnT[cell_size_x * cell_size_y];
+      ColumnT * voxel_map = grid.getData();
+
+      // copy the local window in the costmap to the local map
+      copyMapRegion(
+        costmap_, lower_left_x, lower_left_y, size_x_, local_map, 0, 0, cell_size_x,
+        cell_size_x,
+        cell_size_y);
+      copyMapRegion(
+        voxel_map, lower_left_x, lower_left_y, size_x_, local_voxel_map, 0, 0, cell_size_x,
+        cell_size_x,
+        cell_size_y);
+
+      // we'll reset our maps to unknown space if appropriate
+      resetMaps();
+
+      // update the origin with the appropriate world coordinates
+      origin_x_ = new_grid_ox;
+      origin_y_ = new_grid_oy;
+
+      // compute the starting cell location for copying data back in
+      int start_x = lower_left_x - cell_ox;
+      int start_y = lower_left_y - cell_oy;
+
+      // now we want to copy the overlapping information back into the map, in its new location
+      copyMapRegion(
+        local_map, 0, 0, cell_size_x, costmap_, start_x, start_y, size_x_, cell_size_x,
+        cell_size_y);
+      copyMapRegion(
+        local_voxel_map, 0, 0, cell_size_x, voxel_map, start_x, start_y, size_x_,
+        cell_size_x,
+        cell_size_y);
+
+      // make sure to clean up
+      delete[] local_map;
+      delete[] local_voxel_map;
+    });
 }
 
 }  // namespace nav2_costmap_2d
@@ -335,6 +335,7 @@ bool Costmap2D::setConvexPolygonCost(
   // we assume the polygon is given in the global_frame...
   // we need to transform it to map coordinates
   std::vector<MapLocation> map_polygon;
+  map_polygon.reserve(polygon.size());
   for (unsigned int i = 0; i < polygon.size(); ++i) {
     MapLocation loc;
     if (!worldToMap(polygon[i].x, polygon[i].y, loc.x, loc.y)) {
@@ -344,16 +345,8 @@ bool Costmap2D::setConvexPolygonCost(
     map_polygon.push_back(loc);
   }
 
-  std::vector<MapLocation> polygon_cells;
-
-  // get the cells that fill the polygon
-  convexFillCells(map_polygon, polygon_cells);
-
-  // set the cost of those cells
-  for (unsigned int i = 0; i < polygon_cells.size(); ++i) {
-    unsigned int index = getIndex(polygon_cells[i].x, polygon_cells[i].y);
-    costmap_[index] = cost_value;
-  }
+  // set the cost of the cells that fill the polygon, a row span at a time
+  rasterizePolygon(MarkSpan(costmap_, size_x_, cost_value), map_polygon);
   return true;
 }
 
@@ -378,69 +371,90 @@ void Costmap2D::convexFillCells(
   const std::vector<MapLocation> & polygon,
   std::vector<MapLocation> & polygon_cells)
 {
-  // we need a minimum polygon of a triangle
-  if (polygon.size() < 3) {
-    return;
-  }
-
-  // first get the cells that make up the outline of the polygon
-  polygonOutlineCells(polygon, polygon_cells);
+  rasterizePolygon(
+    [&polygon_cells](unsigned int y, unsigned int x_begin, unsigned int x_end) {
+      for (unsigned int x = x_begin; x < x_end; ++x) {
+        polygon_cells.push_back({x, y});
+      }
+    }, polygon);
+}
 
-  // quick bubble sort to sort points by x
-  MapLocation swap;
-  unsigned int i = 0;
-  while (i < polygon_cells.size() - 1) {
-    if (polygon_cells[i].x > polygon_cells[i + 1].x) {
-      swap = polygon_cells[i];
-      polygon_cells[i] = polygon_cells[i + 1];
-      polygon_cells[i + 1] = swap;
+unsigned int Costmap2D::polygonRowSpans(
+  const std::vector<MapLocation> & polygon, unsigned int y,
+  MapSpan * spans, double * crossings) const
+{
+  const unsigned int num_vertices = polygon.size();
+  const int row = y;
+  unsigned int num_spans = 0;
+  unsigned int num_crossings = 0;
 
-      if (i > 0) {
-        --i;
-      }
-    } else {
-      ++i;
+  for (unsigned int i = 0; i < num_vertices; ++i) {
+    const int ax = polygon[i].x;
+    const int ay = polygon[i].y;
+    const int bx = polygon[(i + 1) % num_vertices].x;
+    const int by = polygon[(i + 1) % num_vertices].y;
+    if (row < std::min(ay, by) || row > std::max(ay, by)) {
+      continue;
     }
-  }
-
-  i = 0;
-  MapLocation min_pt;
-  MapLocation max_pt;
-  unsigned int min_x = polygon_cells[0].x;
-  unsigned int max_x = polygon_cells[polygon_cells.size() - 1].x;
+    const int dx = bx - ax;
+    const int dy = by - ay;
 
-  // walk through each column and mark cells inside the polygon
-  for (unsigned int x = min_x; x <= max_x; ++x) {
-    if (i >= polygon_cells.size() - 1) {
-      break;
+    // Where the edge crosses the row through the cell centers; an edge ending on
+    // the row only counts at its lower end, so vertices are not counted twice
+    if (row < std::max(ay, by) && dy != 0) {
+      crossings[num_crossings++] = ax + static_cast<double>(row - ay) * dx / dy;
     }
 
-    if (polygon_cells[i].y < polygon_cells[i + 1].y) {
-      min_pt = polygon_cells[i];
-      max_pt = polygon_cells[i + 1];
+    // Outline cells of the edge in this row: the steps of raytraceLine() from a to b
+    // that land on it, found in closed form from its integer error term
+    const int abs_dx = abs(dx);
+    const int abs_dy = abs(dy);
+    const int steps_y = abs(row - ay);
+    int x0, x1;
+    if (abs_dx >= abs_dy) {
+      // x dominant: step k moves to row ay + (abs_dx / 2 + k * abs_dy) / abs_dx
+      const int error = abs_dx / 2;
+      int k0 = 0;
+      int k1 = abs_dx;
+      if (abs_dy > 0) {
+        k0 = steps_y == 0 ? 0 : (steps_y * abs_dx - error + abs_dy - 1) / abs_dy;
+        k1 = std::min(abs_dx, ((steps_y + 1) * abs_dx - error - 1) / abs_dy);
+      }
+      x0 = dx >= 0 ? ax + k0 : ax - k1;
+      x1 = dx >= 0 ? ax + k1 : ax - k0;
     } else {
-      min_pt = polygon_cells[i + 1];
-      max_pt = polygon_cells[i];
+      // y dominant: exactly one step lands on each row
+      const int steps_x = (abs_dy / 2 + steps_y * abs_dx) / abs_dy;
+      x0 = x1 = dx >= 0 ? ax + steps_x : ax - steps_x;
+    }
+    if (x0 <= x1) {
+      spans[num_spans++] = {static_cast<unsigned int>(x0), static_cast<unsigned int>(x1) + 1};
     }
+  }
 
-    i += 2;
-    while (i < polygon_cells.size() && polygon_cells[i].x == x) {
-      if (polygon_cells[i].y < min_pt.y) {
-        min_pt = polygon_cells[i];
-      } else if (polygon_cells[i].y > max_pt.y) {
-        max_pt = polygon_cells[i];
-      }
-      ++i;
+  // Cells whose center lies between pairs of crossings are inside
+  std::sort(crossings, crossings + num_crossings);
+  for (unsigned int i = 0; i + 1 < num_crossings; i += 2) {
+    int x0 = static_cast<int>(std::ceil(crossings[i]));
+    int x1 = static_cast<int>(std::floor(crossings[i + 1]));
+    if (x0 <= x1) {
+      spans[num_spans++] = {static_cast<unsigned int>(x0), static_cast<unsigned int>(x1) + 1};
     }
+  }
 
-    MapLocation pt;
-    // loop though cells in the column
-    for (unsigned int y = min_pt.y; y < max_pt.y; ++y) {
-      pt.x = x;
-      pt.y = y;
-      polygon_cells.push_back(pt);
+  // Merge overlapping or touching spans
+  std::sort(
+    spans, spans + num_spans,
+    [](const MapSpan & a, const MapSpan & b) {return a.begin < b.begin;});
+  unsigned int num_merged = 0;
+  for (unsigned int i = 0; i < num_spans; ++i) {
+    if (num_merged > 0 && spans[i].begin <= spans[num_merged - 1].end) {
+      spans[num_merged - 1].end = std::max(spans[num_merged - 1].end, spans[i].end);
+    } else {
+      spans[num_merged++] = spans[i];
     }
   }
+  return num_merged;
 }
 
 unsigned int Costmap2D::getSizeInCellsX() const
@@ -0,0 +1,151 @@
+// Copyright (c) 2020 Navigation2 contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runs the cycles of a costmap recording through an in-process costmap as fast as
+// possible, then reports the update times per plugin and whether every cycle
+// produced the same grid as when it was recorded.
+//
+//   ros2 run nav2_costmap_2d nav2_costmap_2d_replay <recording> [costmap name]
+//     --ros-args --params-file <costmap parameters>
+//
+// The costmap must be configured with the same layers as the recorded one.
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "nav2_costmap_2d/costmap_2d_ros.hpp"
+#include "nav2_costmap_2d/costmap_recording.hpp"
+#include "nav2_costmap_2d/layered_costmap.hpp"
+#include "nav2_util/execution_timer.hpp"
+#include "rclcpp/rclcpp.hpp"
+
+int main(int argc, char ** argv)
+{
+  rclcpp::init(argc, argv);
+  std::vector<std::string> args = rclcpp::remove_ros_arguments(argc, argv);
+  if (args.size() < 2) {
+    fprintf(
+      stderr, "Usage: %s <recording> [costmap name] --ros-args --params-file <params>\n",
+      args[0].c_str());
+    rclcpp::shutdown();
+    return 2;
+  }
+
+  std::unique_ptr<nav2_costmap_2d::CostmapReplay> replay;
+  try {
+    replay = std::make_unique<nav2_costmap_2d::CostmapReplay>(args[1]);
+  } catch (std::runtime_error & e) {
+    fprintf(stderr, "%s\n", e.what());
+    rclcpp::shutdown();
+    return 1;
+  }
+
+  // Configuring loads the layers; the costmap is never activated, so it neither
+  // waits for transforms nor runs its own update loop. The parameters of the
+  // recorded costmap usually set record_file, which must not be overwritten by
+  // recording the replay, possibly into the very file being read.
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+    args.size() > 2 ? args[2] : "costmap");
+  costmap_ros->set_parameter(rclcpp::Parameter("record_file", std::string("")));
+  costmap_ros->configure();
+  nav2_costmap_2d::LayeredCostmap * layered_costmap = costmap_ros->getLayeredCostmap();
+
+  const uint32_t flags = replay->getHeader().flags;
+  if (layered_costmap->isRolling() !=
+    static_cast<bool>(flags & nav2_costmap_2d::RECORDING_ROLLING_WINDOW) ||
+    layered_costmap->isTrackingUnknown() !=
+    static_cast<bool>(flags & nav2_costmap_2d::RECORDING_TRACK_UNKNOWN))
+  {
+    fprintf(
+      stderr, "Warning: rolling_window or track_unknown_space differ from the recording\n");
+  }
+
+  layered_costmap->enablePluginTimings(true);
+
+  nav2_costmap_2d::CostmapCycle cycle;
+  nav2_util::ExecutionTimer timer;
+  unsigned int cycles = 0, mismatches = 0;
+  double total_time = 0.0, max_time = 0.0;
+  uint64_t checksum = 0;
+  int result = 0;
+
+  try {
+    while (replay->readCycle(cycle)) {
+      if (cycle.has_footprint) {
+        layered_costmap->setFootprint(cycle.footprint);
+      }
+
+      layered_costmap->setReplayCycle(&cycle);
+      timer.start();
+      layered_costmap->updateMap(cycle.robot_x, cycle.robot_y, cycle.robot_yaw);
+      timer.end();
+      layered_costmap->setReplayCycle(nullptr);
+
+      const double time = timer.elapsed_time_in_seconds();
+      total_time += time;
+      max_time = std::max(max_time, time);
+
+      const nav2_costmap_2d::Costmap2D & costmap = *layered_costmap->getCostmap();
+      checksum = nav2_costmap_2d::costmapChecksum(costmap);
+      if (checksum != cycle.checksum ||
+        costmap.getSizeInCellsX() != cycle.size_x || costmap.getSizeInCellsY() != cycle.size_y ||
+        costmap.getOriginX() != cycle.origin_x || costmap.getOriginY() != cycle.origin_y)
+      {
+        if (mismatches == 0) {
+          fprintf(stderr, "Cycle %u: costmap differs from the recording\n", cycles);
+        }
+        mismatches++;
+      }
+      cycles++;
+    }
+  } catch (std::runtime_error & e) {
+    fprintf(stderr, "Cycle %u: %s\n", cycles, e.what());
+    result = 1;
+  }
+
+  printf("Replayed %u cycles in %.6f s", cycles, total_time);
+  if (cycles > 0) {
+    printf(", %.6f s per cycle, %.6f s at most", total_time / cycles, max_time);
+  }
+  printf("\n");
+
+  const auto & plugins = *layered_costmap->getPlugins();
+  const auto & timings = layered_costmap->getPluginTimings();
+  for (size_t i = 0; i < plugins.size() && i < timings.size() && cycles > 0; ++i) {
+    printf(
+      "  %-24s updateBounds %.6f s  updateCosts %.6f s per cycle\n",
+      plugins[i]->getName().c_str(),
+      timings[i].update_bounds_time / cycles, timings[i].update_costs_time / cycles);
+  }
+
+  printf("Final costmap checksum %016" PRIx64 "\n", checksum);
+  if (cycles == 0) {
+    printf("The recording has no complete cycles\n");
+    result = 1;
+  } else if (mismatches > 0) {
+    printf("%u of %u cycles differ from the recording\n", mismatches, cycles);
+    result = 1;
+  } else {
+    printf("All cycles match the recording\n");
+  }
+
+  costmap_ros->cleanup();
+  rclcpp::shutdown();
+  return result;
+}
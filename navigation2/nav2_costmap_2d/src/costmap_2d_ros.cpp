@@ -101,6 +101,8 @@ Costmap2DROS::Costmap2DROS(
   declare_parameter("origin_y", rclcpp::ParameterValue(0.0));
   declare_parameter("plugins", rclcpp::ParameterValue(default_plugins_));
   declare_parameter("publish_frequency", rclcpp::ParameterValue(1.0));
+  declare_parameter("pyramid_levels", rclcpp::ParameterValue(0));
+  declare_parameter("record_file", rclcpp::ParameterValue(std::string("")));
   declare_parameter("resolution", rclcpp::ParameterValue(0.1));
   declare_parameter("robot_base_frame", rclcpp::ParameterValue(std::string("base_link")));
   declare_parameter("robot_radius", rclcpp::ParameterValue(0.1));
@@ -128,6 +130,21 @@ Costmap2DROS::on_configure(const rclcpp_lifecycle::State & /*state*/)
   // Create the costmap itself
   layered_costmap_ = new LayeredCostmap(global_frame_, rolling_window_, track_unknown_space_);
 
+  if (pyramid_levels_ > 0) {
+    layered_costmap_->enablePyramid(pyramid_levels_);
+  }
+
+  if (!record_file_.empty()) {
+    try {
+      layered_costmap_->setRecorder(
+        std::make_shared<CostmapRecorder>(
+          record_file_, rolling_window_, track_unknown_space_));
+      RCLCPP_INFO(get_logger(), "Recording costmap updates to %s", record_file_.c_str());
+    } catch (std::runtime_error & e) {
+      RCLCPP_ERROR(get_logger(), "Not recording costmap updates: %s", e.what());
+    }
+  }
+
   if (!layered_costmap_->isSizeLocked()) {
     layered_costmap_->resizeMap(
       (unsigned int)(map_width_meters_ / resolution_),
@@ -295,6 +312,8 @@ Costmap2DROS::getParameters()
   get_parameter("origin_x", origin_x_);
   get_parameter("origin_y", origin_y_);
   get_parameter("publish_frequency", map_publish_frequency_);
+  get_parameter("pyramid_levels", pyramid_levels_);
+  get_parameter("record_file", record_file_);
   get_parameter("resolution", resolution_);
   get_parameter("robot_base_frame", robot_base_frame_);
   get_parameter("robot_radius", robot_radius_);
@@ -519,7 +538,14 @@ void
 Costmap2DROS::resetLayers()
 {
   Costmap2D * top = layered_costmap_->getCostmap();
-  top->resetMap(0, 0, top->getSizeInCellsX(), top->getSizeInCellsY());
+  {
+    // The pyramid is read and updated under the master costmap lock
+    std::unique_lock<Costmap2D::mutex_t> lock(*(top->getMutex()));
+    top->resetMap(0, 0, top->getSizeInCellsX(), top->getSizeInCellsY());
+    if (layered_costmap_->getPyramid()) {
+      layered_costmap_->getPyramid()->invalidate();
+    }
+  }
 
   // Reset each of the plugins
   std::vector<std::shared_ptr<Layer>> * plugins = layered_costmap_->getPlugins();
@@ -0,0 +1,133 @@
+// Copyright (c) 2020 Navigation2 contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nav2_costmap_2d/costmap_pyramid.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+
+namespace nav2_costmap_2d
+{
+
+CostmapPyramid::CostmapPyramid(unsigned int num_levels)
+: need_full_update_(true),
+  size_x_(0),
+  size_y_(0),
+  resolution_(0),
+  origin_x_(0),
+  origin_y_(0)
+{
+  for (unsigned int i = 0; i < num_levels; i++) {
+    levels_.push_back(std::make_unique<Costmap2D>());
+  }
+}
+
+Costmap2D * CostmapPyramid::getLevel(unsigned int level)
+{
+  if (level == 0 || level > levels_.size()) {
+    return nullptr;
+  }
+  return levels_[level - 1].get();
+}
+
+Costmap2D * CostmapPyramid::getLevelForFactor(unsigned int factor)
+{
+  unsigned int level = 0;
+  while (factor > 1 && factor % 2 == 0) {
+    factor /= 2;
+    level++;
+  }
+  return factor == 1 ? getLevel(level) : nullptr;
+}
+
+void CostmapPyramid::update(
+  const Costmap2D & costmap, unsigned int x0, unsigned int y0,
+  unsigned int xn, unsigned int yn)
+{
+  if (costmap.getSizeInCellsX() != size_x_ || costmap.getSizeInCellsY() != size_y_ ||
+    costmap.getResolution() != resolution_ || costmap.getOriginX() != origin_x_ ||
+    costmap.getOriginY() != origin_y_)
+  {
+    size_x_ = costmap.getSizeInCellsX();
+    size_y_ = costmap.getSizeInCellsY();
+    resolution_ = costmap.getResolution();
+    origin_x_ = costmap.getOriginX();
+    origin_y_ = costmap.getOriginY();
+
+    unsigned int size_x = size_x_, size_y = size_y_;
+    double resolution = resolution_;
+    for (auto & level : levels_) {
+      size_x = (size_x + 1) / 2;
+      size_y = (size_y + 1) / 2;
+      resolution *= 2;
+      std::unique_lock<Costmap2D::mutex_t> lock(*(level->getMutex()));
+      level->resizeMap(size_x, size_y, resolution, origin_x_, origin_y_);
+    }
+    need_full_update_ = true;
+  }
+
+  if (need_full_update_) {
+    x0 = y0 = 0;
+    xn = size_x_;
+    yn = size_y_;
+    need_full_update_ = false;
+  }
+
+  xn = std::min(xn, size_x_);
+  yn = std::min(yn, size_y_);
+
+  // Each level only changes over the cells covering the window of the finer one
+  const Costmap2D * fine = &costmap;
+  for (auto & level : levels_) {
+    if (x0 >= xn || y0 >= yn) {
+      return;
+    }
+    x0 /= 2;
+    y0 /= 2;
+    xn = (xn + 1) / 2;
+    yn = (yn + 1) / 2;
+
+    std::unique_lock<Costmap2D::mutex_t> lock(*(level->getMutex()));
+    poolLevel(*fine, *level, x0, y0, xn, yn);
+    fine = level.get();
+  }
+}
+
+void CostmapPyramid::poolLevel(
+  const Costmap2D & fine, Costmap2D & coarse,
+  unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn)
+{
+  const unsigned int fine_size_x = fine.getSizeInCellsX();
+  const unsigned int fine_size_y = fine.getSizeInCellsY();
+  const unsigned int coarse_size_x = coarse.getSizeInCellsX();
+  const unsigned char * fine_array = fine.getCharMap();
+  unsigned char * coarse_array = coarse.getCharMap();
+
+  for (unsigned int j = y0; j < yn; j++) {
+    // On an odd sized costmap the last coarse row and column cover a single fine one
+    const unsigned char * row0 = fine_array + 2 * j * fine_size_x;
+    const unsigned char * row1 = 2 * j + 1 < fine_size_y ? row0 + fine_size_x : row0;
+    unsigned char * out = coarse_array + j * coarse_size_x;
+    for (unsigned int i = x0; i < xn; i++) {
+      const unsigned int fx0 = 2 * i;
+      const unsigned int fx1 = fx0 + 1 < fine_size_x ? fx0 + 1 : fx0;
+      out[i] = std::max(
+        std::max(row0[fx0], row0[fx1]),
+        std::max(row1[fx0], row1[fx1]));
+    }
+  }
+}
+
+}  // namespace nav2_costmap_2d
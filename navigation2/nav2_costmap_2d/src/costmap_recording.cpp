@@ -0,0 +1,441 @@
+// Copyright (c) 2020 Navigation2 contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nav2_costmap_2d/costmap_recording.hpp"
+
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "sensor_msgs/point_cloud2_iterator.hpp"
+
+namespace nav2_costmap_2d
+{
+
+static const char RECORDING_MAGIC[4] = {'N', '2', 'C', 'R'};
+
+namespace
+{
+
+// Appends plain values to a record
+class RecordEncoder
+{
+public:
+  explicit RecordEncoder(std::vector<unsigned char> & data)
+  : data_(data)
+  {
+    data_.clear();
+  }
+
+  template<typename T>
+  void put(const T & value)
+  {
+    putBytes(&value, sizeof(T));
+  }
+
+  void putBytes(const void * bytes, size_t size)
+  {
+    const unsigned char * begin = static_cast<const unsigned char *>(bytes);
+    data_.insert(data_.end(), begin, begin + size);
+  }
+
+  void putString(const std::string & value)
+  {
+    put<uint32_t>(value.size());
+    putBytes(value.data(), value.size());
+  }
+
+private:
+  std::vector<unsigned char> & data_;
+};
+
+// Reads plain values back from a record, refusing to run past its end
+class RecordDecoder
+{
+public:
+  explicit RecordDecoder(const std::vector<unsigned char> & data)
+  : data_(data), offset_(0)
+  {
+  }
+
+  template<typename T>
+  T get()
+  {
+    T value;
+    getBytes(&value, sizeof(T));
+    return value;
+  }
+
+  void getBytes(void * bytes, size_t size)
+  {
+    if (size > data_.size() - offset_) {
+      throw std::runtime_error("Costmap recording: truncated record");
+    }
+    memcpy(bytes, data_.data() + offset_, size);
+    offset_ += size;
+  }
+
+  /// Read a count of elements, checking that the record holds that many
+  template<typename T>
+  T getCount(size_t element_size)
+  {
+    T count = get<T>();
+    if (count > (data_.size() - offset_) / element_size) {
+      throw std::runtime_error("Costmap recording: truncated record");
+    }
+    return count;
+  }
+
+  std::string getString()
+  {
+    std::string value(getCount<uint32_t>(1), '\0');
+    getBytes(&value[0], value.size());
+    return value;
+  }
+
+private:
+  const std::vector<unsigned char> & data_;
+  size_t offset_;
+};
+
+void encodePoint(RecordEncoder & encoder, const geometry_msgs::msg::Point & point)
+{
+  encoder.put(point.x);
+  encoder.put(point.y);
+  encoder.put(point.z);
+}
+
+geometry_msgs::msg::Point decodePoint(RecordDecoder & decoder)
+{
+  geometry_msgs::msg::Point point;
+  point.x = decoder.get<double>();
+  point.y = decoder.get<double>();
+  point.z = decoder.get<double>();
+  return point;
+}
+
+}  // namespace
+
+bool CostmapCycle::getObservations(
+  const std::string & layer, CostmapRecordType type,
+  std::vector<Observation> & observations) const
+{
+  bool found = false;
+  for (const CostmapRecord & record : records) {
+    if (record.type != type || record.layer != layer) {
+      continue;
+    }
+    found = true;
+
+    // Only the coordinates of the points are kept; layers read nothing else
+    RecordDecoder decoder(record.data);
+    // An observation takes at least its origin, ranges and point count
+    uint32_t count = decoder.getCount<uint32_t>(6 * sizeof(double) + sizeof(uint32_t));
+    for (uint32_t i = 0; i < count; ++i) {
+      geometry_msgs::msg::Point origin = decodePoint(decoder);
+      double obstacle_range = decoder.get<double>();
+      double raytrace_range = decoder.get<double>();
+      uint32_t num_points = decoder.getCount<uint32_t>(3 * sizeof(float));
+
+      sensor_msgs::msg::PointCloud2 cloud;
+      sensor_msgs::PointCloud2Modifier modifier(cloud);
+      modifier.setPointCloud2FieldsByString(1, "xyz");
+      modifier.resize(num_points);
+      sensor_msgs::PointCloud2Iterator<float> iter_x(cloud, "x");
+      sensor_msgs::PointCloud2Iterator<float> iter_y(cloud, "y");
+      sensor_msgs::PointCloud2Iterator<float> iter_z(cloud, "z");
+      for (uint32_t j = 0; j < num_points; ++j, ++iter_x, ++iter_y, ++iter_z) {
+        *iter_x = decoder.get<float>();
+        *iter_y = decoder.get<float>();
+        *iter_z = decoder.get<float>();
+      }
+      observations.emplace_back(origin, cloud, obstacle_range, raytrace_range);
+    }
+  }
+  return found;
+}
+
+CostmapRecorder::CostmapRecorder(
+  const std::string & file_name, bool rolling_window, bool track_unknown)
+: file_(file_name, std::ios::binary | std::ios::trunc)
+{
+  if (!file_) {
+    throw std::runtime_error("Costmap recording: can not write " + file_name);
+  }
+
+  CostmapRecordingHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+  header.version = COSTMAP_RECORDING_VERSION;
+  header.flags = (rolling_window ? RECORDING_ROLLING_WINDOW : 0) |
+    (track_unknown ? RECORDING_TRACK_UNKNOWN : 0);
+  file_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+void CostmapRecorder::beginCycle(double robot_x, double robot_y, double robot_yaw)
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+  RecordEncoder encoder(buffer_);
+  encoder.put(robot_x);
+  encoder.put(robot_y);
+  encoder.put(robot_yaw);
+  writeRecord(RECORD_CYCLE_BEGIN, "", buffer_);
+}
+
+void CostmapRecorder::endCycle(const Costmap2D & costmap)
+{
+  uint64_t checksum = costmapChecksum(costmap);
+
+  std::lock_guard<std::mutex> guard(mutex_);
+  RecordEncoder encoder(buffer_);
+  encoder.put<uint32_t>(costmap.getSizeInCellsX());
+  encoder.put<uint32_t>(costmap.getSizeInCellsY());
+  encoder.put(costmap.getResolution());
+  encoder.put(costmap.getOriginX());
+  encoder.put(costmap.getOriginY());
+  encoder.put(checksum);
+  writeRecord(RECORD_CYCLE_END, "", buffer_);
+  file_.flush();
+}
+
+void CostmapRecorder::writeFootprint(const std::vector<geometry_msgs::msg::Point> & footprint)
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+  RecordEncoder encoder(buffer_);
+  encoder.put<uint32_t>(footprint.size());
+  for (const auto & point : footprint) {
+    encodePoint(encoder, point);
+  }
+  writeRecord(RECORD_FOOTPRINT, "", buffer_);
+}
+
+void CostmapRecorder::writeObservations(
+  const std::string & layer, CostmapRecordType type,
+  const std::vector<Observation> & observations)
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+  RecordEncoder encoder(buffer_);
+  encoder.put<uint32_t>(observations.size());
+  for (const Observation & observation : observations) {
+    encodePoint(encoder, observation.origin_);
+    encoder.put(observation.obstacle_range_);
+    encoder.put(observation.raytrace_range_);
+
+    const sensor_msgs::msg::PointCloud2 & cloud = *(observation.cloud_);
+    const size_t count_offset = buffer_.size();
+    uint32_t num_points = 0;
+    encoder.put(num_points);
+    sensor_msgs::PointCloud2ConstIterator<float> iter_x(cloud, "x");
+    sensor_msgs::PointCloud2ConstIterator<float> iter_y(cloud, "y");
+    sensor_msgs::PointCloud2ConstIterator<float> iter_z(cloud, "z");
+    for (; iter_x != iter_x.end(); ++iter_x, ++iter_y, ++iter_z, ++num_points) {
+      encoder.put(*iter_x);
+      encoder.put(*iter_y);
+      encoder.put(*iter_z);
+    }
+    memcpy(&buffer_[count_offset], &num_points, sizeof(num_points));
+  }
+  writeRecord(type, layer, buffer_);
+}
+
+void CostmapRecorder::writeMap(
+  const std::string & layer, const nav_msgs::msg::OccupancyGrid & map)
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+  RecordEncoder encoder(buffer_);
+  encoder.putString(map.header.frame_id);
+  encoder.put(map.header.stamp.sec);
+  encoder.put(map.header.stamp.nanosec);
+  encoder.put(map.info.resolution);
+  encoder.put(map.info.width);
+  encoder.put(map.info.height);
+  encodePoint(encoder, map.info.origin.position);
+  encoder.put(map.info.origin.orientation.x);
+  encoder.put(map.info.origin.orientation.y);
+  encoder.put(map.info.origin.orientation.z);
+  encoder.put(map.info.origin.orientation.w);
+  encoder.put<uint64_t>(map.data.size());
+  encoder.putBytes(map.data.data(), map.data.size());
+  writeRecord(RECORD_MAP, layer, buffer_);
+}
+
+void CostmapRecorder::writeMapUpdate(
+  const std::string & layer, const map_msgs::msg::OccupancyGridUpdate & update)
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+  RecordEncoder encoder(buffer_);
+  encoder.putString(update.header.frame_id);
+  encoder.put(update.header.stamp.sec);
+  encoder.put(update.header.stamp.nanosec);
+  encoder.put(update.x);
+  encoder.put(update.y);
+  encoder.put(update.width);
+  encoder.put(update.height);
+  encoder.put<uint64_t>(update.data.size());
+  encoder.putBytes(update.data.data(), update.data.size());
+  writeRecord(RECORD_MAP_UPDATE, layer, buffer_);
+}
+
+void CostmapRecorder::writeRecord(
+  CostmapRecordType type, const std::string & layer, const std::vector<unsigned char> & data)
+{
+  CostmapRecordHeader header;
+  header.type = type;
+  header.name_size = layer.size();
+  header.data_size = data.size();
+  file_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file_.write(layer.data(), layer.size());
+  file_.write(reinterpret_cast<const char *>(data.data()), data.size());
+}
+
+CostmapReplay::CostmapReplay(const std::string & file_name)
+: file_(file_name, std::ios::binary)
+{
+  if (!file_) {
+    throw std::runtime_error("Costmap recording: can not read " + file_name);
+  }
+  file_.seekg(0, std::ios::end);
+  file_size_ = file_.tellg();
+  file_.seekg(0, std::ios::beg);
+  if (!file_.read(reinterpret_cast<char *>(&header_), sizeof(header_)) ||
+    memcmp(header_.magic, RECORDING_MAGIC, sizeof(header_.magic)) != 0)
+  {
+    throw std::runtime_error("Costmap recording: " + file_name + " is not a costmap recording");
+  }
+  if (header_.version != COSTMAP_RECORDING_VERSION) {
+    throw std::runtime_error(
+            "Costmap recording: unsupported version " + std::to_string(header_.version));
+  }
+}
+
+bool CostmapReplay::readCycle(CostmapCycle & cycle)
+{
+  cycle = CostmapCycle();
+  bool begun = false;
+  CostmapRecord record;
+  while (readRecord(record)) {
+    RecordDecoder decoder(record.data);
+    switch (record.type) {
+      case RECORD_CYCLE_BEGIN:
+        if (begun) {
+          throw std::runtime_error("Costmap recording: cycle begins twice");
+        }
+        begun = true;
+        cycle.robot_x = decoder.get<double>();
+        cycle.robot_y = decoder.get<double>();
+        cycle.robot_yaw = decoder.get<double>();
+        break;
+      case RECORD_CYCLE_END:
+        if (!begun) {
+          throw std::runtime_error("Costmap recording: cycle ends before it begins");
+        }
+        cycle.size_x = decoder.get<uint32_t>();
+        cycle.size_y = decoder.get<uint32_t>();
+        cycle.resolution = decoder.get<double>();
+        cycle.origin_x = decoder.get<double>();
+        cycle.origin_y = decoder.get<double>();
+        cycle.checksum = decoder.get<uint64_t>();
+        return true;
+      case RECORD_FOOTPRINT:
+        {
+          cycle.has_footprint = true;
+          cycle.footprint.resize(decoder.getCount<uint32_t>(3 * sizeof(double)));
+          for (auto & point : cycle.footprint) {
+            point = decodePoint(decoder);
+          }
+          break;
+        }
+      case RECORD_MARKING_OBSERVATIONS:
+      case RECORD_CLEARING_OBSERVATIONS:
+      case RECORD_MAP:
+      case RECORD_MAP_UPDATE:
+        cycle.records.push_back(std::move(record));
+        break;
+      default:
+        throw std::runtime_error(
+                "Costmap recording: unknown record type " + std::to_string(record.type));
+    }
+  }
+  return false;
+}
+
+bool CostmapReplay::readRecord(CostmapRecord & record)
+{
+  CostmapRecordHeader header;
+  if (!file_.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+    return false;
+  }
+  // A cut short record ends the recording like a missing one
+  const uint64_t remaining = file_size_ - static_cast<uint64_t>(file_.tellg());
+  if (header.name_size > remaining || header.data_size > remaining - header.name_size) {
+    return false;
+  }
+  record.type = static_cast<CostmapRecordType>(header.type);
+  record.layer.resize(header.name_size);
+  record.data.resize(header.data_size);
+  file_.read(&record.layer[0], header.name_size);
+  file_.read(reinterpret_cast<char *>(record.data.data()), header.data_size);
+  return static_cast<bool>(file_);
+}
+
+uint64_t costmapChecksum(const Costmap2D & costmap)
+{
+  const unsigned char * costs = costmap.getCharMap();
+  const size_t size = static_cast<size_t>(costmap.getSizeInCellsX()) * costmap.getSizeInCellsY();
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ costs[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+nav_msgs::msg::OccupancyGrid::SharedPtr decodeMap(const CostmapRecord & record)
+{
+  auto map = std::make_shared<nav_msgs::msg::OccupancyGrid>();
+  RecordDecoder decoder(record.data);
+  map->header.frame_id = decoder.getString();
+  map->header.stamp.sec = decoder.get<int32_t>();
+  map->header.stamp.nanosec = decoder.get<uint32_t>();
+  map->info.resolution = decoder.get<float>();
+  map->info.width = decoder.get<uint32_t>();
+  map->info.height = decoder.get<uint32_t>();
+  map->info.origin.position = decodePoint(decoder);
+  map->info.origin.orientation.x = decoder.get<double>();
+  map->info.origin.orientation.y = decoder.get<double>();
+  map->info.origin.orientation.z = decoder.get<double>();
+  map->info.origin.orientation.w = decoder.get<double>();
+  map->data.resize(decoder.getCount<uint64_t>(1));
+  decoder.getBytes(map->data.data(), map->data.size());
+  return map;
+}
+
+map_msgs::msg::OccupancyGridUpdate::SharedPtr decodeMapUpdate(const CostmapRecord & record)
+{
+  auto update = std::make_shared<map_msgs::msg::OccupancyGridUpdate>();
+  RecordDecoder decoder(record.data);
+  update->header.frame_id = decoder.getString();
+  update->header.stamp.sec = decoder.get<int32_t>();
+  update->header.stamp.nanosec = decoder.get<uint32_t>();
+  update->x = decoder.get<int32_t>();
+  update->y = decoder.get<int32_t>();
+  update->width = decoder.get<uint32_t>();
+  update->height = decoder.get<uint32_t>();
+  update->data.resize(decoder.getCount<uint64_t>(1));
+  decoder.getBytes(update->data.data(), update->data.size());
+  return update;
+}
+
+}  // namespace nav2_costmap_2d
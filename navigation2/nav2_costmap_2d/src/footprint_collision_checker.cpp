@@ -18,6 +18,8 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <cmath>
+#include <limits>
 
 #include "nav2_costmap_2d/footprint_collision_checker.hpp"
 
@@ -33,14 +35,18 @@ namespace nav2_costmap_2d
 
 template<typename CostmapT>
 FootprintCollisionChecker<CostmapT>::FootprintCollisionChecker()
-: costmap_(nullptr)
+: costmap_(nullptr),
+  mask_resolution_(0.0),
+  num_mask_headings_(72)
 {
 }
 
 template<typename CostmapT>
 FootprintCollisionChecker<CostmapT>::FootprintCollisionChecker(
   CostmapT costmap)
-: costmap_(costmap)
+: costmap_(costmap),
+  mask_resolution_(0.0),
+  num_mask_headings_(72)
 {
 }
 
@@ -136,6 +142,177 @@ double FootprintCollisionChecker<CostmapT>::footprintCostAtPose(
   return footprintCost(oriented_footprint);
 }
 
+template<typename CostmapT>
+double FootprintCollisionChecker<CostmapT>::footprintAreaCostAtPose(
+  double x, double y, double theta, const Footprint & footprint)
+{
+  unsigned int mx, my;
+  if (!worldToMap(x, y, mx, my)) {
+    return static_cast<double>(LETHAL_OBSTACLE);
+  }
+
+  const double bin_size = 2.0 * M_PI / num_mask_headings_;
+  int bin = static_cast<int>(
+    std::lround(theta / bin_size) % static_cast<long>(num_mask_headings_));
+  if (bin < 0) {
+    bin += num_mask_headings_;
+  }
+  const std::vector<MaskSpan> & mask = footprintMask(bin, footprint);
+
+  const int size_x = static_cast<int>(costmap_->getSizeInCellsX());
+  const int size_y = static_cast<int>(costmap_->getSizeInCellsY());
+  const unsigned char * grid = costmap_->getCharMap();
+  unsigned char footprint_cost = 0;
+
+  for (const MaskSpan & span : mask) {
+    const int row = static_cast<int>(my) + span.dy;
+    const int x0 = static_cast<int>(mx) + span.x0;
+    const int x1 = static_cast<int>(mx) + span.x1;
+    if (row < 0 || row >= size_y || x0 < 0 || x1 >= size_x) {
+      return static_cast<double>(LETHAL_OBSTACLE);
+    }
+
+    const unsigned char * cell = grid + row * size_x;
+    for (int i = x0; i <= x1; ++i) {
+      footprint_cost = std::max(footprint_cost, cell[i]);
+    }
+  }
+
+  return static_cast<double>(footprint_cost);
+}
+
+template<typename CostmapT>
+void FootprintCollisionChecker<CostmapT>::setNumMaskHeadings(unsigned int num_headings)
+{
+  num_mask_headings_ = std::max(num_headings, 1u);
+  masks_.clear();
+  mask_valid_.clear();
+}
+
+template<typename CostmapT>
+const std::vector<typename FootprintCollisionChecker<CostmapT>::MaskSpan> &
+FootprintCollisionChecker<CostmapT>::footprintMask(
+  unsigned int heading_bin, const Footprint & footprint)
+{
+  // Drop every cached mask once the footprint or the map resolution changes
+  if (masks_.size() != num_mask_headings_ ||
+    mask_resolution_ != costmap_->getResolution() || mask_footprint_ != footprint)
+  {
+    mask_footprint_ = footprint;
+    mask_resolution_ = costmap_->getResolution();
+    masks_.assign(num_mask_headings_, std::vector<MaskSpan>());
+    mask_valid_.assign(num_mask_headings_, false);
+  }
+
+  if (!mask_valid_[heading_bin]) {
+    rasterizeFootprint(
+      heading_bin * 2.0 * M_PI / num_mask_headings_, footprint, masks_[heading_bin]);
+    mask_valid_[heading_bin] = true;
+  }
+  return masks_[heading_bin];
+}
+
+template<typename CostmapT>
+void FootprintCollisionChecker<CostmapT>::rasterizeFootprint(
+  double theta, const Footprint & footprint, std::vector<MaskSpan> & mask) const
+{
+  mask.clear();
+  if (footprint.empty()) {
+    return;
+  }
+
+  // Vertices in cells at the bin's heading, relative to the pose's cell
+  const double resolution = costmap_->getResolution();
+  const double cos_th = cos(theta);
+  const double sin_th = sin(theta);
+  const unsigned int n = footprint.size();
+  std::vector<double> px(n), py(n);
+  double radius = 0.0;
+  for (unsigned int i = 0; i < n; ++i) {
+    px[i] = (footprint[i].x * cos_th - footprint[i].y * sin_th) / resolution;
+    py[i] = (footprint[i].x * sin_th + footprint[i].y * cos_th) / resolution;
+    radius = std::max(radius, std::hypot(px[i], py[i]));
+  }
+
+  // A pose anywhere in its cell and within half a bin of theta puts each vertex
+  // within drift of that, plus the pose's offset into its cell; these are the
+  // cells footprintCost could find the vertex in
+  const double drift = 2.0 * radius * sin(M_PI / (2.0 * num_mask_headings_)) + 1e-6;
+  std::vector<int> cx0(n), cx1(n), cy0(n), cy1(n);
+  int min_x = std::numeric_limits<int>::max(), max_x = std::numeric_limits<int>::min();
+  int min_y = std::numeric_limits<int>::max(), max_y = std::numeric_limits<int>::min();
+  for (unsigned int i = 0; i < n; ++i) {
+    cx0[i] = static_cast<int>(std::floor(px[i] - drift));
+    cx1[i] = static_cast<int>(std::ceil(px[i] + drift));
+    cy0[i] = static_cast<int>(std::floor(py[i] - drift));
+    cy1[i] = static_cast<int>(std::ceil(py[i] + drift));
+    min_x = std::min(min_x, cx0[i]);
+    max_x = std::max(max_x, cx1[i]);
+    min_y = std::min(min_y, cy0[i]);
+    max_y = std::max(max_y, cy1[i]);
+  }
+
+  const int width = max_x - min_x + 1;
+  const int height = max_y - min_y + 1;
+  std::vector<unsigned char> cells(width * height, 0);
+
+  // The outline, walked the same way footprintCost does between every pair of
+  // cells an edge's vertices could be found in
+  for (unsigned int i = 0; i < n; ++i) {
+    const unsigned int j = (i + 1) % n;
+    for (int ax = cx0[i]; ax <= cx1[i]; ++ax) {
+      for (int ay = cy0[i]; ay <= cy1[i]; ++ay) {
+        for (int bx = cx0[j]; bx <= cx1[j]; ++bx) {
+          for (int by = cy0[j]; by <= cy1[j]; ++by) {
+            for (nav2_util::LineIterator line(ax, ay, bx, by); line.isValid(); line.advance()) {
+              cells[(line.getY() - min_y) * width + line.getX() - min_x] = 1;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // The interior: cells whose centers lie inside the polygon posed at the center
+  // of its cell, by even-odd scanlines through each row's centers
+  std::vector<double> crossings;
+  for (int row = min_y; row <= max_y; ++row) {
+    crossings.clear();
+    for (unsigned int i = 0; i < n; ++i) {
+      const unsigned int j = (i + 1) % n;
+      if ((py[i] > row) != (py[j] > row)) {
+        crossings.push_back(px[i] + (row - py[i]) * (px[j] - px[i]) / (py[j] - py[i]));
+      }
+    }
+    std::sort(crossings.begin(), crossings.end());
+
+    unsigned char * line = &cells[(row - min_y) * width];
+    for (unsigned int k = 0; k + 1 < crossings.size(); k += 2) {
+      const int first = std::max(static_cast<int>(std::ceil(crossings[k])), min_x);
+      const int last = std::min(static_cast<int>(std::floor(crossings[k + 1])), max_x);
+      for (int i = first; i <= last; ++i) {
+        line[i - min_x] = 1;
+      }
+    }
+  }
+
+  for (int row = 0; row < height; ++row) {
+    const unsigned char * line = &cells[row * width];
+    int i = 0;
+    while (i < width) {
+      if (!line[i]) {
+        ++i;
+        continue;
+      }
+      const int start = i;
+      while (i < width && line[i]) {
+        ++i;
+      }
+      mask.push_back(MaskSpan{row + min_y, start + min_x, i - 1 + min_x});
+    }
+  }
+}
+
 // declare our valid template parameters
 template class FootprintCollisionChecker<std::shared_ptr<nav2_costmap_2d::Costmap2D>>;
 template class FootprintCollisionChecker<nav2_costmap_2d::Costmap2D *>;
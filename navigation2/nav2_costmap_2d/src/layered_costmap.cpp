@@ -38,6 +38,7 @@
 #include "nav2_costmap_2d/layered_costmap.hpp"
 
 #include <algorithm>
+#include <chrono>
 #include <cstdio>
 #include <memory>
 #include <string>
@@ -65,6 +66,8 @@ LayeredCostmap::LayeredCostmap(std::string global_frame, bool rolling_window, bo
   bxn_(0),
   by0_(0),
   byn_(0),
+  replay_cycle_(nullptr),
+  time_plugins_(false),
   initialized_(false),
   size_locked_(false),
   circumscribed_radius_(1.0),
@@ -112,6 +115,19 @@ void LayeredCostmap::updateMap(double robot_x, double robot_y, double robot_yaw)
   // implement thread unsafe updateBounds() functions.
   std::unique_lock<Costmap2D::mutex_t> lock(*(costmap_.getMutex()));
 
+  if (recorder_) {
+    recorder_->beginCycle(robot_x, robot_y, robot_yaw);
+  }
+
+  updateLayers(robot_x, robot_y, robot_yaw);
+
+  if (recorder_) {
+    recorder_->endCycle(costmap_);
+  }
+}
+
+void LayeredCostmap::updateLayers(double robot_x, double robot_y, double robot_yaw)
+{
   // if we're using a rolling buffer costmap...
   // we need to update the origin using the robot's position
   if (rolling_window_) {
@@ -133,6 +149,11 @@ void LayeredCostmap::updateMap(double robot_x, double robot_y, double robot_yaw)
   minx_ = miny_ = std::numeric_limits<double>::max();
   maxx_ = maxy_ = std::numeric_limits<double>::lowest();
 
+  if (time_plugins_) {
+    plugin_timings_.resize(plugins_.size());
+  }
+  std::chrono::steady_clock::time_point start;
+
   for (vector<std::shared_ptr<Layer>>::iterator plugin = plugins_.begin();
     plugin != plugins_.end(); ++plugin)
   {
@@ -140,7 +161,14 @@ void LayeredCostmap::updateMap(double robot_x, double robot_y, double robot_yaw)
     double prev_miny = miny_;
     double prev_maxx = maxx_;
     double prev_maxy = maxy_;
+    if (time_plugins_) {
+      start = std::chrono::steady_clock::now();
+    }
     (*plugin)->updateBounds(robot_x, robot_y, robot_yaw, &minx_, &miny_, &maxx_, &maxy_);
+    if (time_plugins_) {
+      plugin_timings_[plugin - plugins_.begin()].update_bounds_time +=
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
     if (minx_ > prev_minx || miny_ > prev_miny || maxx_ < prev_maxx || maxy_ < prev_maxy) {
       RCLCPP_WARN(
         rclcpp::get_logger(
@@ -173,7 +201,18 @@ void LayeredCostmap::updateMap(double robot_x, double robot_y, double robot_yaw)
   for (vector<std::shared_ptr<Layer>>::iterator plugin = plugins_.begin();
     plugin != plugins_.end(); ++plugin)
   {
+    if (time_plugins_) {
+      start = std::chrono::steady_clock::now();
+    }
     (*plugin)->updateCosts(costmap_, x0, y0, xn, yn);
+    if (time_plugins_) {
+      plugin_timings_[plugin - plugins_.begin()].update_costs_time +=
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+  }
+
+  if (pyramid_) {
+    pyramid_->update(costmap_, x0, y0, xn, yn);
   }
 
   bx0_ = x0;
@@ -184,6 +223,28 @@ void LayeredCostmap::updateMap(double robot_x, double robot_y, double robot_yaw)
   initialized_ = true;
 }
 
+void LayeredCostmap::enablePyramid(unsigned int num_levels)
+{
+  std::unique_lock<Costmap2D::mutex_t> lock(*(costmap_.getMutex()));
+  pyramid_ = num_levels > 0 ? std::make_unique<CostmapPyramid>(num_levels) : nullptr;
+}
+
+void LayeredCostmap::setRecorder(std::shared_ptr<CostmapRecorder> recorder)
+{
+  std::unique_lock<Costmap2D::mutex_t> lock(*(costmap_.getMutex()));
+  recorder_ = recorder;
+  if (recorder_) {
+    recorder_->writeFootprint(footprint_);
+  }
+}
+
+void LayeredCostmap::enablePluginTimings(bool enable)
+{
+  std::unique_lock<Costmap2D::mutex_t> lock(*(costmap_.getMutex()));
+  time_plugins_ = enable;
+  plugin_timings_.assign(enable ? plugins_.size() : 0, PluginTiming());
+}
+
 bool LayeredCostmap::isCurrent()
 {
   current_ = true;
@@ -198,6 +259,9 @@ bool LayeredCostmap::isCurrent()
 void LayeredCostmap::setFootprint(const std::vector<geometry_msgs::msg::Point> & footprint_spec)
 {
   footprint_ = footprint_spec;
+  if (recorder_) {
+    recorder_->writeFootprint(footprint_);
+  }
   nav2_costmap_2d::calculateMinAndMaxDistances(
     footprint_spec,
     inscribed_radius_, circumscribed_radius_);
@@ -37,7 +37,7 @@
 #include "nav2_costmap_2d/observation_buffer.hpp"
 
 #include <algorithm>
-#include <list>
+#include <cmath>
 #include <string>
 #include <vector>
 
@@ -46,20 +46,43 @@
 
 namespace nav2_costmap_2d
 {
+constexpr unsigned int ObservationBuffer::DEFAULT_CAPACITY;
+constexpr double ObservationBuffer::DROP_WARNING_PERIOD;
+constexpr double ObservationBuffer::MAX_DERIVED_CAPACITY;
+
 ObservationBuffer::ObservationBuffer(
   nav2_util::LifecycleNode::SharedPtr nh, std::string topic_name, double observation_keep_time,
   double expected_update_rate,
   double min_obstacle_height, double max_obstacle_height, double obstacle_range,
   double raytrace_range, tf2_ros::Buffer & tf2_buffer, std::string global_frame,
-  std::string sensor_frame, double tf_tolerance)
+  std::string sensor_frame, double tf_tolerance, unsigned int capacity)
 : tf2_buffer_(tf2_buffer),
   observation_keep_time_(rclcpp::Duration::from_seconds(observation_keep_time)),
   expected_update_rate_(rclcpp::Duration::from_seconds(expected_update_rate)), nh_(nh),
-  last_updated_(nh->now()), global_frame_(global_frame), sensor_frame_(sensor_frame),
+  global_frame_(global_frame), sensor_frame_(sensor_frame),
   topic_name_(topic_name),
   min_obstacle_height_(min_obstacle_height), max_obstacle_height_(max_obstacle_height),
-  obstacle_range_(obstacle_range), raytrace_range_(raytrace_range), tf_tolerance_(tf_tolerance)
+  obstacle_range_(obstacle_range), raytrace_range_(raytrace_range), tf_tolerance_(tf_tolerance),
+  slots_(std::max(
+      capacity ? capacity : capacityFor(observation_keep_time, expected_update_rate), 2u)),
+  head_(0), claimed_(0), reader_epoch_(NO_READER), tail_(0), dropped_(0)
 {
+  rclcpp::Time now = nh_->now();
+  clock_type_ = now.get_clock_type();
+  last_updated_ns_.store(now.nanoseconds());
+  last_drop_warning_ = now;
+
+  // an explicit capacity should at least hold a window of updates at the expected rate
+  if (capacity != 0 && observation_keep_time > 0.0 && expected_update_rate > 0.0) {
+    const double needed = std::ceil(observation_keep_time / expected_update_rate) + 2.0;
+    if (capacity < needed) {
+      RCLCPP_WARN(
+        rclcpp::get_logger("nav2_costmap_2d"),
+        "The %s observation buffer holds %u observations, but %.2f seconds of persistence at "
+        "an update every %.2f seconds needs %.0f, older observations will be recycled early.",
+        topic_name_.c_str(), capacity, observation_keep_time, expected_update_rate, needed);
+    }
+  }
 }
 
 ObservationBuffer::~ObservationBuffer()
@@ -84,10 +107,10 @@ bool ObservationBuffer::setGlobalFrame(const std::string new_global_frame)
     return false;
   }
 
-  std::list<Observation>::iterator obs_it;
-  for (obs_it = observation_list_.begin(); obs_it != observation_list_.end(); ++obs_it) {
+  const uint64_t head = head_.load(std::memory_order_acquire);
+  for (uint64_t seq = tail_; seq < head; ++seq) {
     try {
-      Observation & obs = *obs_it;
+      Observation & obs = slot(seq);
 
       geometry_msgs::msg::PointStamped origin;
       origin.header.frame_id = global_frame_;
@@ -120,8 +143,29 @@ void ObservationBuffer::bufferCloud(const sensor_msgs::msg::PointCloud2 & cloud)
 {
   geometry_msgs::msg::PointStamped global_origin;
 
-  // create a new observation on the list to be populated
-  observation_list_.push_front(Observation());
+  // claim the next slot before checking whether the consumer has it pinned, so that
+  // either we see its epoch or it sees our claim and skips the slot we are recycling
+  const uint64_t seq = head_.load(std::memory_order_relaxed);
+  claimed_.store(seq + 1);
+  const uint64_t epoch = reader_epoch_.load();
+  if (seq >= slots_.size() && epoch <= seq - slots_.size()) {
+    // drops come in bursts while the consumer copies, so only warn every few seconds
+    ++dropped_;
+    const rclcpp::Time now = nh_->now();
+    if (dropped_ == 1 ||
+      now - last_drop_warning_ >= rclcpp::Duration::from_seconds(DROP_WARNING_PERIOD))
+    {
+      last_drop_warning_ = now;
+      RCLCPP_WARN(
+        rclcpp::get_logger("nav2_costmap_2d"),
+        "The %s observation buffer is full of observations in use, dropped %u clouds so far.",
+        topic_name_.c_str(), dropped_);
+    }
+    return;
+  }
+
+  // reuse the preallocated observation in the claimed slot
+  Observation & observation = slot(seq);
 
   // check whether the origin frame has been set explicitly
   // or whether we should get it from the cloud
@@ -137,12 +181,12 @@ void ObservationBuffer::bufferCloud(const sensor_msgs::msg::PointCloud2 & cloud)
     local_origin.point.y = 0;
     local_origin.point.z = 0;
     tf2_buffer_.transform(local_origin, global_origin, global_frame_);
-    tf2::convert(global_origin.point, observation_list_.front().origin_);
+    tf2::convert(global_origin.point, observation.origin_);
 
     // make sure to pass on the raytrace/obstacle range
     // of the observation buffer to the observations
-    observation_list_.front().raytrace_range_ = raytrace_range_;
-    observation_list_.front().obstacle_range_ = obstacle_range_;
+    observation.raytrace_range_ = raytrace_range_;
+    observation.obstacle_range_ = obstacle_range_;
 
     sensor_msgs::msg::PointCloud2 global_frame_cloud;
 
@@ -152,7 +196,7 @@ void ObservationBuffer::bufferCloud(const sensor_msgs::msg::PointCloud2 & cloud)
 
     // now we need to remove observations from the cloud that are below
     // or above our height thresholds
-    sensor_msgs::msg::PointCloud2 & observation_cloud = *(observation_list_.front().cloud_);
+    sensor_msgs::msg::PointCloud2 & observation_cloud = *(observation.cloud_);
     observation_cloud.height = global_frame_cloud.height;
     observation_cloud.width = global_frame_cloud.width;
     observation_cloud.fields = global_frame_cloud.fields;
@@ -188,8 +232,7 @@ void ObservationBuffer::bufferCloud(const sensor_msgs::msg::PointCloud2 & cloud)
     observation_cloud.header.stamp = cloud.header.stamp;
     observation_cloud.header.frame_id = global_frame_cloud.header.frame_id;
   } catch (tf2::TransformException & ex) {
-    // if an exception occurs, we need to remove the empty observation from the list
-    observation_list_.pop_front();
+    // if an exception occurs, the claimed slot is simply never published
     RCLCPP_ERROR(
       rclcpp::get_logger(
         "nav2_costmap_2d"),
@@ -200,68 +243,103 @@ void ObservationBuffer::bufferCloud(const sensor_msgs::msg::PointCloud2 & cloud)
   }
 
   // if the update was successful, we want to update the last updated time
-  last_updated_ = nh_->now();
+  last_updated_ns_.store(nh_->now().nanoseconds());
 
-  // we'll also remove any stale observations from the list
-  purgeStaleObservations();
+  // and publish the observation to the consumer
+  head_.store(seq + 1, std::memory_order_release);
 }
 
 // returns a copy of the observations
 void ObservationBuffer::getObservations(std::vector<Observation> & observations)
 {
-  // first... let's make sure that we don't have any stale observations
-  purgeStaleObservations();
+  const uint64_t head = head_.load(std::memory_order_acquire);
+  const uint64_t capacity = slots_.size();
+
+  // pin the oldest slot we may read, then drop anything the producer is already recycling
+  tail_ = std::max(tail_, head > capacity ? head - capacity : 0);
+  reader_epoch_.store(tail_);
+  const uint64_t claimed = claimed_.load();
+  tail_ = std::max(tail_, claimed > capacity ? claimed - capacity : 0);
 
-  // now we'll just copy the observations for the caller
-  std::list<Observation>::iterator obs_it;
-  for (obs_it = observation_list_.begin(); obs_it != observation_list_.end(); ++obs_it) {
-    observations.push_back(*obs_it);
+  // first... let's make sure that we don't have any stale observations,
+  // and release the slots they held back to the producer
+  purgeStaleObservations(head);
+  reader_epoch_.store(tail_);
+
+  // now we'll just copy the observations for the caller, newest first
+  for (uint64_t seq = head; seq > tail_; --seq) {
+    observations.push_back(slot(seq - 1));
   }
+
+  reader_epoch_.store(NO_READER, std::memory_order_release);
 }
 
-void ObservationBuffer::purgeStaleObservations()
+void ObservationBuffer::purgeStaleObservations(uint64_t head)
 {
-  if (!observation_list_.empty()) {
-    std::list<Observation>::iterator obs_it = observation_list_.begin();
-    // if we're keeping observations for no time... then we'll only keep one observation
-    if (observation_keep_time_ == rclcpp::Duration(0.0)) {
-      observation_list_.erase(++obs_it, observation_list_.end());
-      return;
-    }
+  if (tail_ >= head) {
+    return;
+  }
 
-    // otherwise... we'll have to loop through the observations to see which ones are stale
-    for (obs_it = observation_list_.begin(); obs_it != observation_list_.end(); ++obs_it) {
-      Observation & obs = *obs_it;
-      // check if the observation is out of date... and if it is,
-      // remove it and those that follow from the list
-      if ((last_updated_ - obs.cloud_->header.stamp) > observation_keep_time_) {
-        observation_list_.erase(obs_it, observation_list_.end());
-        return;
-      }
-    }
+  // if we're keeping observations for no time... then we'll only keep one observation
+  if (observation_keep_time_ == rclcpp::Duration(0.0)) {
+    tail_ = head - 1;
+    return;
+  }
+
+  // otherwise... observations arrive in order, so advance past the stale ones at the tail
+  const rclcpp::Time last_updated = lastUpdated();
+  while (tail_ < head &&
+    (last_updated - slot(tail_).cloud_->header.stamp) > observation_keep_time_)
+  {
+    ++tail_;
   }
 }
 
+unsigned int ObservationBuffer::capacityFor(
+  double observation_keep_time, double expected_update_rate)
+{
+  // keeping only the latest observation, with room for one being written while it is read
+  if (observation_keep_time <= 0.0) {
+    return 4;
+  }
+
+  if (expected_update_rate <= 0.0) {
+    return DEFAULT_CAPACITY;
+  }
+
+  // the expected update rate is the longest allowed gap between updates, so leave room for
+  // a sensor publishing twice as often, plus the slots being written and read
+  const double needed = 2.0 * std::ceil(observation_keep_time / expected_update_rate) + 2.0;
+  return static_cast<unsigned int>(
+    std::min(std::max(needed, static_cast<double>(DEFAULT_CAPACITY)), MAX_DERIVED_CAPACITY));
+}
+
+rclcpp::Time ObservationBuffer::lastUpdated() const
+{
+  return rclcpp::Time(last_updated_ns_.load(), clock_type_);
+}
+
 bool ObservationBuffer::isCurrent() const
 {
   if (expected_update_rate_ == rclcpp::Duration(0.0)) {
     return true;
   }
 
-  bool current = (nh_->now() - last_updated_) <= expected_update_rate_;
+  const rclcpp::Time last_updated = lastUpdated();
+  bool current = (nh_->now() - last_updated) <= expected_update_rate_;
   if (!current) {
     RCLCPP_WARN(
       rclcpp::get_logger(
         "nav2_costmap_2d"),
       "The %s observation buffer has not been updated for %.2f seconds, and it should be updated every %.2f seconds.", //NOLINT
       topic_name_.c_str(),
-      (nh_->now() - last_updated_).seconds(), expected_update_rate_.seconds());
+      (nh_->now() - last_updated).seconds(), expected_update_rate_.seconds());
   }
   return current;
 }
 
 void ObservationBuffer::resetLastUpdated()
 {
-  last_updated_ = nh_->now();
+  last_updated_ns_.store(nh_->now().nanoseconds());
 }
 }  // namespace nav2_costmap_2d
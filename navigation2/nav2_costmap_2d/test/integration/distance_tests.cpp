@@ -0,0 +1,99 @@
+// Copyright (c) 2020 Navigation2 contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "nav2_costmap_2d/costmap_2d.hpp"
+#include "nav2_costmap_2d/layered_costmap.hpp"
+#include "nav2_costmap_2d/obstacle_layer.hpp"
+#include "nav2_costmap_2d/distance_layer.hpp"
+#include "../testing_helper.hpp"
+#include "nav2_util/node_utils.hpp"
+
+class RclCppFixture
+{
+public:
+  RclCppFixture() {rclcpp::init(0, nullptr);}
+  ~RclCppFixture() {rclcpp::shutdown();}
+};
+RclCppFixture g_rclcppfixture;
+
+class TestNode : public ::testing::Test
+{
+public:
+  TestNode()
+  {
+    auto options = rclcpp::NodeOptions();
+    options.parameter_overrides({rclcpp::Parameter("distance.max_distance", 3.0)});
+
+    node_ = std::make_shared<nav2_util::LifecycleNode>(
+      "distance_test_node", "", false, options);
+
+    // Declare non-plugin specific costmap parameters
+    node_->declare_parameter("track_unknown_space", rclcpp::ParameterValue(false));
+    node_->declare_parameter("use_maximum", rclcpp::ParameterValue(false));
+    node_->declare_parameter("lethal_cost_threshold", rclcpp::ParameterValue(100));
+    node_->declare_parameter("transform_tolerance", rclcpp::ParameterValue(0.3));
+    node_->declare_parameter("observation_sources", rclcpp::ParameterValue(std::string("")));
+  }
+
+  ~TestNode() {}
+
+protected:
+  nav2_util::LifecycleNode::SharedPtr node_;
+};
+
+TEST_F(TestNode, testDistanceToObstacles)
+{
+  tf2_ros::Buffer tf(node_->get_clock());
+  nav2_costmap_2d::LayeredCostmap layers("frame", false, false);
+  layers.resizeMap(10, 10, 1, 0, 0);
+
+  std::shared_ptr<nav2_costmap_2d::ObstacleLayer> olayer = nullptr;
+  addObstacleLayer(layers, tf, node_, olayer);
+
+  std::shared_ptr<nav2_costmap_2d::DistanceLayer> dlayer = nullptr;
+  addDistanceLayer(layers, tf, node_, dlayer);
+
+  addObservation(olayer, 5, 5, MAX_Z);
+  layers.updateMap(0, 0, 0);
+
+  EXPECT_FLOAT_EQ(dlayer->getDistance(5, 5), 0.0);
+  EXPECT_FLOAT_EQ(dlayer->getDistance(6, 5), 1.0);
+  EXPECT_FLOAT_EQ(dlayer->getDistance(6, 6), std::sqrt(2.0));
+  EXPECT_FLOAT_EQ(dlayer->getDistance(7, 7), std::sqrt(8.0));
+  // Capped at max_distance
+  EXPECT_FLOAT_EQ(dlayer->getDistance(9, 9), 3.0);
+  EXPECT_FLOAT_EQ(dlayer->getDistance(0, 0), 3.0);
+
+  float gx, gy;
+  dlayer->getGradient(7, 5, gx, gy);
+  EXPECT_FLOAT_EQ(gx, 1.0);
+  EXPECT_FLOAT_EQ(gy, 0.0);
+
+  // A new obstacle only updates the distances around it
+  addObservation(olayer, 1, 1, MAX_Z);
+  layers.updateMap(0, 0, 0);
+
+  EXPECT_FLOAT_EQ(dlayer->getDistance(1, 1), 0.0);
+  EXPECT_FLOAT_EQ(dlayer->getDistance(0, 0), std::sqrt(2.0));
+  EXPECT_FLOAT_EQ(dlayer->getDistance(3, 1), 2.0);
+  EXPECT_FLOAT_EQ(dlayer->getDistance(5, 5), 0.0);
+  EXPECT_FLOAT_EQ(dlayer->getDistance(6, 6), std::sqrt(2.0));
+}
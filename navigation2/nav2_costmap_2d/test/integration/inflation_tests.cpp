@@ -33,10 +33,13 @@
  */
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <cmath>
+#include <limits>
 #include <map>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "nav2_costmap_2d/costmap_2d.hpp"
@@ -594,3 +597,277 @@ TEST_F(TestNode, testInflation3)
   ASSERT_EQ(countValues(*costmap, nav2_costmap_2d::LETHAL_OBSTACLE), 1u);
   ASSERT_EQ(countValues(*costmap, nav2_costmap_2d::INSCRIBED_INFLATED_OBSTACLE), 4u);
 }
+
+/**
+ * Marks the whole map for update every cycle and, given a source costmap, copies it
+ * into the master grid as a static layer would, without being a StaticLayer that the
+ * inflation layer could cache
+ */
+class WholeMapLayer : public nav2_costmap_2d::Layer
+{
+public:
+  explicit WholeMapLayer(const nav2_costmap_2d::Costmap2D * source = nullptr)
+  : source_(source)
+  {
+  }
+
+  void reset() override {}
+
+  void updateBounds(
+    double, double, double, double * min_x, double * min_y, double * max_x,
+    double * max_y) override
+  {
+    nav2_costmap_2d::Costmap2D * master = layered_costmap_->getCostmap();
+    *min_x = std::min(*min_x, master->getOriginX());
+    *min_y = std::min(*min_y, master->getOriginY());
+    *max_x = std::max(*max_x, master->getOriginX() + master->getSizeInMetersX());
+    *max_y = std::max(*max_y, master->getOriginY() + master->getSizeInMetersY());
+  }
+
+  void updateCosts(
+    nav2_costmap_2d::Costmap2D & master_grid, int min_i, int min_j, int max_i,
+    int max_j) override
+  {
+    if (!source_) {
+      return;
+    }
+    for (int j = min_j; j < max_j; j++) {
+      for (int i = min_i; i < max_i; i++) {
+        master_grid.setCost(i, j, source_->getCost(i, j));
+      }
+    }
+  }
+
+private:
+  const nav2_costmap_2d::Costmap2D * source_;
+};
+
+/**
+ * A 20 x 20 map with an interior wall, a pillar, an unknown patch and two outer walls
+ */
+nav_msgs::msg::OccupancyGrid::SharedPtr makeStaticMap(unsigned int pillar_y)
+{
+  auto map = std::make_shared<nav_msgs::msg::OccupancyGrid>();
+  map->header.frame_id = "frame";
+  map->info.resolution = 1.0;
+  map->info.width = 20;
+  map->info.height = 20;
+  map->info.origin.orientation.w = 1.0;
+  map->data.assign(20 * 20, 0);
+  for (unsigned int i = 0; i < 20; i++) {
+    map->data[19 * 20 + i] = 100;
+    map->data[i * 20 + 19] = 100;
+  }
+  for (unsigned int j = 4; j <= 12; j++) {
+    map->data[j * 20 + 8] = 100;
+  }
+  map->data[pillar_y * 20 + 14] = 100;
+  for (unsigned int j = 12; j <= 15; j++) {
+    for (unsigned int i = 12; i <= 15; i++) {
+      map->data[j * 20 + i] = -1;
+    }
+  }
+  return map;
+}
+
+/**
+ * Fixture comparing a costmap whose inflation layer reuses its static map inflation
+ * with one where the same static map is copied in by a WholeMapLayer and inflated
+ * along with everything else each cycle
+ */
+class StaticInflationTest : public TestNode
+{
+protected:
+  void initCostmaps(
+    bool inflate_unknown, bool inflate_around_unknown, int obstacle_combination_method = 1)
+  {
+    std::vector<rclcpp::Parameter> parameters;
+    parameters.push_back(rclcpp::Parameter("inflation.cost_scaling_factor", 1.0));
+    parameters.push_back(rclcpp::Parameter("inflation.inflation_radius", 3.0));
+    parameters.push_back(rclcpp::Parameter("inflation.inflate_unknown", inflate_unknown));
+    parameters.push_back(
+      rclcpp::Parameter("inflation.inflate_around_unknown", inflate_around_unknown));
+    parameters.push_back(
+      rclcpp::Parameter("static.map_topic", std::string("static_inflation_test_map")));
+    parameters.push_back(
+      rclcpp::Parameter("obstacles.combination_method", obstacle_combination_method));
+    initNode(parameters);
+    node_->set_parameter(rclcpp::Parameter("track_unknown_space", true));
+
+    map_node_ = rclcpp::Node::make_shared("static_inflation_test_map_publisher");
+    map_pub_ = map_node_->create_publisher<nav_msgs::msg::OccupancyGrid>(
+      "static_inflation_test_map", rclcpp::QoS(1).transient_local().reliable());
+
+    tf_ = std::make_shared<tf2_ros::Buffer>(node_->get_clock());
+    cached_ = std::make_shared<nav2_costmap_2d::LayeredCostmap>("frame", false, true);
+    full_ = std::make_shared<nav2_costmap_2d::LayeredCostmap>("frame", false, true);
+    cached_->resizeMap(20, 20, 1, 0, 0);
+    full_->resizeMap(20, 20, 1, 0, 0);
+    setRadii(*cached_, 1, 1);
+    setRadii(*full_, 1, 1);
+
+    addWholeMapLayer(*cached_, nullptr);
+    addStaticLayer(*cached_, *tf_, node_, slayer_);
+    addObstacleLayer(*cached_, *tf_, node_, cached_olayer_);
+    addInflationLayer(*cached_, *tf_, node_, ilayer_);
+
+    addWholeMapLayer(*full_, slayer_.get());
+    addObstacleLayer(*full_, *tf_, node_, full_olayer_);
+    std::shared_ptr<nav2_costmap_2d::InflationLayer> full_ilayer;
+    addInflationLayer(*full_, *tf_, node_, full_ilayer);
+
+    publishMap(5);
+  }
+
+  void addWholeMapLayer(
+    nav2_costmap_2d::LayeredCostmap & layers, const nav2_costmap_2d::Costmap2D * source)
+  {
+    auto layer = std::make_shared<WholeMapLayer>(source);
+    layers.addPlugin(layer);
+    layer->initialize(&layers, "whole_map", tf_.get(), node_, nullptr, nullptr);
+  }
+
+  void publishMap(unsigned int pillar_y)
+  {
+    const unsigned int revision = slayer_->getMapRevision();
+    map_pub_->publish(*makeStaticMap(pillar_y));
+    while (slayer_->getMapRevision() == revision) {
+      rclcpp::spin_some(node_->get_node_base_interface());
+    }
+  }
+
+  void addObservations(
+    double x, double y, double ox = 0.0, double oy = 0.0, bool clearing = false)
+  {
+    addObservation(cached_olayer_, x, y, MAX_Z, ox, oy, MAX_Z, true, clearing);
+    addObservation(full_olayer_, x, y, MAX_Z, ox, oy, MAX_Z, true, clearing);
+  }
+
+  void update()
+  {
+    cached_->updateMap(0, 0, 0);
+    full_->updateMap(0, 0, 0);
+  }
+
+  /**
+   * Inflating static and dynamic obstacles separately and taking the max of the two can
+   * only raise costs where a single pass shadows the wavefront of one obstacle behind
+   * another's, and then to the cost of the nearest obstacle
+   */
+  void expectMatchesFullInflation()
+  {
+    nav2_costmap_2d::Costmap2D * cached = cached_->getCostmap();
+    nav2_costmap_2d::Costmap2D * full = full_->getCostmap();
+    ASSERT_EQ(
+      countValues(*cached, nav2_costmap_2d::LETHAL_OBSTACLE),
+      countValues(*full, nav2_costmap_2d::LETHAL_OBSTACLE));
+
+    std::vector<std::pair<unsigned int, unsigned int>> sources;
+    for (unsigned int j = 0; j < 20; j++) {
+      for (unsigned int i = 0; i < 20; i++) {
+        if (full->getCost(i, j) == nav2_costmap_2d::LETHAL_OBSTACLE) {
+          sources.emplace_back(i, j);
+        }
+      }
+    }
+
+    for (unsigned int j = 0; j < 20; j++) {
+      for (unsigned int i = 0; i < 20; i++) {
+        const unsigned char cached_cost = cached->getCost(i, j);
+        const unsigned char full_cost = full->getCost(i, j);
+        if (cached_cost == full_cost) {
+          continue;
+        }
+        double nearest = std::numeric_limits<double>::max();
+        for (const auto & source : sources) {
+          nearest = std::min(
+            nearest, std::hypot(
+              static_cast<double>(source.first) - i, static_cast<double>(source.second) - j));
+        }
+        EXPECT_GT(cached_cost, full_cost) << "at " << i << ", " << j;
+        EXPECT_EQ(cached_cost, ilayer_->computeCost(nearest)) << "at " << i << ", " << j;
+      }
+    }
+  }
+
+  void expectEqualsFullInflation()
+  {
+    nav2_costmap_2d::Costmap2D * cached = cached_->getCostmap();
+    nav2_costmap_2d::Costmap2D * full = full_->getCostmap();
+    for (unsigned int j = 0; j < 20; j++) {
+      for (unsigned int i = 0; i < 20; i++) {
+        EXPECT_EQ(cached->getCost(i, j), full->getCost(i, j)) << "at " << i << ", " << j;
+      }
+    }
+  }
+
+  /**
+   * Static walls plus dynamic obstacles, then a new static map and a new footprint,
+   * both of which must reinflate the static map
+   */
+  void testStaticAndDynamicObstacles()
+  {
+    addObservations(4, 8);
+    addObservations(11, 3);
+    addObservations(16, 17);
+    addObservations(9, 15);
+    update();
+    expectMatchesFullInflation();
+
+    // the pillar moves from (14, 5) to (14, 9)
+    publishMap(9);
+    update();
+    expectMatchesFullInflation();
+    EXPECT_EQ(cached_->getCostmap()->getCost(14, 5), full_->getCostmap()->getCost(14, 5));
+
+    // a larger footprint raises the inscribed radius and with it every inflated cost
+    setRadii(*cached_, 2, 2);
+    setRadii(*full_, 2, 2);
+    update();
+    expectMatchesFullInflation();
+  }
+
+  rclcpp::Node::SharedPtr map_node_;
+  rclcpp::Publisher<nav_msgs::msg::OccupancyGrid>::SharedPtr map_pub_;
+  std::shared_ptr<tf2_ros::Buffer> tf_;
+  std::shared_ptr<nav2_costmap_2d::LayeredCostmap> cached_, full_;
+  std::shared_ptr<nav2_costmap_2d::StaticLayer> slayer_;
+  std::shared_ptr<nav2_costmap_2d::ObstacleLayer> cached_olayer_, full_olayer_;
+  std::shared_ptr<nav2_costmap_2d::InflationLayer> ilayer_;
+};
+
+TEST_F(StaticInflationTest, testStaticInflation)
+{
+  initCostmaps(false, false);
+  testStaticAndDynamicObstacles();
+}
+
+TEST_F(StaticInflationTest, testStaticInflationInUnknown)
+{
+  initCostmaps(true, false);
+  testStaticAndDynamicObstacles();
+}
+
+TEST_F(StaticInflationTest, testStaticInflationAroundUnknown)
+{
+  initCostmaps(false, true);
+  testStaticAndDynamicObstacles();
+}
+
+/**
+ * An obstacle layer overwriting the master grid clears the static pillar, so the
+ * cached static inflation must not be used
+ */
+TEST_F(StaticInflationTest, testStaticInflationClearedObstacle)
+{
+  initCostmaps(false, false, 0);
+  update();
+  ASSERT_EQ(cached_->getCostmap()->getCost(14, 5), nav2_costmap_2d::LETHAL_OBSTACLE);
+
+  // raytrace from (10.5, 5.5) through the pillar to a new obstacle at (17, 5)
+  addObservations(17.5, 5.5, 10.5, 5.5, true);
+  update();
+  EXPECT_NE(cached_->getCostmap()->getCost(14, 5), nav2_costmap_2d::LETHAL_OBSTACLE);
+  EXPECT_EQ(cached_->getCostmap()->getCost(17, 5), nav2_costmap_2d::LETHAL_OBSTACLE);
+  expectEqualsFullInflation();
+}
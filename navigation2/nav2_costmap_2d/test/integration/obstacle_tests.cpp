@@ -32,13 +32,16 @@
  * Test harness for ObstacleLayer for Costmap2D
  */
 
+#include <cstdio>
 #include <memory>
 #include <string>
 #include <algorithm>
 #include <utility>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "nav2_costmap_2d/costmap_2d.hpp"
+#include "nav2_costmap_2d/costmap_recording.hpp"
 #include "nav2_costmap_2d/layered_costmap.hpp"
 #include "nav2_costmap_2d/observation_buffer.hpp"
 #include "../testing_helper.hpp"
@@ -369,3 +372,79 @@ TEST_F(TestNode, testRepeatedResets) {
         plugin->reset();
       }));
 }
+
+/**
+ * Every marking point grows the update bounds, even when its cell is already marked
+ */
+TEST_F(TestNode, testDuplicateMarkingPointsGrowBounds) {
+  tf2_ros::Buffer tf(node_->get_clock());
+  nav2_costmap_2d::LayeredCostmap layers("frame", false, false);
+  layers.resizeMap(10, 10, 1, 0, 0);
+  std::shared_ptr<nav2_costmap_2d::ObstacleLayer> olayer = nullptr;
+  addObstacleLayer(layers, tf, node_, olayer);
+
+  // Two marking only points in cell <5, 5>
+  addObservation(olayer, 5.25, 5.25, MAX_Z / 2, 0.0, 0.0, MAX_Z / 2, true, false);
+  addObservation(olayer, 5.75, 5.5, MAX_Z / 2, 0.0, 0.0, MAX_Z / 2, true, false);
+
+  double min_x = 1e30, min_y = 1e30, max_x = -1e30, max_y = -1e30;
+  olayer->updateBounds(0, 0, 0, &min_x, &min_y, &max_x, &max_y);
+
+  EXPECT_DOUBLE_EQ(min_x, 5.25);
+  EXPECT_DOUBLE_EQ(min_y, 5.25);
+  EXPECT_DOUBLE_EQ(max_x, 5.75);
+  EXPECT_DOUBLE_EQ(max_y, 5.5);
+  EXPECT_EQ(olayer->getCost(5, 5), nav2_costmap_2d::LETHAL_OBSTACLE);
+}
+
+/**
+ * Replay the cycles recorded from one costmap through another that has no
+ * observations of its own, which must produce the same grids
+ */
+TEST_F(TestNode, testReplayMatchesRecording) {
+  const string file_name = "test_obstacle_replay.rec";
+  tf2_ros::Buffer tf(node_->get_clock());
+  std::vector<uint64_t> checksums;
+
+  {
+    nav2_costmap_2d::LayeredCostmap layers("frame", false, false);
+    layers.resizeMap(10, 10, 1, 0, 0);
+    std::shared_ptr<nav2_costmap_2d::ObstacleLayer> olayer = nullptr;
+    addObstacleLayer(layers, tf, node_, olayer);
+    layers.setRecorder(
+      std::make_shared<nav2_costmap_2d::CostmapRecorder>(file_name, false, false));
+
+    addObservation(olayer, 3.0, 3.0, MAX_Z / 2);
+    layers.updateMap(0, 0, 0);
+    checksums.push_back(nav2_costmap_2d::costmapChecksum(*layers.getCostmap()));
+
+    addObservation(olayer, 7.5, 2.5, MAX_Z / 2, 0.5, 0.5, MAX_Z / 2);
+    layers.updateMap(0, 0, 0);
+    checksums.push_back(nav2_costmap_2d::costmapChecksum(*layers.getCostmap()));
+
+    layers.setRecorder(nullptr);
+  }
+  // The second observation changed the grid, so the cycles can be told apart
+  ASSERT_NE(checksums[0], checksums[1]);
+
+  nav2_costmap_2d::LayeredCostmap layers("frame", false, false);
+  layers.resizeMap(10, 10, 1, 0, 0);
+  std::shared_ptr<nav2_costmap_2d::ObstacleLayer> olayer = nullptr;
+  addObstacleLayer(layers, tf, node_, olayer);
+
+  nav2_costmap_2d::CostmapReplay replay(file_name);
+  nav2_costmap_2d::CostmapCycle cycle;
+  size_t cycles = 0;
+  while (replay.readCycle(cycle)) {
+    ASSERT_LT(cycles, checksums.size());
+    EXPECT_EQ(cycle.checksum, checksums[cycles]);
+
+    layers.setReplayCycle(&cycle);
+    layers.updateMap(cycle.robot_x, cycle.robot_y, cycle.robot_yaw);
+    layers.setReplayCycle(nullptr);
+    EXPECT_EQ(nav2_costmap_2d::costmapChecksum(*layers.getCostmap()), cycle.checksum);
+    cycles++;
+  }
+  EXPECT_EQ(cycles, checksums.size());
+  std::remove(file_name.c_str());
+}
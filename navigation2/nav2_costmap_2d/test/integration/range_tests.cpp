@@ -32,6 +32,7 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <cmath>
 #include <memory>
 #include <string>
 #include <algorithm>
@@ -108,6 +109,30 @@ public:
   }
 };
 
+// Exposes the sensor model and cone rasterization of the layer
+class TestRangeSensorLayer : public nav2_costmap_2d::RangeSensorLayer
+{
+public:
+  using RangeSensorLayer::sensor_model;
+  using RangeSensorLayer::cell_sensor_model;
+  using RangeSensorLayer::setMaxAngle;
+  using RangeSensorLayer::setCone;
+  using RangeSensorLayer::clipConeRow;
+
+  void setInflateCone(double inflate_cone)
+  {
+    inflate_cone_ = inflate_cone;
+  }
+
+  // The per-cell test clipConeRow tightens its spans with
+  bool insideCone(int x, int y)
+  {
+    return orient2d(cone_ax_, cone_ay_, cone_bx_, cone_by_, x, y) >= cone_threshold_ &&
+           orient2d(cone_bx_, cone_by_, cone_ox_, cone_oy_, x, y) >= cone_threshold_ &&
+           orient2d(cone_ox_, cone_oy_, cone_ax_, cone_ay_, x, y) >= cone_threshold_;
+  }
+};
+
 class TestNode : public ::testing::Test
 {
 public:
@@ -291,3 +316,64 @@ TEST_F(TestNode, testProbabalisticModelDownward) {
   ASSERT_EQ(layers.getCostmap()->getCost(3, 6), 0);
   ASSERT_EQ(layers.getCostmap()->getCost(3, 7), 254);
 }
+
+// The sensor model looked up in the gamma tables must match the analytic one
+TEST_F(TestNode, testTabulatedSensorModel) {
+  nav2_costmap_2d::LayeredCostmap layers("frame", false, false);
+  layers.resizeMap(100, 100, 0.05, 0, 0);
+
+  auto rlayer = std::make_shared<TestRangeSensorLayer>();
+  rlayer->initialize(&layers, "range", &tf_, node_, nullptr, nullptr);
+  layers.addPlugin(rlayer);
+
+  // Up to a half field of view of 80 degrees the tables are used, past it atan2
+  for (double field_of_view : {0.174533, 0.5, 1.0, 2.4, 3.0}) {
+    rlayer->setMaxAngle(field_of_view / 2);
+    for (double r : {0.3, 1.0, 2.5, 4.0}) {
+      for (int i = -20; i <= 20; ++i) {
+        for (int j = -20; j <= 20; ++j) {
+          double dx = i * r / 16, dy = j * r / 16, yaw = 0.1 * (i + 2 * j);
+          double cos_yaw = cos(yaw), sin_yaw = sin(yaw);
+          double theta = atan2(dy * cos_yaw - dx * sin_yaw, dx * cos_yaw + dy * sin_yaw);
+          EXPECT_NEAR(
+            rlayer->cell_sensor_model(dx, dy, cos_yaw, sin_yaw, r),
+            rlayer->sensor_model(r, hypot(dx, dy), theta), 1e-4);
+        }
+      }
+    }
+  }
+}
+
+// Each row span clipConeRow returns must hold exactly the cells of the row in the cone
+TEST_F(TestNode, testConeRowSpans) {
+  nav2_costmap_2d::LayeredCostmap layers("frame", false, false);
+  layers.resizeMap(10, 10, 1, 0, 0);
+
+  auto rlayer = std::make_shared<TestRangeSensorLayer>();
+  rlayer->initialize(&layers, "range", &tf_, node_, nullptr, nullptr);
+  layers.addPlugin(rlayer);
+
+  const int cones[][6] = {
+    {5, 5, 30, 2, 30, 9},
+    {20, 20, 0, 38, 3, 39},
+    {10, 0, 9, 30, 11, 30},
+    {0, 0, 39, 10, 10, 39},
+    {15, 15, 15, 15, 16, 15},
+    {30, 5, 2, 2, 2, 2},
+  };
+  for (double inflate_cone : {0.0, 0.3, 0.8}) {
+    rlayer->setInflateCone(inflate_cone);
+    for (const auto & c : cones) {
+      rlayer->setCone(c[0], c[1], c[2], c[3], c[4], c[5]);
+      for (int y = -2; y < 42; ++y) {
+        int x0 = -2, x1 = 41;
+        bool any = rlayer->clipConeRow(y, x0, x1);
+        for (int x = -2; x <= 41; ++x) {
+          EXPECT_EQ(rlayer->insideCone(x, y), any && x >= x0 && x <= x1) <<
+            "cell " << x << ", " << y << " of cone " << c[0] << " " << c[1] << " " <<
+            c[2] << " " << c[3] << " " << c[4] << " " << c[5];
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,221 @@
+// Copyright (c) 2020 Navigation2 contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/costmap_2d.hpp"
+
+using nav2_costmap_2d::MapLocation;
+
+std::vector<geometry_msgs::msg::Point> makePolygon(const std::vector<std::vector<double>> & xy)
+{
+  std::vector<geometry_msgs::msg::Point> polygon;
+  for (const auto & v : xy) {
+    geometry_msgs::msg::Point p;
+    p.x = v[0];
+    p.y = v[1];
+    polygon.push_back(p);
+  }
+  return polygon;
+}
+
+unsigned int countCells(const nav2_costmap_2d::Costmap2D & costmap, unsigned char value)
+{
+  unsigned int count = 0;
+  for (unsigned int y = 0; y < costmap.getSizeInCellsY(); y++) {
+    for (unsigned int x = 0; x < costmap.getSizeInCellsX(); x++) {
+      count += costmap.getCost(x, y) == value;
+    }
+  }
+  return count;
+}
+
+// The fill convexFillCells() used before row spans: the outline cells sorted by x,
+// then each column filled between its lowest and highest outline cell
+std::vector<MapLocation> columnFillCells(
+  nav2_costmap_2d::Costmap2D & costmap, const std::vector<MapLocation> & polygon)
+{
+  std::vector<MapLocation> polygon_cells;
+  costmap.polygonOutlineCells(polygon, polygon_cells);
+  std::stable_sort(
+    polygon_cells.begin(), polygon_cells.end(),
+    [](const MapLocation & a, const MapLocation & b) {return a.x < b.x;});
+
+  unsigned int i = 0;
+  const unsigned int num_outline = polygon_cells.size();
+  for (unsigned int x = polygon_cells[0].x; x <= polygon_cells[num_outline - 1].x; ++x) {
+    if (i >= num_outline - 1) {
+      break;
+    }
+    unsigned int min_y = std::min(polygon_cells[i].y, polygon_cells[i + 1].y);
+    unsigned int max_y = std::max(polygon_cells[i].y, polygon_cells[i + 1].y);
+    i += 2;
+    while (i < num_outline && polygon_cells[i].x == x) {
+      min_y = std::min(min_y, polygon_cells[i].y);
+      max_y = std::max(max_y, polygon_cells[i].y);
+      ++i;
+    }
+    for (unsigned int y = min_y; y < max_y; ++y) {
+      polygon_cells.push_back({x, y});
+    }
+  }
+  return polygon_cells;
+}
+
+// Counter-clockwise convex hull of some random cells, without collinear vertices
+std::vector<MapLocation> randomConvexPolygon(std::mt19937 & rng)
+{
+  std::uniform_int_distribution<unsigned int> num_points(3, 10);
+  std::uniform_int_distribution<unsigned int> extent(2, 60);
+  const unsigned int n = num_points(rng);
+  std::uniform_int_distribution<unsigned int> coordinate(10, 10 + extent(rng));
+  std::vector<MapLocation> points(n);
+  for (MapLocation & point : points) {
+    point = {coordinate(rng), coordinate(rng)};
+  }
+  std::sort(
+    points.begin(), points.end(), [](const MapLocation & a, const MapLocation & b) {
+      return a.x < b.x || (a.x == b.x && a.y < b.y);
+    });
+
+  auto turn = [](const MapLocation & o, const MapLocation & a, const MapLocation & b) {
+      return (static_cast<int>(a.x) - static_cast<int>(o.x)) *
+             (static_cast<int>(b.y) - static_cast<int>(o.y)) -
+             (static_cast<int>(a.y) - static_cast<int>(o.y)) *
+             (static_cast<int>(b.x) - static_cast<int>(o.x));
+    };
+  std::vector<MapLocation> hull(2 * n);
+  unsigned int k = 0;
+  for (unsigned int i = 0; i < n; ++i) {
+    while (k >= 2 && turn(hull[k - 2], hull[k - 1], points[i]) <= 0) {
+      --k;
+    }
+    hull[k++] = points[i];
+  }
+  for (int i = n - 2, lower = k + 1; i >= 0; --i) {
+    while (static_cast<int>(k) >= lower && turn(hull[k - 2], hull[k - 1], points[i]) <= 0) {
+      --k;
+    }
+    hull[k++] = points[i];
+  }
+  hull.resize(k - 1);
+  return hull;
+}
+
+TEST(costmap_polygon, test_convex_fill)
+{
+  nav2_costmap_2d::Costmap2D costmap(30, 30, 1.0, 0, 0, 0);
+  ASSERT_TRUE(
+    costmap.setConvexPolygonCost(
+      makePolygon({{10.2, 10.2}, {20.5, 10.2}, {20.5, 15.5}, {10.2, 15.5}}), 254));
+
+  // Cells 10..20 by 10..15, nothing else
+  EXPECT_EQ(countCells(costmap, 254), 66u);
+  EXPECT_EQ(costmap.getCost(10, 10), 254);
+  EXPECT_EQ(costmap.getCost(20, 15), 254);
+  EXPECT_EQ(costmap.getCost(21, 15), 0);
+  EXPECT_EQ(costmap.getCost(20, 16), 0);
+
+  // Polygons leaving the map are rejected without touching it
+  EXPECT_FALSE(
+    costmap.setConvexPolygonCost(makePolygon({{25, 25}, {35, 25}, {35, 35}}), 100));
+  EXPECT_EQ(countCells(costmap, 100), 0u);
+}
+
+TEST(costmap_polygon, test_non_convex_fill)
+{
+  nav2_costmap_2d::Costmap2D costmap(30, 30, 1.0, 0, 0, 0);
+  ASSERT_TRUE(
+    costmap.setConvexPolygonCost(
+      makePolygon({{2, 2}, {12, 2}, {12, 6}, {6, 6}, {6, 12}, {2, 12}}), 254));
+
+  // An L of 11 x 5 plus 5 x 6 cells; its notch stays free
+  EXPECT_EQ(countCells(costmap, 254), 85u);
+  EXPECT_EQ(costmap.getCost(4, 10), 254);
+  EXPECT_EQ(costmap.getCost(10, 4), 254);
+  EXPECT_EQ(costmap.getCost(9, 9), 0);
+  EXPECT_EQ(costmap.getCost(7, 7), 0);
+}
+
+TEST(costmap_polygon, test_rasterize_spans)
+{
+  nav2_costmap_2d::Costmap2D costmap(30, 30, 1.0, 0, 0, 0);
+  std::vector<MapLocation> polygon = {{2, 2}, {12, 2}, {12, 6}, {6, 6}, {6, 12}, {2, 12}};
+
+  // Spans come row by row, disjoint and sorted within a row
+  unsigned int cells = 0;
+  int last_y = -1;
+  unsigned int last_end = 0;
+  costmap.rasterizePolygon(
+    [&](unsigned int y, unsigned int x_begin, unsigned int x_end) {
+      EXPECT_LT(x_begin, x_end);
+      EXPECT_GE(static_cast<int>(y), last_y);
+      if (static_cast<int>(y) == last_y) {
+        EXPECT_GT(x_begin, last_end);
+      }
+      last_y = y;
+      last_end = x_end;
+      cells += x_end - x_begin;
+    }, polygon);
+  EXPECT_EQ(cells, 85u);
+
+  // The cell list matches the spans
+  std::vector<MapLocation> polygon_cells;
+  costmap.convexFillCells(polygon, polygon_cells);
+  EXPECT_EQ(polygon_cells.size(), 85u);
+
+  // Degenerate polygons cover nothing
+  polygon.resize(2);
+  polygon_cells.clear();
+  costmap.convexFillCells(polygon, polygon_cells);
+  EXPECT_TRUE(polygon_cells.empty());
+}
+
+TEST(costmap_polygon, test_matches_column_fill)
+{
+  nav2_costmap_2d::Costmap2D costmap(80, 80, 1.0, 0, 0, 0);
+  std::mt19937 rng(42);
+
+  // Convex polygons cover exactly the cells the column fill did, in either
+  // winding and starting from any vertex
+  unsigned int tested = 0;
+  while (tested < 2000) {
+    std::vector<MapLocation> polygon = randomConvexPolygon(rng);
+    if (polygon.size() < 3) {
+      continue;
+    }
+    if (tested % 2) {
+      std::reverse(polygon.begin(), polygon.end());
+    }
+    std::rotate(polygon.begin(), polygon.begin() + tested % polygon.size(), polygon.end());
+    ++tested;
+
+    std::set<std::pair<unsigned int, unsigned int>> expected, actual;
+    for (const MapLocation & cell : columnFillCells(costmap, polygon)) {
+      expected.insert({cell.x, cell.y});
+    }
+    costmap.rasterizePolygon(
+      [&actual](unsigned int y, unsigned int x_begin, unsigned int x_end) {
+        for (unsigned int x = x_begin; x < x_end; ++x) {
+          actual.insert({x, y});
+        }
+      }, polygon);
+    ASSERT_EQ(actual, expected) << "polygon " << tested;
+  }
+}
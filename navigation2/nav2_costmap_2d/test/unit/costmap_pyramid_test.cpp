@@ -0,0 +1,105 @@
+// Copyright (c) 2020 Navigation2 contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/costmap_pyramid.hpp"
+
+// Compare every cell of every level to the max over the block of costmap cells it covers
+void checkPyramid(
+  nav2_costmap_2d::Costmap2D & costmap, nav2_costmap_2d::CostmapPyramid & pyramid)
+{
+  const unsigned int size_x = costmap.getSizeInCellsX();
+  const unsigned int size_y = costmap.getSizeInCellsY();
+  for (unsigned int level = 1; level <= pyramid.getNumLevels(); level++) {
+    const unsigned int factor = 1u << level;
+    nav2_costmap_2d::Costmap2D * coarse = pyramid.getLevel(level);
+    ASSERT_EQ(coarse, pyramid.getLevelForFactor(factor));
+    ASSERT_EQ(coarse->getSizeInCellsX(), (size_x + factor - 1) / factor);
+    ASSERT_EQ(coarse->getSizeInCellsY(), (size_y + factor - 1) / factor);
+    EXPECT_DOUBLE_EQ(coarse->getResolution(), costmap.getResolution() * factor);
+
+    for (unsigned int j = 0; j < coarse->getSizeInCellsY(); j++) {
+      for (unsigned int i = 0; i < coarse->getSizeInCellsX(); i++) {
+        unsigned char expected = 0;
+        for (unsigned int y = j * factor; y < std::min(size_y, (j + 1) * factor); y++) {
+          for (unsigned int x = i * factor; x < std::min(size_x, (i + 1) * factor); x++) {
+            expected = std::max(expected, costmap.getCost(x, y));
+          }
+        }
+        ASSERT_EQ(coarse->getCost(i, j), expected) << "level " << level << " cell " << i <<
+          ", " << j;
+      }
+    }
+  }
+}
+
+TEST(costmap_pyramid, test_full_update)
+{
+  nav2_costmap_2d::Costmap2D costmap(37, 21, 0.05, 1.0, -2.0, 0);
+  for (unsigned int y = 0; y < 21; y++) {
+    for (unsigned int x = 0; x < 37; x++) {
+      costmap.setCost(x, y, (x * 7 + y * 13) % 255);
+    }
+  }
+
+  nav2_costmap_2d::CostmapPyramid pyramid(3);
+  pyramid.update(costmap, 0, 0, 0, 0);
+  checkPyramid(costmap, pyramid);
+  EXPECT_DOUBLE_EQ(pyramid.getLevel(3)->getOriginX(), 1.0);
+  EXPECT_DOUBLE_EQ(pyramid.getLevel(3)->getOriginY(), -2.0);
+
+  EXPECT_EQ(pyramid.getLevel(0), nullptr);
+  EXPECT_EQ(pyramid.getLevel(4), nullptr);
+  EXPECT_EQ(pyramid.getLevelForFactor(1), nullptr);
+  EXPECT_EQ(pyramid.getLevelForFactor(3), nullptr);
+  EXPECT_EQ(pyramid.getLevelForFactor(16), nullptr);
+}
+
+TEST(costmap_pyramid, test_window_update)
+{
+  nav2_costmap_2d::Costmap2D costmap(50, 50, 0.1, 0, 0, 0);
+  nav2_costmap_2d::CostmapPyramid pyramid(4);
+  pyramid.update(costmap, 0, 0, 50, 50);
+  checkPyramid(costmap, pyramid);
+
+  // Raise then lower costs inside a window, updating only that window
+  for (unsigned int y = 13; y < 29; y++) {
+    for (unsigned int x = 5; x < 12; x++) {
+      costmap.setCost(x, y, 254);
+    }
+  }
+  pyramid.update(costmap, 5, 13, 12, 29);
+  checkPyramid(costmap, pyramid);
+
+  for (unsigned int y = 20; y < 29; y++) {
+    for (unsigned int x = 5; x < 12; x++) {
+      costmap.setCost(x, y, 0);
+    }
+  }
+  pyramid.update(costmap, 5, 20, 12, 29);
+  checkPyramid(costmap, pyramid);
+
+  // A resize or an invalidation rebuilds all levels whatever the window
+  costmap.resizeMap(45, 31, 0.1, 0, 0);
+  costmap.setCost(44, 30, 100);
+  pyramid.update(costmap, 0, 0, 0, 0);
+  checkPyramid(costmap, pyramid);
+
+  costmap.setCost(0, 0, 200);
+  pyramid.invalidate();
+  pyramid.update(costmap, 0, 0, 0, 0);
+  checkPyramid(costmap, pyramid);
+}
@@ -0,0 +1,168 @@
+// Copyright (c) 2020 Navigation2 contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/costmap_recording.hpp"
+#include "sensor_msgs/point_cloud2_iterator.hpp"
+
+using nav2_costmap_2d::CostmapCycle;
+using nav2_costmap_2d::CostmapRecorder;
+using nav2_costmap_2d::CostmapReplay;
+using nav2_costmap_2d::Observation;
+
+Observation makeObservation(const std::vector<float> & xyz)
+{
+  sensor_msgs::msg::PointCloud2 cloud;
+  sensor_msgs::PointCloud2Modifier modifier(cloud);
+  modifier.setPointCloud2FieldsByString(1, "xyz");
+  modifier.resize(xyz.size() / 3);
+  sensor_msgs::PointCloud2Iterator<float> iter_x(cloud, "x");
+  sensor_msgs::PointCloud2Iterator<float> iter_y(cloud, "y");
+  sensor_msgs::PointCloud2Iterator<float> iter_z(cloud, "z");
+  for (size_t i = 0; i < xyz.size(); i += 3, ++iter_x, ++iter_y, ++iter_z) {
+    *iter_x = xyz[i];
+    *iter_y = xyz[i + 1];
+    *iter_z = xyz[i + 2];
+  }
+  geometry_msgs::msg::Point origin;
+  origin.x = 1.0;
+  origin.y = 2.0;
+  origin.z = 0.5;
+  return Observation(origin, cloud, 2.5, 3.0);
+}
+
+TEST(costmap_recording, test_round_trip)
+{
+  const std::string file_name = "test_costmap_recording.rec";
+  nav2_costmap_2d::Costmap2D costmap(20, 10, 0.05, -1.0, 2.0, 0);
+  costmap.setCost(3, 4, 254);
+
+  {
+    CostmapRecorder recorder(file_name, true, false);
+
+    geometry_msgs::msg::Point point;
+    point.x = 0.3;
+    recorder.writeFootprint({point, point, point});
+
+    nav_msgs::msg::OccupancyGrid map;
+    map.header.frame_id = "map";
+    map.info.width = 3;
+    map.info.height = 2;
+    map.info.resolution = 0.05f;
+    map.info.origin.position.x = -4.0;
+    map.info.origin.orientation.w = 1.0;
+    map.data = {0, 100, -1, 0, 50, 0};
+    recorder.writeMap("static_layer", map);
+
+    recorder.beginCycle(1.0, 2.0, 0.25);
+    recorder.writeObservations(
+      "obstacle_layer", nav2_costmap_2d::RECORD_MARKING_OBSERVATIONS,
+      {makeObservation({1, 2, 3, 4, 5, 6}), makeObservation({})});
+    recorder.writeObservations(
+      "obstacle_layer", nav2_costmap_2d::RECORD_CLEARING_OBSERVATIONS, {});
+    recorder.endCycle(costmap);
+
+    map_msgs::msg::OccupancyGridUpdate update;
+    update.header.frame_id = "map";
+    update.x = 1;
+    update.y = 1;
+    update.width = 2;
+    update.height = 1;
+    update.data = {100, 100};
+    recorder.writeMapUpdate("static_layer", update);
+    recorder.beginCycle(1.5, 2.0, 0.5);
+    recorder.endCycle(costmap);
+
+    // A cycle cut short, as when the recording node is killed
+    recorder.beginCycle(2.0, 2.0, 0.5);
+  }
+
+  CostmapReplay replay(file_name);
+  EXPECT_EQ(replay.getHeader().flags, nav2_costmap_2d::RECORDING_ROLLING_WINDOW);
+
+  CostmapCycle cycle;
+  ASSERT_TRUE(replay.readCycle(cycle));
+  EXPECT_DOUBLE_EQ(cycle.robot_x, 1.0);
+  EXPECT_DOUBLE_EQ(cycle.robot_yaw, 0.25);
+  EXPECT_TRUE(cycle.has_footprint);
+  ASSERT_EQ(cycle.footprint.size(), 3u);
+  EXPECT_DOUBLE_EQ(cycle.footprint[2].x, 0.3);
+  EXPECT_EQ(cycle.size_x, 20u);
+  EXPECT_EQ(cycle.size_y, 10u);
+  EXPECT_DOUBLE_EQ(cycle.origin_y, 2.0);
+  EXPECT_EQ(cycle.checksum, nav2_costmap_2d::costmapChecksum(costmap));
+
+  std::vector<Observation> observations;
+  EXPECT_TRUE(
+    cycle.getObservations(
+      "obstacle_layer", nav2_costmap_2d::RECORD_MARKING_OBSERVATIONS, observations));
+  ASSERT_EQ(observations.size(), 2u);
+  EXPECT_DOUBLE_EQ(observations[0].origin_.z, 0.5);
+  EXPECT_DOUBLE_EQ(observations[0].obstacle_range_, 2.5);
+  EXPECT_DOUBLE_EQ(observations[0].raytrace_range_, 3.0);
+  ASSERT_EQ(observations[0].cloud_->width, 2u);
+  sensor_msgs::PointCloud2ConstIterator<float> iter_z(*observations[0].cloud_, "z");
+  EXPECT_FLOAT_EQ(*iter_z, 3.0f);
+  EXPECT_FLOAT_EQ(*(iter_z + 1), 6.0f);
+  EXPECT_EQ(observations[1].cloud_->width, 0u);
+
+  observations.clear();
+  EXPECT_TRUE(
+    cycle.getObservations(
+      "obstacle_layer", nav2_costmap_2d::RECORD_CLEARING_OBSERVATIONS, observations));
+  EXPECT_TRUE(observations.empty());
+  EXPECT_FALSE(
+    cycle.getObservations(
+      "voxel_layer", nav2_costmap_2d::RECORD_MARKING_OBSERVATIONS, observations));
+
+  // The map arrived before the first cycle
+  ASSERT_EQ(cycle.records.size(), 3u);
+  EXPECT_EQ(cycle.records[0].type, nav2_costmap_2d::RECORD_MAP);
+  EXPECT_EQ(cycle.records[0].layer, "static_layer");
+  auto map = nav2_costmap_2d::decodeMap(cycle.records[0]);
+  EXPECT_EQ(map->header.frame_id, "map");
+  EXPECT_EQ(map->info.width, 3u);
+  EXPECT_DOUBLE_EQ(map->info.origin.position.x, -4.0);
+  EXPECT_EQ(map->data, std::vector<int8_t>({0, 100, -1, 0, 50, 0}));
+
+  ASSERT_TRUE(replay.readCycle(cycle));
+  EXPECT_DOUBLE_EQ(cycle.robot_x, 1.5);
+  EXPECT_FALSE(cycle.has_footprint);
+  ASSERT_EQ(cycle.records.size(), 1u);
+  auto update = nav2_costmap_2d::decodeMapUpdate(cycle.records[0]);
+  EXPECT_EQ(update->x, 1);
+  EXPECT_EQ(update->width, 2u);
+  EXPECT_EQ(update->data, std::vector<int8_t>({100, 100}));
+
+  EXPECT_FALSE(replay.readCycle(cycle));
+  std::remove(file_name.c_str());
+}
+
+TEST(costmap_recording, test_bad_file)
+{
+  EXPECT_THROW(CostmapReplay("no_such_costmap_recording.rec"), std::runtime_error);
+
+  const std::string file_name = "test_costmap_not_a_recording.rec";
+  {
+    std::ofstream file(file_name);
+    file << "not a costmap recording";
+  }
+  EXPECT_THROW(CostmapReplay replay(file_name), std::runtime_error);
+  std::remove(file_name.c_str());
+}
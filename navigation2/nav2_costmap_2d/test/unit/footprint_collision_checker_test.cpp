@@ -15,6 +15,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <random>
 
 #include "gtest/gtest.h"
 #include "nav2_costmap_2d/footprint_collision_checker.hpp"
@@ -156,3 +157,82 @@ TEST(collision_footprint, test_point_and_line_cost)
   auto right_value = collision_checker.footprintCostAtPose(5.2, 5.0, 0.0, footprint);
   EXPECT_NEAR(right_value, 254.0, 0.001);
 }
+
+TEST(collision_footprint, test_footprint_area_cost)
+{
+  std::shared_ptr<nav2_costmap_2d::Costmap2D> costmap_ =
+    std::make_shared<nav2_costmap_2d::Costmap2D>(100, 100, 0.10000, 0, 0.0, 0.0);
+
+  // Inside the footprint but away from its outline
+  costmap_->setCost(53, 50, 254);
+
+  geometry_msgs::msg::Point p1;
+  p1.x = -1.0;
+  p1.y = 1.0;
+  geometry_msgs::msg::Point p2;
+  p2.x = 1.0;
+  p2.y = 1.0;
+  geometry_msgs::msg::Point p3;
+  p3.x = 1.0;
+  p3.y = -1.0;
+  geometry_msgs::msg::Point p4;
+  p4.x = -1.0;
+  p4.y = -1.0;
+
+  nav2_costmap_2d::Footprint footprint = {p1, p2, p3, p4};
+
+  nav2_costmap_2d::FootprintCollisionChecker<std::shared_ptr<nav2_costmap_2d::Costmap2D>>
+  collision_checker(costmap_);
+
+  EXPECT_NEAR(collision_checker.footprintCostAtPose(5.0, 5.0, 0.0, footprint), 0.0, 0.001);
+  EXPECT_NEAR(collision_checker.footprintAreaCostAtPose(5.0, 5.0, 0.0, footprint), 254.0, 0.001);
+  EXPECT_NEAR(
+    collision_checker.footprintAreaCostAtPose(5.0, 5.0, M_PI / 4, footprint), 254.0, 0.001);
+
+  // A smaller footprint replaces the cached masks
+  for (auto & point : footprint) {
+    point.x *= 0.1;
+    point.y *= 0.1;
+  }
+  EXPECT_NEAR(collision_checker.footprintAreaCostAtPose(5.0, 5.0, 0.0, footprint), 0.0, 0.001);
+  EXPECT_NEAR(collision_checker.footprintAreaCostAtPose(5.3, 5.0, 0.0, footprint), 254.0, 0.001);
+
+  // Any footprint cell off the map is lethal
+  EXPECT_NEAR(collision_checker.footprintAreaCostAtPose(0.1, 5.0, 0.0, footprint), 254.0, 0.001);
+}
+
+TEST(collision_footprint, test_footprint_area_cost_bounds_outline_cost)
+{
+  std::shared_ptr<nav2_costmap_2d::Costmap2D> costmap_ =
+    std::make_shared<nav2_costmap_2d::Costmap2D>(200, 200, 0.05, -1.3, 0.7, 0);
+
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<unsigned int> cell(0, 199);
+  std::uniform_int_distribution<int> cost(1, 254);
+  for (int i = 0; i < 300; ++i) {
+    costmap_->setCost(cell(rng), cell(rng), cost(rng));
+  }
+
+  // An irregular pentagon, so no edge lines up with the grid
+  nav2_costmap_2d::Footprint footprint;
+  const std::vector<double> radii = {0.9, 0.45, 1.2, 0.6, 0.8};
+  for (unsigned int i = 0; i < radii.size(); ++i) {
+    geometry_msgs::msg::Point p;
+    p.x = radii[i] * cos(2.0 * M_PI * i / radii.size() + 0.2);
+    p.y = radii[i] * sin(2.0 * M_PI * i / radii.size() + 0.2);
+    footprint.push_back(p);
+  }
+
+  nav2_costmap_2d::FootprintCollisionChecker<std::shared_ptr<nav2_costmap_2d::Costmap2D>>
+  collision_checker(costmap_);
+
+  // Poses anywhere in a cell and a heading bin never score below the outline check
+  std::uniform_real_distribution<double> x(0.7, 7.4), y(2.7, 9.4), theta(-M_PI, M_PI);
+  for (int i = 0; i < 20000; ++i) {
+    const double px = x(rng), py = y(rng), pth = theta(rng);
+    ASSERT_GE(
+      collision_checker.footprintAreaCostAtPose(px, py, pth, footprint),
+      collision_checker.footprintCostAtPose(px, py, pth, footprint)) <<
+      "pose " << px << ", " << py << ", " << pth;
+  }
+}
@@ -0,0 +1,176 @@
+// Copyright (c) 2020 Navigation2 contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/observation_buffer.hpp"
+#include "nav2_util/lifecycle_node.hpp"
+#include "sensor_msgs/point_cloud2_iterator.hpp"
+
+using nav2_costmap_2d::Observation;
+using nav2_costmap_2d::ObservationBuffer;
+
+class RclCppFixture
+{
+public:
+  RclCppFixture() {rclcpp::init(0, nullptr);}
+  ~RclCppFixture() {rclcpp::shutdown();}
+};
+RclCppFixture g_rclcppfixture;
+
+// Exposes the ring so tests can stand in for a consumer that is mid-copy
+class TestObservationBuffer : public ObservationBuffer
+{
+public:
+  using ObservationBuffer::ObservationBuffer;
+
+  void pin(uint64_t seq) {reader_epoch_.store(seq);}
+  void unpin() {reader_epoch_.store(NO_READER);}
+  unsigned int dropped() const {return dropped_;}
+  size_t capacity() const {return slots_.size();}
+};
+
+class ObservationBufferTest : public ::testing::Test
+{
+protected:
+  ObservationBufferTest()
+  : node_(std::make_shared<nav2_util::LifecycleNode>("observation_buffer_test")),
+    tf_(node_->get_clock())
+  {
+    geometry_msgs::msg::TransformStamped transform;
+    transform.header.frame_id = "map";
+    transform.child_frame_id = "base_link";
+    transform.transform.translation.x = 1.0;
+    transform.transform.rotation.w = 1.0;
+    tf_.setTransform(transform, "observation_buffer_test", true);
+  }
+
+  std::shared_ptr<TestObservationBuffer> makeBuffer(
+    double keep_time, unsigned int capacity, double expected_update_rate = 0.0)
+  {
+    return std::make_shared<TestObservationBuffer>(
+      node_, "test", keep_time, expected_update_rate, 0.0, 2.0, 2.5, 3.0, tf_, "map", "",
+      0.1, capacity);
+  }
+
+  // A single point at x in base_link, which lands at x + 1 in the map
+  sensor_msgs::msg::PointCloud2 makeCloud(float x, const rclcpp::Time & stamp)
+  {
+    sensor_msgs::msg::PointCloud2 cloud;
+    cloud.header.frame_id = "base_link";
+    cloud.header.stamp = stamp;
+    sensor_msgs::PointCloud2Modifier modifier(cloud);
+    modifier.setPointCloud2FieldsByString(1, "xyz");
+    modifier.resize(1);
+    sensor_msgs::PointCloud2Iterator<float> iter_x(cloud, "x");
+    sensor_msgs::PointCloud2Iterator<float> iter_y(cloud, "y");
+    sensor_msgs::PointCloud2Iterator<float> iter_z(cloud, "z");
+    *iter_x = x;
+    *iter_y = 0.0;
+    *iter_z = 1.0;
+    return cloud;
+  }
+
+  // The base_link x of each observation returned, newest first
+  std::vector<float> observedXs(ObservationBuffer & buffer)
+  {
+    std::vector<Observation> observations;
+    buffer.getObservations(observations);
+    std::vector<float> xs;
+    for (const Observation & observation : observations) {
+      sensor_msgs::PointCloud2ConstIterator<float> iter_x(*observation.cloud_, "x");
+      xs.push_back(*iter_x - 1.0f);
+    }
+    return xs;
+  }
+
+  nav2_util::LifecycleNode::SharedPtr node_;
+  tf2_ros::Buffer tf_;
+};
+
+TEST_F(ObservationBufferTest, testWraparound)
+{
+  auto buffer = makeBuffer(100.0, 4);
+  ASSERT_EQ(buffer->capacity(), 4u);
+
+  for (int i = 0; i < 10; ++i) {
+    buffer->bufferCloud(makeCloud(i, node_->now()));
+  }
+  EXPECT_EQ(observedXs(*buffer), std::vector<float>({9, 8, 7, 6}));
+
+  // keep wrapping past the slots the consumer has already read
+  for (int i = 10; i < 13; ++i) {
+    buffer->bufferCloud(makeCloud(i, node_->now()));
+  }
+  EXPECT_EQ(observedXs(*buffer), std::vector<float>({12, 11, 10, 9}));
+  EXPECT_EQ(buffer->dropped(), 0u);
+}
+
+TEST_F(ObservationBufferTest, testReaderEpoch)
+{
+  auto buffer = makeBuffer(100.0, 4);
+  for (int i = 0; i < 4; ++i) {
+    buffer->bufferCloud(makeCloud(i, node_->now()));
+  }
+
+  // while the consumer is copying from the oldest slot, a new cloud would recycle it
+  buffer->pin(0);
+  buffer->bufferCloud(makeCloud(4, node_->now()));
+  EXPECT_EQ(buffer->dropped(), 1u);
+
+  // pinning a later slot lets the producer recycle the ones before it
+  buffer->pin(1);
+  buffer->bufferCloud(makeCloud(5, node_->now()));
+  EXPECT_EQ(buffer->dropped(), 1u);
+  buffer->unpin();
+
+  EXPECT_EQ(observedXs(*buffer), std::vector<float>({5, 3, 2, 1}));
+}
+
+TEST_F(ObservationBufferTest, testKeepTimeExpiry)
+{
+  auto buffer = makeBuffer(1.0, 8);
+  const rclcpp::Time now = node_->now();
+  buffer->bufferCloud(makeCloud(0, now - rclcpp::Duration::from_seconds(5.0)));
+  buffer->bufferCloud(makeCloud(1, now - rclcpp::Duration::from_seconds(2.0)));
+  buffer->bufferCloud(makeCloud(2, now));
+  EXPECT_EQ(observedXs(*buffer), std::vector<float>({2}));
+
+  // without persistence only the latest observation is kept
+  auto latest = makeBuffer(0.0, 8);
+  for (int i = 0; i < 3; ++i) {
+    latest->bufferCloud(makeCloud(i, node_->now()));
+  }
+  EXPECT_EQ(observedXs(*latest), std::vector<float>({2}));
+}
+
+TEST_F(ObservationBufferTest, testDerivedCapacity)
+{
+  EXPECT_EQ(ObservationBuffer::capacityFor(0.0, 0.1), 4u);
+  EXPECT_EQ(ObservationBuffer::capacityFor(5.0, 0.0), ObservationBuffer::DEFAULT_CAPACITY);
+  EXPECT_EQ(ObservationBuffer::capacityFor(1.0, 0.1), ObservationBuffer::DEFAULT_CAPACITY);
+  EXPECT_EQ(ObservationBuffer::capacityFor(10.0, 0.05), 402u);
+
+  // a buffer left to size itself keeps a full persistence window at the expected rate
+  auto buffer = makeBuffer(10.0, 0, 0.05);
+  EXPECT_EQ(buffer->capacity(), 402u);
+  const rclcpp::Time now = node_->now();
+  for (int i = 0; i < 200; ++i) {
+    buffer->bufferCloud(makeCloud(i, now - rclcpp::Duration::from_seconds((199 - i) * 0.05)));
+  }
+  EXPECT_EQ(observedXs(*buffer).size(), 200u);
+}
@@ -37,6 +37,7 @@
 
 #include <vector>
 #include "dwb_critics/base_obstacle.hpp"
+#include "nav2_costmap_2d/footprint_collision_checker.hpp"
 
 namespace dwb_critics
 {
@@ -56,11 +57,10 @@ Footprint getOrientedFootprint(
  * @class ObstacleFootprintCritic
  * @brief Uses costmap 2d to assign negative costs if robot footprint is in obstacle on any point of the trajectory.
  *
- * Internally, this technically only checks if the border of the footprint collides with anything for computational
- * efficiency. This is valid if the obstacles in the local costmap are inflated.
- *
- * A more robust class could check every cell within the robot's footprint without inflating the obstacles,
- * at some computational cost. That is left as an excercise to the reader.
+ * Every cell within the robot's footprint is checked, so obstacles need not be inflated. The footprint is
+ * rasterized once per discretized heading and the cells are reused for every pose while it stays the same.
+ * The cells cover the footprint's border anywhere in a pose's cell and heading bin, so a pose scores at
+ * least what checking the border alone would.
  */
 class ObstacleFootprintCritic : public BaseObstacleCritic
 {
@@ -94,6 +94,7 @@ protected:
   double pointCost(int x, int y);
 
   Footprint footprint_spec_;
+  nav2_costmap_2d::FootprintCollisionChecker<nav2_costmap_2d::Costmap2D *> collision_checker_;
 };
 }  // namespace dwb_critics
 
@@ -71,6 +71,7 @@ bool ObstacleFootprintCritic::prepare(
       "Footprint spec is empty, maybe missing call to setFootprint?");
     return false;
   }
+  collision_checker_.setCostmap(costmap_);
   return true;
 }
 
@@ -81,7 +82,18 @@ double ObstacleFootprintCritic::scorePose(const geometry_msgs::msg::Pose2D & pos
     throw dwb_core::
           IllegalTrajectoryException(name_, "Trajectory Goes Off Grid.");
   }
-  return scorePose(pose, getOrientedFootprint(pose, footprint_spec_));
+
+  // Cells off the grid score as lethal
+  const double footprint_cost = collision_checker_.footprintAreaCostAtPose(
+    pose.x, pose.y, pose.theta, footprint_spec_);
+  if (footprint_cost == nav2_costmap_2d::NO_INFORMATION) {
+    throw dwb_core::
+          IllegalTrajectoryException(name_, "Trajectory Hits Unknown Region.");
+  } else if (footprint_cost == nav2_costmap_2d::LETHAL_OBSTACLE) {
+    throw dwb_core::
+          IllegalTrajectoryException(name_, "Trajectory Hits Obstacle.");
+  }
+  return footprint_cost;
 }
 
 double ObstacleFootprintCritic::scorePose(
@@ -21,6 +21,7 @@
 #include <vector>
 
 #include "nav2_map_server/map_mode.hpp"
+#include "nav2_map_server/tiled_map.hpp"
 #include "nav_msgs/msg/occupancy_grid.hpp"
 
 /* Map input part */
@@ -76,6 +77,22 @@ LOAD_MAP_STATUS loadMapFromYaml(
   const std::string & yaml_file,
   nav_msgs::msg::OccupancyGrid & map);
 
+/**
+ * @brief Load the map YAML and its image as loadMapFromYaml() does, except that
+ * a tiled map image is opened into tiled_map rather than decoded: only the map
+ * metadata is filled and map.data is left empty, to be read with
+ * TiledMap::readCells() or TiledMap::readMap(). tiled_map is closed if the
+ * image is not a tiled map. If loading fails, map and tiled_map are left as they were.
+ * @param yaml_file Name of input YAML file
+ * @param map Output loaded map, without its cells if the image is a tiled map
+ * @param tiled_map Output opened tiled map
+ * @return status of map loaded
+ */
+LOAD_MAP_STATUS loadMapFromYaml(
+  const std::string & yaml_file,
+  nav_msgs::msg::OccupancyGrid & map,
+  TiledMap & tiled_map);
+
 
 /* Map output part */
 
@@ -24,6 +24,8 @@
 #include "nav_msgs/msg/occupancy_grid.hpp"
 #include "nav_msgs/srv/get_map.hpp"
 #include "nav2_msgs/srv/load_map.hpp"
+#include "nav2_msgs/srv/get_map_region.hpp"
+#include "nav2_map_server/tiled_map.hpp"
 
 namespace nav2_map_server
 {
@@ -106,6 +108,28 @@ protected:
     const std::shared_ptr<nav_msgs::srv::GetMap::Request> request,
     std::shared_ptr<nav_msgs::srv::GetMap::Response> response);
 
+  /**
+   * @brief Map region getting service callback
+   * @param request_header Service request header
+   * @param request Service request
+   * @param response Service response
+   */
+  void getMapRegionCallback(
+    const std::shared_ptr<rmw_request_id_t> request_header,
+    const std::shared_ptr<nav2_msgs::srv::GetMapRegion::Request> request,
+    std::shared_ptr<nav2_msgs::srv::GetMapRegion::Response> response);
+
+  /**
+   * @brief Copy the cells of the map touched by a box in the map frame, read
+   * from the tiled map if one is loaded, otherwise from msg_
+   * @param min_x, min_y, max_x, max_y Box corners in the map frame
+   * @param region Output map covering the box, clipped to the map
+   * @return false if the box does not overlap the map
+   */
+  bool getMapRegion(
+    double min_x, double min_y, double max_x, double max_y,
+    nav_msgs::msg::OccupancyGrid & region);
+
   /**
    * @brief Map loading service callback
    * @param request_header Service request header
@@ -123,20 +147,33 @@ protected:
   // The name of the service for loading a map
   const std::string load_map_service_name_{"load_map"};
 
+  // The name of the service for getting a part of the map
+  const std::string map_region_service_name_{"map_region"};
+
   // A service to provide the occupancy grid (GetMap) and the message to return
   rclcpp::Service<nav_msgs::srv::GetMap>::SharedPtr occ_service_;
 
   // A service to load the occupancy grid from file at run time (LoadMap)
   rclcpp::Service<nav2_msgs::srv::LoadMap>::SharedPtr load_map_service_;
 
+  // A service to provide a part of the occupancy grid (GetMapRegion)
+  rclcpp::Service<nav2_msgs::srv::GetMapRegion>::SharedPtr map_region_service_;
+
   // A topic on which the occupancy grid will be published
   rclcpp_lifecycle::LifecyclePublisher<nav_msgs::msg::OccupancyGrid>::SharedPtr occ_pub_;
 
   // The frame ID used in the returned OccupancyGrid message
   std::string frame_id_;
 
-  // The message to publish on the occupancy grid topic
+  // The message to publish on the occupancy grid topic. With a tiled map and
+  // publish_full_map_ false, it holds only the map metadata.
   nav_msgs::msg::OccupancyGrid msg_;
+
+  // The tiled map the map region service reads from, when the loaded map is one
+  TiledMap tiled_map_;
+
+  // Whether to decode the whole map to publish it and serve the map service
+  bool publish_full_map_;
 };
 
 }  // namespace nav2_map_server
@@ -0,0 +1,159 @@
+// Copyright (c) 2020 Navigation2 contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/* Memory-mapped tiled map format */
+
+#ifndef NAV2_MAP_SERVER__TILED_MAP_HPP_
+#define NAV2_MAP_SERVER__TILED_MAP_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "nav_msgs/msg/occupancy_grid.hpp"
+
+namespace nav2_map_server
+{
+
+/*
+ * A tiled map file stores occupancy values (-1..100) exactly as they appear in an
+ * OccupancyGrid, cut into square tiles so that any region can be read without
+ * touching the rest of the file. Layout, in host (little-endian) byte order:
+ *
+ *   TiledMapHeader
+ *   TiledMapTileEntry[tiles_x * tiles_y]   tile index, row-major from the bottom-left tile
+ *   tile data                              each tile row-major, clipped at the map border
+ *
+ * A tile is either stored raw or run-length encoded as (count, value) byte pairs,
+ * whichever is smaller.
+ */
+
+/// File extension recognized by the map loader and saver
+const char TILED_MAP_EXTENSION[] = "tmap";
+
+const uint32_t TILED_MAP_VERSION = 1;
+
+struct TiledMapHeader
+{
+  char magic[4];          ///< "N2TM"
+  uint32_t version;
+  uint32_t width;         ///< Map width in cells
+  uint32_t height;        ///< Map height in cells
+  uint32_t tile_size;     ///< Tile side in cells
+  uint32_t reserved;
+  double resolution;
+  double origin[3];       ///< x, y, yaw
+};
+
+enum TileEncoding : uint32_t
+{
+  TILE_RAW = 0,
+  TILE_RLE = 1
+};
+
+struct TiledMapTileEntry
+{
+  uint64_t offset;        ///< Byte offset of the tile data from the start of the file
+  uint32_t size;          ///< Size of the tile data in bytes
+  uint32_t encoding;      ///< TileEncoding
+};
+
+/**
+ * @class nav2_map_server::TiledMap
+ * @brief Read-only view of a tiled map file. The file is memory-mapped, so opening
+ * it costs only the header and index checks and regions read touch only their tiles.
+ */
+class TiledMap
+{
+public:
+  TiledMap();
+  ~TiledMap();
+
+  TiledMap(const TiledMap &) = delete;
+  TiledMap & operator=(const TiledMap &) = delete;
+
+  /**
+   * @brief Map the file and check its header and tile index
+   * @param file_name Name of the tiled map file
+   * @throw std::runtime_error if the file can not be mapped or is malformed
+   */
+  void open(const std::string & file_name);
+
+  /**
+   * @brief Unmap the file, if any
+   */
+  void close();
+
+  /**
+   * @brief Exchange the files held by two tiled maps
+   */
+  void swap(TiledMap & other);
+
+  bool isOpen() const {return data_ != nullptr;}
+
+  const TiledMapHeader & getHeader() const {return header_;}
+
+  unsigned int getWidth() const {return header_.width;}
+  unsigned int getHeight() const {return header_.height;}
+  unsigned int getTileSize() const {return header_.tile_size;}
+
+  /**
+   * @brief Copy the cells of [x0, x0 + width) x [y0, y0 + height) into out,
+   * row-major with a stride of width. The region must lie inside the map.
+   * @throw std::runtime_error if a tile is corrupt
+   */
+  void readCells(
+    unsigned int x0, unsigned int y0, unsigned int width, unsigned int height,
+    int8_t * out) const;
+
+  /**
+   * @brief Copy the whole map into map.data and fill its size
+   * @throw std::runtime_error if a tile is corrupt
+   */
+  void readMap(nav_msgs::msg::OccupancyGrid & map) const;
+
+private:
+  /// Decode a tile into out, row-major with its own width as stride
+  bool decodeTile(unsigned int tile_index, int8_t * out, size_t cells) const;
+
+  TiledMapHeader header_;
+  unsigned int tiles_x_, tiles_y_;
+  std::vector<TiledMapTileEntry> index_;
+
+  const unsigned char * data_;
+  size_t size_;
+  std::vector<unsigned char> buffer_;  ///< File contents where mmap is unavailable
+};
+
+/**
+ * @brief Write an OccupancyGrid into a tiled map file
+ * @param map Map to write
+ * @param file_name Name of the output file
+ * @param tile_size Tile side in cells
+ * @throw std::runtime_error in case of a write failure
+ */
+void saveMapToTiledFile(
+  const nav_msgs::msg::OccupancyGrid & map,
+  const std::string & file_name,
+  unsigned int tile_size = 256);
+
+/**
+ * @brief Whether a file name carries the tiled map extension
+ */
+bool isTiledMapFile(const std::string & file_name);
+
+}  // namespace nav2_map_server
+
+#endif  // NAV2_MAP_SERVER__TILED_MAP_HPP_
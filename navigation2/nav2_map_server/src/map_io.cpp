@@ -34,13 +34,21 @@
 #ifndef _WIN32
 #include <libgen.h>
 #endif
+#include <omp.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 #include <fstream>
 #include <stdexcept>
 
 #include "Magick++.h"
+#include "nav2_map_server/tiled_map.hpp"
 #include "nav2_util/geometry_utils.hpp"
 
 #include "yaml-cpp/yaml.h"
@@ -161,94 +169,146 @@ LoadParameters loadMapYaml(const std::string & yaml_filename)
   return load_parameters;
 }
 
-void loadMapFromFile(
+/// Occupancy value of a pixel from the sum of its averaged channels
+/// (pixel transparency in Scale mode is handled separately)
+static int8_t occupancyFromChannelSum(
+  const LoadParameters & load_parameters, unsigned long channel_sum,  // NOLINT
+  unsigned int num_channels)
+{
+  /// on a scale from 0.0 to 1.0 how bright is the pixel?
+  double shade = Magick::ColorGray::scaleQuantumToDouble(
+    static_cast<double>(channel_sum) / num_channels);
+
+  // If negate is true, we consider blacker pixels free, and whiter
+  // pixels occupied. Otherwise, it's vice versa.
+  /// on a scale from 0.0 to 1.0, how occupied is the map cell (before thresholding)?
+  double occ = (load_parameters.negate ? shade : 1.0 - shade);
+
+  switch (load_parameters.mode) {
+    case MapMode::Trinary:
+      if (load_parameters.occupied_thresh < occ) {
+        return 100;
+      } else if (occ < load_parameters.free_thresh) {
+        return 0;
+      }
+      return -1;
+    case MapMode::Scale:
+      if (load_parameters.occupied_thresh < occ) {
+        return 100;
+      } else if (occ < load_parameters.free_thresh) {
+        return 0;
+      }
+      return static_cast<int8_t>(
+        std::rint(
+          (occ - load_parameters.free_thresh) /
+          (load_parameters.occupied_thresh - load_parameters.free_thresh) * 100.0));
+    case MapMode::Raw: {
+        double occ_percent = std::round(shade * 255);
+        if (0 <= occ_percent && occ_percent <= 100) {
+          return static_cast<int8_t>(occ_percent);
+        }
+        return -1;
+      }
+    default:
+      throw std::runtime_error("Invalid map mode");
+  }
+}
+
+/// Read the occupancy values of an image into msg.data, setting its size
+static void loadImageData(
   const LoadParameters & load_parameters,
-  nav_msgs::msg::OccupancyGrid & map)
+  nav_msgs::msg::OccupancyGrid & msg)
 {
   Magick::InitializeMagick(nullptr);
-  nav_msgs::msg::OccupancyGrid msg;
-
-  std::cout << "[INFO] [map_io]: Loading image_file: " <<
-    load_parameters.image_file_name << std::endl;
   Magick::Image img(load_parameters.image_file_name);
 
   // Copy the image data into the map structure
   msg.info.width = img.size().width();
   msg.info.height = img.size().height();
 
-  msg.info.resolution = load_parameters.resolution;
-  msg.info.origin.position.x = load_parameters.origin[0];
-  msg.info.origin.position.y = load_parameters.origin[1];
-  msg.info.origin.position.z = 0.0;
-  msg.info.origin.orientation = orientationAroundZAxis(load_parameters.origin[2]);
-
   // Allocate space to hold the data
   msg.data.resize(msg.info.width * msg.info.height);
 
-  // Copy pixel data into the map structure
-  for (size_t y = 0; y < msg.info.height; y++) {
-    for (size_t x = 0; x < msg.info.width; x++) {
-      auto pixel = img.pixelColor(x, y);
-
-      std::vector<Magick::Quantum> channels = {pixel.redQuantum(), pixel.greenQuantum(),
-        pixel.blueQuantum()};
-      if (load_parameters.mode == MapMode::Trinary && img.matte()) {
-        // To preserve existing behavior, average in alpha with color channels in Trinary mode.
-        // CAREFUL. alpha is inverted from what you might expect. High = transparent, low = opaque
-        channels.push_back(MaxRGB - pixel.alphaQuantum());
-      }
-      double sum = 0;
-      for (auto c : channels) {
-        sum += c;
+  // To preserve existing behavior, average in alpha with color channels in Trinary mode.
+  const bool average_alpha = load_parameters.mode == MapMode::Trinary && img.matte();
+  const unsigned int num_channels = average_alpha ? 4 : 3;
+
+  // A pixel's occupancy only depends on its channel sum, so tabulate it for
+  // every possible sum when the quantum depth keeps the table small
+  const unsigned long max_channel_sum =  // NOLINT
+    static_cast<unsigned long>(MaxRGB) * num_channels;  // NOLINT
+  std::vector<int8_t> occupancy_table;
+  if (max_channel_sum < (1ul << 20)) {
+    occupancy_table.resize(max_channel_sum + 1);
+    for (unsigned long sum = 0; sum <= max_channel_sum; sum++) {  // NOLINT
+      occupancy_table[sum] = occupancyFromChannelSum(load_parameters, sum, num_channels);
+    }
+  } else {
+    // Throw on an invalid mode here rather than from the parallel loop
+    occupancyFromChannelSum(load_parameters, 0, num_channels);
+  }
+
+  // Decode rows in parallel, each thread through its own pixel cache view
+  const int width = static_cast<int>(msg.info.width);
+  const int height = static_cast<int>(msg.info.height);
+  const int num_threads = std::max(1, std::min(omp_get_max_threads(), height));
+  std::vector<std::unique_ptr<Magick::Pixels>> views;
+  for (int i = 0; i < num_threads; i++) {
+    views.emplace_back(new Magick::Pixels(img));
+  }
+  std::atomic<bool> read_failed(false);
+
+  #pragma omp parallel for num_threads(num_threads) schedule(static)
+  for (int y = 0; y < height; y++) {
+    if (read_failed.load(std::memory_order_relaxed)) {
+      continue;
+    }
+    const Magick::PixelPacket * row = nullptr;
+    try {
+      row = views[omp_get_thread_num()]->getConst(0, y, width, 1);
+    } catch (...) {
+    }
+    if (!row) {
+      read_failed = true;
+      continue;
+    }
+
+    int8_t * map_row = &msg.data[msg.info.width * (msg.info.height - y - 1)];
+    for (int x = 0; x < width; x++) {
+      const Magick::PixelPacket & pixel = row[x];
+      // CAREFUL. alpha is inverted from what you might expect. High = transparent, low = opaque
+      unsigned long sum =  // NOLINT
+        static_cast<unsigned long>(pixel.red) + pixel.green + pixel.blue;  // NOLINT
+      if (average_alpha) {
+        sum += MaxRGB - pixel.opacity;
       }
-      /// on a scale from 0.0 to 1.0 how bright is the pixel?
-      double shade = Magick::ColorGray::scaleQuantumToDouble(sum / channels.size());
-
-      // If negate is true, we consider blacker pixels free, and whiter
-      // pixels occupied. Otherwise, it's vice versa.
-      /// on a scale from 0.0 to 1.0, how occupied is the map cell (before thresholding)?
-      double occ = (load_parameters.negate ? shade : 1.0 - shade);
-
-      int8_t map_cell;
-      switch (load_parameters.mode) {
-        case MapMode::Trinary:
-          if (load_parameters.occupied_thresh < occ) {
-            map_cell = 100;
-          } else if (occ < load_parameters.free_thresh) {
-            map_cell = 0;
-          } else {
-            map_cell = -1;
-          }
-          break;
-        case MapMode::Scale:
-          if (pixel.alphaQuantum() != OpaqueOpacity) {
-            map_cell = -1;
-          } else if (load_parameters.occupied_thresh < occ) {
-            map_cell = 100;
-          } else if (occ < load_parameters.free_thresh) {
-            map_cell = 0;
-          } else {
-            map_cell = std::rint(
-              (occ - load_parameters.free_thresh) /
-              (load_parameters.occupied_thresh - load_parameters.free_thresh) * 100.0);
-          }
-          break;
-        case MapMode::Raw: {
-            double occ_percent = std::round(shade * 255);
-            if (0 <= occ_percent && occ_percent <= 100) {
-              map_cell = static_cast<int8_t>(occ_percent);
-            } else {
-              map_cell = -1;
-            }
-            break;
-          }
-        default:
-          throw std::runtime_error("Invalid map mode");
+
+      if (load_parameters.mode == MapMode::Scale && pixel.opacity != OpaqueOpacity) {
+        map_row[x] = -1;
+      } else if (!occupancy_table.empty()) {
+        map_row[x] = occupancy_table[sum];
+      } else {
+        map_row[x] = occupancyFromChannelSum(load_parameters, sum, num_channels);
       }
-      msg.data[msg.info.width * (msg.info.height - y - 1) + x] = map_cell;
     }
   }
 
+  if (read_failed) {
+    throw std::runtime_error("Failed to read pixels of " + load_parameters.image_file_name);
+  }
+}
+
+/// Fill the metadata of a map loaded with the parameters of its YAML
+static void fillMapInfo(
+  const LoadParameters & load_parameters,
+  nav_msgs::msg::OccupancyGrid & msg)
+{
+  msg.info.resolution = load_parameters.resolution;
+  msg.info.origin.position.x = load_parameters.origin[0];
+  msg.info.origin.position.y = load_parameters.origin[1];
+  msg.info.origin.position.z = 0.0;
+  msg.info.origin.orientation = orientationAroundZAxis(load_parameters.origin[2]);
+
   // Since loadMapFromFile() does not belong to any node, publishing in a system time.
   rclcpp::Clock clock(RCL_SYSTEM_TIME);
   msg.info.map_load_time = clock.now();
@@ -258,13 +318,61 @@ void loadMapFromFile(
   std::cout <<
     "[DEBUG] [map_io]: Read map " << load_parameters.image_file_name << ": " << msg.info.width <<
     " X " << msg.info.height << " map @ " << msg.info.resolution << " m/cell" << std::endl;
+}
+
+void loadMapFromFile(
+  const LoadParameters & load_parameters,
+  nav_msgs::msg::OccupancyGrid & map)
+{
+  nav_msgs::msg::OccupancyGrid msg;
+
+  std::cout << "[INFO] [map_io]: Loading image_file: " <<
+    load_parameters.image_file_name << std::endl;
+  if (isTiledMapFile(load_parameters.image_file_name)) {
+    // Tiled maps already hold occupancy values; mode and thresholds do not apply
+    TiledMap tiled_map;
+    tiled_map.open(load_parameters.image_file_name);
+    tiled_map.readMap(msg);
+  } else {
+    loadImageData(load_parameters, msg);
+  }
+  fillMapInfo(load_parameters, msg);
 
   map = msg;
 }
 
-LOAD_MAP_STATUS loadMapFromYaml(
+/// Open a tiled map image, filling only the map metadata, or load any other image.
+/// map and tiled_map are left untouched unless the new image loads.
+static void loadMapFromFile(
+  const LoadParameters & load_parameters,
+  nav_msgs::msg::OccupancyGrid & map,
+  TiledMap & tiled_map)
+{
+  if (!isTiledMapFile(load_parameters.image_file_name)) {
+    loadMapFromFile(load_parameters, map);
+    tiled_map.close();
+    return;
+  }
+
+  std::cout << "[INFO] [map_io]: Opening tiled image_file: " <<
+    load_parameters.image_file_name << std::endl;
+  TiledMap opened;
+  opened.open(load_parameters.image_file_name);
+
+  nav_msgs::msg::OccupancyGrid msg;
+  msg.info.width = opened.getWidth();
+  msg.info.height = opened.getHeight();
+  fillMapInfo(load_parameters, msg);
+
+  map = msg;
+  tiled_map.swap(opened);
+}
+
+/// loadMapFromYaml(), opening tiled map images into tiled_map if it is given
+static LOAD_MAP_STATUS loadMapFromYaml(
   const std::string & yaml_file,
-  nav_msgs::msg::OccupancyGrid & map)
+  nav_msgs::msg::OccupancyGrid & map,
+  TiledMap * tiled_map)
 {
   if (yaml_file.empty()) {
     std::cerr << "[ERROR] [map_io]: YAML file name is empty, can't load!" << std::endl;
@@ -287,7 +395,11 @@ LOAD_MAP_STATUS loadMapFromYaml(
   }
 
   try {
-    loadMapFromFile(load_parameters, map);
+    if (tiled_map) {
+      loadMapFromFile(load_parameters, map, *tiled_map);
+    } else {
+      loadMapFromFile(load_parameters, map);
+    }
   } catch (std::exception & e) {
     std::cerr <<
       "[ERROR] [map_io]: Failed to load image file " << load_parameters.image_file_name <<
@@ -298,6 +410,21 @@ LOAD_MAP_STATUS loadMapFromYaml(
   return LOAD_MAP_SUCCESS;
 }
 
+LOAD_MAP_STATUS loadMapFromYaml(
+  const std::string & yaml_file,
+  nav_msgs::msg::OccupancyGrid & map)
+{
+  return loadMapFromYaml(yaml_file, map, nullptr);
+}
+
+LOAD_MAP_STATUS loadMapFromYaml(
+  const std::string & yaml_file,
+  nav_msgs::msg::OccupancyGrid & map,
+  TiledMap & tiled_map)
+{
+  return loadMapFromYaml(yaml_file, map, &tiled_map);
+}
+
 // === Map output part ===
 
 /**
@@ -358,6 +485,11 @@ void checkSaveParameters(SaveParameters & save_parameters)
     save_parameters.image_format.begin(),
     [](unsigned char c) {return std::tolower(c);});
 
+  // Tiled maps are written without Magick and store occupancy values as they are
+  if (save_parameters.image_format == TILED_MAP_EXTENSION) {
+    return;
+  }
+
   const std::vector<std::string> BLESSED_FORMATS{"bmp", "pgm", "png"};
   if (
     std::find(BLESSED_FORMATS.begin(), BLESSED_FORMATS.end(), save_parameters.image_format) ==
@@ -407,6 +539,56 @@ void checkSaveParameters(SaveParameters & save_parameters)
   }
 }
 
+/**
+ * @brief Gray level and alpha of the pixel saved for an occupancy value
+ * @param save_parameters Map saving parameters
+ * @param map_cell Occupancy value
+ * @param gray Output gray level
+ * @param alpha Output alpha, only meaningful in Scale mode
+ * @throw std::expection in case of invalid map mode
+ */
+static void pixelFromOccupancy(
+  const SaveParameters & save_parameters, int8_t map_cell,
+  unsigned char & gray, unsigned char & alpha)
+{
+  int free_thresh_int = std::rint(save_parameters.free_thresh * 100.0);
+  int occupied_thresh_int = std::rint(save_parameters.occupied_thresh * 100.0);
+
+  alpha = 255;
+  switch (save_parameters.mode) {
+    case MapMode::Trinary:
+      if (map_cell < 0 || 100 < map_cell) {
+        gray = 205;
+      } else if (map_cell <= free_thresh_int) {
+        gray = 254;
+      } else if (occupied_thresh_int <= map_cell) {
+        gray = 0;
+      } else {
+        gray = 205;
+      }
+      break;
+    case MapMode::Scale:
+      // Gray levels truncate, as Magick::ColorGray did when it wrote these pixels
+      if (map_cell < 0 || 100 < map_cell) {
+        gray = 127;
+        alpha = 0;
+      } else {
+        gray = static_cast<unsigned char>((100.0 - map_cell) / 100.0 * 255.0);
+      }
+      break;
+    case MapMode::Raw:
+      if (map_cell < 0 || 100 < map_cell) {
+        gray = 255;
+      } else {
+        gray = static_cast<unsigned char>(map_cell);
+      }
+      break;
+    default:
+      std::cerr << "[ERROR] [map_io]: Map mode should be Trinary, Scale or Raw" << std::endl;
+      throw std::runtime_error("Invalid map mode");
+  }
+}
+
 /**
  * @brief Tries to write map data into a file
  * @param map Occupancy grid data
@@ -421,69 +603,70 @@ void tryWriteMapToFile(
     "[INFO] [map_io]: Received a " << map.info.width << " X " << map.info.height << " map @ " <<
     map.info.resolution << " m/pix" << std::endl;
 
+  if (map.data.size() < static_cast<size_t>(map.info.width) * map.info.height) {
+    throw std::runtime_error("Map data is smaller than its size");
+  }
+
   std::string mapdatafile = save_parameters.map_file_name + "." + save_parameters.image_format;
-  {
-    // should never see this color, so the initialization value is just for debugging
-    Magick::Image image({map.info.width, map.info.height}, "red");
+  if (save_parameters.image_format == TILED_MAP_EXTENSION) {
+    std::cout << "[INFO] [map_io]: Writing tiled map data to " << mapdatafile << std::endl;
+    saveMapToTiledFile(map, mapdatafile);
+  } else {
+    // Since we only need to support 100 different pixel levels, 8 bits is fine.
+    // Every occupancy value maps to a fixed pixel, so tabulate them all once.
+    std::array<unsigned char, 256> gray_table, alpha_table;
+    for (int value = -128; value < 128; value++) {
+      pixelFromOccupancy(
+        save_parameters, static_cast<int8_t>(value),
+        gray_table[static_cast<uint8_t>(value)], alpha_table[static_cast<uint8_t>(value)]);
+    }
 
     // In scale mode, we need the alpha (matte) channel. Else, we don't.
-    // NOTE: GraphicsMagick seems to have trouble loading the alpha channel when saved with
-    // Magick::GreyscaleMatte, so we use TrueColorMatte instead.
-    image.type(
-      save_parameters.mode == MapMode::Scale ?
-      Magick::TrueColorMatteType : Magick::GrayscaleType);
-
-    // Since we only need to support 100 different pixel levels, 8 bits is fine
-    image.depth(8);
-
-    int free_thresh_int = std::rint(save_parameters.free_thresh * 100.0);
-    int occupied_thresh_int = std::rint(save_parameters.occupied_thresh * 100.0);
-
-    for (size_t y = 0; y < map.info.height; y++) {
-      for (size_t x = 0; x < map.info.width; x++) {
-        int8_t map_cell = map.data[map.info.width * (map.info.height - y - 1) + x];
-
-        Magick::Color pixel;
-
-        switch (save_parameters.mode) {
-          case MapMode::Trinary:
-            if (map_cell < 0 || 100 < map_cell) {
-              pixel = Magick::ColorGray(205 / 255.0);
-            } else if (map_cell <= free_thresh_int) {
-              pixel = Magick::ColorGray(254 / 255.0);
-            } else if (occupied_thresh_int <= map_cell) {
-              pixel = Magick::ColorGray(0 / 255.0);
-            } else {
-              pixel = Magick::ColorGray(205 / 255.0);
-            }
-            break;
-          case MapMode::Scale:
-            if (map_cell < 0 || 100 < map_cell) {
-              pixel = Magick::ColorGray{0.5};
-              pixel.alphaQuantum(TransparentOpacity);
-            } else {
-              pixel = Magick::ColorGray{(100.0 - map_cell) / 100.0};
-            }
-            break;
-          case MapMode::Raw:
-            Magick::Quantum q;
-            if (map_cell < 0 || 100 < map_cell) {
-              q = MaxRGB;
-            } else {
-              q = map_cell / 255.0 * MaxRGB;
-            }
-            pixel = Magick::Color(q, q, q);
-            break;
-          default:
-            std::cerr << "[ERROR] [map_io]: Map mode should be Trinary, Scale or Raw" << std::endl;
-            throw std::runtime_error("Invalid map mode");
+    const bool with_alpha = save_parameters.mode == MapMode::Scale;
+    const size_t channels = with_alpha ? 4 : 1;
+    const int width = static_cast<int>(map.info.width);
+    const int height = static_cast<int>(map.info.height);
+
+    // Image rows run top-down, map rows bottom-up
+    std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * channels);
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; y++) {
+      const int8_t * map_row = &map.data[static_cast<size_t>(width) * (height - y - 1)];
+      unsigned char * out = &pixels[static_cast<size_t>(width) * y * channels];
+      if (with_alpha) {
+        for (int x = 0; x < width; x++) {
+          const uint8_t value = static_cast<uint8_t>(map_row[x]);
+          out[4 * x] = out[4 * x + 1] = out[4 * x + 2] = gray_table[value];
+          out[4 * x + 3] = alpha_table[value];
+        }
+      } else {
+        for (int x = 0; x < width; x++) {
+          out[x] = gray_table[static_cast<uint8_t>(map_row[x])];
         }
-        image.pixelColor(x, y, pixel);
       }
     }
 
     std::cout << "[INFO] [map_io]: Writing map occupancy data to " << mapdatafile << std::endl;
-    image.write(mapdatafile);
+    if (save_parameters.image_format == "pgm" && !with_alpha) {
+      // Binary PGM is just a header followed by the gray levels, no encoder needed
+      std::ofstream pgm(mapdatafile, std::ios::binary | std::ios::trunc);
+      pgm << "P5\n" << width << " " << height << "\n255\n";
+      pgm.write(reinterpret_cast<const char *>(pixels.data()), pixels.size());
+      if (!pgm) {
+        throw std::runtime_error("Failed to write " + mapdatafile);
+      }
+    } else {
+      Magick::Image image;
+      image.read(
+        map.info.width, map.info.height, with_alpha ? "RGBA" : "I", Magick::CharPixel,
+        pixels.data());
+
+      // NOTE: GraphicsMagick seems to have trouble loading the alpha channel when saved with
+      // Magick::GreyscaleMatte, so we use TrueColorMatte instead.
+      image.type(with_alpha ? Magick::TrueColorMatteType : Magick::GrayscaleType);
+      image.depth(8);
+      image.write(mapdatafile);
+    }
   }
 
   std::string mapmetadatafile = save_parameters.map_file_name + ".yaml";
@@ -46,6 +46,9 @@
 
 #include "nav2_map_server/map_server.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <string>
 #include <memory>
 #include <fstream>
@@ -55,6 +58,8 @@
 #include "yaml-cpp/yaml.h"
 #include "lifecycle_msgs/msg/state.hpp"
 #include "nav2_map_server/map_io.hpp"
+#include "tf2/LinearMath/Matrix3x3.h"
+#include "tf2/LinearMath/Quaternion.h"
 
 using namespace std::chrono_literals;
 using namespace std::placeholders;
@@ -71,6 +76,7 @@ MapServer::MapServer()
   declare_parameter("yaml_filename");
   declare_parameter("topic_name", "map");
   declare_parameter("frame_id", "map");
+  declare_parameter("publish_full_map", true);
 }
 
 MapServer::~MapServer()
@@ -88,6 +94,7 @@ MapServer::on_configure(const rclcpp_lifecycle::State & /*state*/)
 
   std::string topic_name = get_parameter("topic_name").as_string();
   frame_id_ = get_parameter("frame_id").as_string();
+  publish_full_map_ = get_parameter("publish_full_map").as_bool();
 
   // Shared pointer to LoadMap::Response is also should be initialized
   // in order to avoid null-pointer dereference
@@ -116,6 +123,11 @@ MapServer::on_configure(const rclcpp_lifecycle::State & /*state*/)
     service_prefix + std::string(load_map_service_name_),
     std::bind(&MapServer::loadMapCallback, this, _1, _2, _3));
 
+  // Create a service that provides a part of the occupancy grid
+  map_region_service_ = create_service<nav2_msgs::srv::GetMapRegion>(
+    service_prefix + std::string(map_region_service_name_),
+    std::bind(&MapServer::getMapRegionCallback, this, _1, _2, _3));
+
   return nav2_util::CallbackReturn::SUCCESS;
 }
 
@@ -126,8 +138,12 @@ MapServer::on_activate(const rclcpp_lifecycle::State & /*state*/)
 
   // Publish the map using the latched topic
   occ_pub_->on_activate();
-  auto occ_grid = std::make_unique<nav_msgs::msg::OccupancyGrid>(msg_);
-  occ_pub_->publish(std::move(occ_grid));
+  if (publish_full_map_) {
+    auto occ_grid = std::make_unique<nav_msgs::msg::OccupancyGrid>(msg_);
+    occ_pub_->publish(std::move(occ_grid));
+  } else {
+    RCLCPP_INFO(get_logger(), "Not publishing the map, it is served by the map region service");
+  }
 
   return nav2_util::CallbackReturn::SUCCESS;
 }
@@ -150,6 +166,8 @@ MapServer::on_cleanup(const rclcpp_lifecycle::State & /*state*/)
   occ_pub_.reset();
   occ_service_.reset();
   load_map_service_.reset();
+  map_region_service_.reset();
+  tiled_map_.close();
 
   return nav2_util::CallbackReturn::SUCCESS;
 }
@@ -173,10 +191,106 @@ void MapServer::getMapCallback(
       "Received GetMap request but not in ACTIVE state, ignoring!");
     return;
   }
+  if (!publish_full_map_) {
+    RCLCPP_WARN(
+      get_logger(),
+      "Received GetMap request but publish_full_map is false, ignoring!");
+    return;
+  }
   RCLCPP_INFO(get_logger(), "Handling GetMap request");
   response->map = msg_;
 }
 
+void MapServer::getMapRegionCallback(
+  const std::shared_ptr<rmw_request_id_t>/*request_header*/,
+  const std::shared_ptr<nav2_msgs::srv::GetMapRegion::Request> request,
+  std::shared_ptr<nav2_msgs::srv::GetMapRegion::Response> response)
+{
+  // if not in ACTIVE state, ignore request
+  if (get_current_state().id() != lifecycle_msgs::msg::State::PRIMARY_STATE_ACTIVE) {
+    RCLCPP_WARN(
+      get_logger(),
+      "Received GetMapRegion request but not in ACTIVE state, ignoring!");
+    return;
+  }
+  RCLCPP_DEBUG(get_logger(), "Handling GetMapRegion request");
+  response->result = getMapRegion(
+    request->min_x, request->min_y, request->max_x, request->max_y, response->map);
+}
+
+bool MapServer::getMapRegion(
+  double min_x, double min_y, double max_x, double max_y,
+  nav_msgs::msg::OccupancyGrid & region)
+{
+  const nav_msgs::msg::MapMetaData & info = msg_.info;
+  if (info.width == 0 || info.height == 0 || !(min_x <= max_x) || !(min_y <= max_y)) {
+    return false;
+  }
+  // Without a tiled map to read, the cells must have been loaded into msg_
+  if (!tiled_map_.isOpen() &&
+    msg_.data.size() != static_cast<size_t>(info.width) * info.height)
+  {
+    return false;
+  }
+
+  const geometry_msgs::msg::Quaternion & orientation = info.origin.orientation;
+  tf2::Matrix3x3 mat(tf2::Quaternion(orientation.x, orientation.y, orientation.z, orientation.w));
+  double yaw, pitch, roll;
+  mat.getEulerYPR(yaw, pitch, roll);
+  const double cos_yaw = std::cos(yaw), sin_yaw = std::sin(yaw);
+
+  // Cell bounds of the box, which may be rotated relative to the map
+  double cell_min_x = std::numeric_limits<double>::max(), cell_max_x = -cell_min_x;
+  double cell_min_y = cell_min_x, cell_max_y = cell_max_x;
+  for (double x : {min_x, max_x}) {
+    for (double y : {min_y, max_y}) {
+      const double dx = x - info.origin.position.x;
+      const double dy = y - info.origin.position.y;
+      const double cell_x = (cos_yaw * dx + sin_yaw * dy) / info.resolution;
+      const double cell_y = (-sin_yaw * dx + cos_yaw * dy) / info.resolution;
+      cell_min_x = std::min(cell_min_x, cell_x);
+      cell_max_x = std::max(cell_max_x, cell_x);
+      cell_min_y = std::min(cell_min_y, cell_y);
+      cell_max_y = std::max(cell_max_y, cell_y);
+    }
+  }
+
+  const double width = info.width, height = info.height;
+  const unsigned int x0 = std::max(0.0, std::min(width, std::floor(cell_min_x)));
+  const unsigned int x1 = std::max(0.0, std::min(width, std::floor(cell_max_x) + 1));
+  const unsigned int y0 = std::max(0.0, std::min(height, std::floor(cell_min_y)));
+  const unsigned int y1 = std::max(0.0, std::min(height, std::floor(cell_max_y) + 1));
+  if (x0 >= x1 || y0 >= y1) {
+    return false;
+  }
+
+  region.header = msg_.header;
+  region.info = info;
+  region.info.width = x1 - x0;
+  region.info.height = y1 - y0;
+  region.info.origin.position.x =
+    info.origin.position.x + (cos_yaw * x0 - sin_yaw * y0) * info.resolution;
+  region.info.origin.position.y =
+    info.origin.position.y + (sin_yaw * x0 + cos_yaw * y0) * info.resolution;
+
+  region.data.resize(region.info.width * region.info.height);
+  if (tiled_map_.isOpen()) {
+    // Only the tiles overlapping the region are decoded
+    try {
+      tiled_map_.readCells(x0, y0, x1 - x0, y1 - y0, region.data.data());
+    } catch (std::runtime_error & e) {
+      RCLCPP_ERROR(get_logger(), "Failed to read the map region: %s", e.what());
+      return false;
+    }
+    return true;
+  }
+  for (unsigned int y = y0; y < y1; y++) {
+    const auto row = msg_.data.begin() + y * info.width;
+    std::copy(row + x0, row + x1, region.data.begin() + (y - y0) * region.info.width);
+  }
+  return true;
+}
+
 void MapServer::loadMapCallback(
   const std::shared_ptr<rmw_request_id_t>/*request_header*/,
   const std::shared_ptr<nav2_msgs::srv::LoadMap::Request> request,
@@ -191,7 +305,7 @@ void MapServer::loadMapCallback(
   }
   RCLCPP_INFO(get_logger(), "Handling LoadMap request");
   // Load from file
-  if (loadMapResponseFromYaml(request->map_url, response)) {
+  if (loadMapResponseFromYaml(request->map_url, response) && publish_full_map_) {
     auto occ_grid = std::make_unique<nav_msgs::msg::OccupancyGrid>(msg_);
     occ_pub_->publish(std::move(occ_grid));  // publish new map
   }
@@ -201,7 +315,10 @@ bool MapServer::loadMapResponseFromYaml(
   const std::string & yaml_file,
   std::shared_ptr<nav2_msgs::srv::LoadMap::Response> response)
 {
-  switch (loadMapFromYaml(yaml_file, msg_)) {
+  // Load into locals so that the map being served survives a failed load
+  nav_msgs::msg::OccupancyGrid msg;
+  TiledMap tiled_map;
+  switch (loadMapFromYaml(yaml_file, msg, tiled_map)) {
     case MAP_DOES_NOT_EXIST:
       response->result = nav2_msgs::srv::LoadMap::Response::RESULT_MAP_DOES_NOT_EXIST;
       return false;
@@ -212,6 +329,21 @@ bool MapServer::loadMapResponseFromYaml(
       response->result = nav2_msgs::srv::LoadMap::Response::RESULT_INVALID_MAP_DATA;
       return false;
     case LOAD_MAP_SUCCESS:
+      // Tiled maps are decoded only when the whole map is served
+      if (tiled_map.isOpen() && publish_full_map_) {
+        msg.data.resize(static_cast<size_t>(msg.info.width) * msg.info.height);
+        try {
+          tiled_map.readCells(0, 0, msg.info.width, msg.info.height, msg.data.data());
+        } catch (std::runtime_error & e) {
+          RCLCPP_ERROR(get_logger(), "Failed to read the tiled map: %s", e.what());
+          response->result = nav2_msgs::srv::LoadMap::Response::RESULT_INVALID_MAP_DATA;
+          return false;
+        }
+      }
+
+      msg_ = std::move(msg);
+      tiled_map_.swap(tiled_map);
+
       // Correcting msg_ header when it belongs to spiecific node
       updateMsgHeader();
 
@@ -0,0 +1,371 @@
+// Copyright (c) 2020 Navigation2 contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nav2_map_server/tiled_map.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "nav2_util/geometry_utils.hpp"
+#include "tf2/LinearMath/Matrix3x3.h"
+#include "tf2/LinearMath/Quaternion.h"
+
+namespace nav2_map_server
+{
+
+static const char TILED_MAP_MAGIC[4] = {'N', '2', 'T', 'M'};
+
+static_assert(sizeof(TiledMapHeader) == 56, "TiledMapHeader must not be padded");
+static_assert(sizeof(TiledMapTileEntry) == 16, "TiledMapTileEntry must not be padded");
+
+TiledMap::TiledMap()
+: tiles_x_(0), tiles_y_(0), data_(nullptr), size_(0)
+{
+  std::memset(&header_, 0, sizeof(header_));
+}
+
+TiledMap::~TiledMap()
+{
+  close();
+}
+
+void TiledMap::open(const std::string & file_name)
+{
+  close();
+
+#ifndef _WIN32
+  int fd = ::open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to open " + file_name);
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0) {
+    ::close(fd);
+    throw std::runtime_error("Failed to stat " + file_name);
+  }
+  size_t size = static_cast<size_t>(file_stat.st_size);
+  void * mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapped == MAP_FAILED) {
+    throw std::runtime_error("Failed to map " + file_name);
+  }
+  data_ = static_cast<const unsigned char *>(mapped);
+  size_ = size;
+#else
+  std::ifstream file(file_name, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Failed to open " + file_name);
+  }
+  buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  if (buffer_.empty()) {
+    throw std::runtime_error("Failed to read " + file_name);
+  }
+  data_ = buffer_.data();
+  size_ = buffer_.size();
+#endif
+
+  try {
+    if (size_ < sizeof(TiledMapHeader)) {
+      throw std::runtime_error("truncated header");
+    }
+    std::memcpy(&header_, data_, sizeof(header_));
+    if (std::memcmp(header_.magic, TILED_MAP_MAGIC, sizeof(TILED_MAP_MAGIC)) != 0) {
+      throw std::runtime_error("not a tiled map");
+    }
+    if (header_.version != TILED_MAP_VERSION) {
+      throw std::runtime_error("unsupported version " + std::to_string(header_.version));
+    }
+    if (header_.width == 0 || header_.height == 0 || header_.tile_size == 0 ||
+      !(header_.resolution > 0.0))
+    {
+      throw std::runtime_error("invalid map metadata");
+    }
+
+    tiles_x_ = (header_.width + header_.tile_size - 1) / header_.tile_size;
+    tiles_y_ = (header_.height + header_.tile_size - 1) / header_.tile_size;
+    const uint64_t num_tiles = static_cast<uint64_t>(tiles_x_) * tiles_y_;
+    if ((size_ - sizeof(TiledMapHeader)) / sizeof(TiledMapTileEntry) < num_tiles) {
+      throw std::runtime_error("truncated tile index");
+    }
+    index_.resize(num_tiles);
+    std::memcpy(
+      index_.data(), data_ + sizeof(TiledMapHeader), num_tiles * sizeof(TiledMapTileEntry));
+
+    for (unsigned int ty = 0; ty < tiles_y_; ty++) {
+      for (unsigned int tx = 0; tx < tiles_x_; tx++) {
+        const TiledMapTileEntry & entry = index_[ty * tiles_x_ + tx];
+        const uint64_t tile_width =
+          std::min(header_.tile_size, header_.width - tx * header_.tile_size);
+        const uint64_t tile_height =
+          std::min(header_.tile_size, header_.height - ty * header_.tile_size);
+        const uint64_t cells = tile_width * tile_height;
+        const bool size_ok = entry.encoding == TILE_RAW ? entry.size == cells :
+          entry.encoding == TILE_RLE && entry.size % 2 == 0 && entry.size / 2 <= cells;
+        if (!size_ok || entry.offset > size_ || entry.size > size_ - entry.offset) {
+          throw std::runtime_error("corrupt tile index");
+        }
+      }
+    }
+  } catch (std::runtime_error & e) {
+    close();
+    throw std::runtime_error("Failed to read tiled map " + file_name + ": " + e.what());
+  }
+}
+
+void TiledMap::close()
+{
+#ifndef _WIN32
+  if (data_) {
+    munmap(const_cast<unsigned char *>(data_), size_);
+  }
+#else
+  buffer_.clear();
+#endif
+  data_ = nullptr;
+  size_ = 0;
+  index_.clear();
+  tiles_x_ = tiles_y_ = 0;
+}
+
+void TiledMap::swap(TiledMap & other)
+{
+  std::swap(header_, other.header_);
+  std::swap(tiles_x_, other.tiles_x_);
+  std::swap(tiles_y_, other.tiles_y_);
+  index_.swap(other.index_);
+  std::swap(data_, other.data_);
+  std::swap(size_, other.size_);
+  // swapping vectors keeps their storage, so data_ still points into buffer_
+  buffer_.swap(other.buffer_);
+}
+
+bool TiledMap::decodeTile(unsigned int tile_index, int8_t * out, size_t cells) const
+{
+  const TiledMapTileEntry & entry = index_[tile_index];
+  const unsigned char * tile = data_ + entry.offset;
+  if (entry.encoding == TILE_RAW) {
+    std::memcpy(out, tile, cells);
+    return true;
+  }
+
+  size_t written = 0;
+  for (uint32_t i = 0; i < entry.size; i += 2) {
+    const size_t count = tile[i];
+    if (count == 0 || written + count > cells) {
+      return false;
+    }
+    std::fill(out + written, out + written + count, static_cast<int8_t>(tile[i + 1]));
+    written += count;
+  }
+  return written == cells;
+}
+
+void TiledMap::readCells(
+  unsigned int x0, unsigned int y0, unsigned int width, unsigned int height,
+  int8_t * out) const
+{
+  if (!isOpen() || x0 > header_.width || width > header_.width - x0 ||
+    y0 > header_.height || height > header_.height - y0)
+  {
+    throw std::runtime_error("Requested cells are outside of the tiled map");
+  }
+  if (width == 0 || height == 0) {
+    return;
+  }
+
+  const unsigned int tile_size = header_.tile_size;
+  const int tx0 = x0 / tile_size, tx1 = (x0 + width - 1) / tile_size;
+  const int ty0 = y0 / tile_size, ty1 = (y0 + height - 1) / tile_size;
+  const int span_x = tx1 - tx0 + 1;
+  const int num_tiles = span_x * (ty1 - ty0 + 1);
+  std::atomic<bool> corrupt(false);
+
+  // Tiles cover disjoint parts of the output, so they can be copied concurrently
+  #pragma omp parallel
+  {
+    std::vector<int8_t> decoded;
+
+    #pragma omp for schedule(dynamic)
+    for (int t = 0; t < num_tiles; t++) {
+      const unsigned int tx = tx0 + t % span_x;
+      const unsigned int ty = ty0 + t / span_x;
+      const unsigned int tile_x = tx * tile_size, tile_y = ty * tile_size;
+      const unsigned int tile_width = std::min(tile_size, header_.width - tile_x);
+      const unsigned int tile_height = std::min(tile_size, header_.height - tile_y);
+      const TiledMapTileEntry & entry = index_[ty * tiles_x_ + tx];
+
+      // Raw tiles are read straight from the mapping
+      const int8_t * tile = reinterpret_cast<const int8_t *>(data_ + entry.offset);
+      if (entry.encoding != TILE_RAW) {
+        decoded.resize(static_cast<size_t>(tile_width) * tile_height);
+        if (!decodeTile(ty * tiles_x_ + tx, decoded.data(), decoded.size())) {
+          corrupt = true;
+          continue;
+        }
+        tile = decoded.data();
+      }
+
+      const unsigned int cx0 = std::max(x0, tile_x);
+      const unsigned int cx1 = std::min(x0 + width, tile_x + tile_width);
+      const unsigned int cy0 = std::max(y0, tile_y);
+      const unsigned int cy1 = std::min(y0 + height, tile_y + tile_height);
+      for (unsigned int y = cy0; y < cy1; y++) {
+        std::memcpy(
+          out + static_cast<size_t>(y - y0) * width + (cx0 - x0),
+          tile + static_cast<size_t>(y - tile_y) * tile_width + (cx0 - tile_x),
+          cx1 - cx0);
+      }
+    }
+  }
+
+  if (corrupt) {
+    throw std::runtime_error("Tiled map contains a corrupt tile");
+  }
+}
+
+void TiledMap::readMap(nav_msgs::msg::OccupancyGrid & map) const
+{
+  map.info.width = header_.width;
+  map.info.height = header_.height;
+  map.info.resolution = header_.resolution;
+  map.info.origin.position.x = header_.origin[0];
+  map.info.origin.position.y = header_.origin[1];
+  map.info.origin.position.z = 0.0;
+  map.info.origin.orientation =
+    nav2_util::geometry_utils::orientationAroundZAxis(header_.origin[2]);
+
+  map.data.resize(static_cast<size_t>(header_.width) * header_.height);
+  readCells(0, 0, header_.width, header_.height, map.data.data());
+}
+
+/// Run-length encode cells as (count, value) pairs
+static void encodeRunLength(
+  const std::vector<int8_t> & cells, std::vector<unsigned char> & encoded)
+{
+  encoded.clear();
+  size_t i = 0;
+  while (i < cells.size()) {
+    size_t run = 1;
+    while (i + run < cells.size() && run < 255 && cells[i + run] == cells[i]) {
+      run++;
+    }
+    encoded.push_back(static_cast<unsigned char>(run));
+    encoded.push_back(static_cast<unsigned char>(cells[i]));
+    i += run;
+  }
+}
+
+void saveMapToTiledFile(
+  const nav_msgs::msg::OccupancyGrid & map,
+  const std::string & file_name,
+  unsigned int tile_size)
+{
+  const unsigned int width = map.info.width;
+  const unsigned int height = map.info.height;
+  if (width == 0 || height == 0 || tile_size == 0 ||
+    map.data.size() != static_cast<size_t>(width) * height)
+  {
+    throw std::runtime_error("Map size does not match its data");
+  }
+
+  TiledMapHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, TILED_MAP_MAGIC, sizeof(TILED_MAP_MAGIC));
+  header.version = TILED_MAP_VERSION;
+  header.width = width;
+  header.height = height;
+  header.tile_size = tile_size;
+  header.resolution = map.info.resolution;
+  header.origin[0] = map.info.origin.position.x;
+  header.origin[1] = map.info.origin.position.y;
+
+  const geometry_msgs::msg::Quaternion & orientation = map.info.origin.orientation;
+  tf2::Matrix3x3 mat(tf2::Quaternion(orientation.x, orientation.y, orientation.z, orientation.w));
+  double yaw, pitch, roll;
+  mat.getEulerYPR(yaw, pitch, roll);
+  header.origin[2] = yaw;
+
+  const unsigned int tiles_x = (width + tile_size - 1) / tile_size;
+  const unsigned int tiles_y = (height + tile_size - 1) / tile_size;
+  std::vector<TiledMapTileEntry> index(static_cast<size_t>(tiles_x) * tiles_y);
+  std::vector<unsigned char> tile_data;
+
+  uint64_t offset = sizeof(TiledMapHeader) + index.size() * sizeof(TiledMapTileEntry);
+  std::vector<int8_t> cells;
+  std::vector<unsigned char> encoded;
+  for (unsigned int ty = 0; ty < tiles_y; ty++) {
+    for (unsigned int tx = 0; tx < tiles_x; tx++) {
+      const unsigned int tile_x = tx * tile_size, tile_y = ty * tile_size;
+      const unsigned int tile_width = std::min(tile_size, width - tile_x);
+      const unsigned int tile_height = std::min(tile_size, height - tile_y);
+      cells.resize(static_cast<size_t>(tile_width) * tile_height);
+      for (unsigned int y = 0; y < tile_height; y++) {
+        const int8_t * row = &map.data[static_cast<size_t>(tile_y + y) * width + tile_x];
+        std::copy(row, row + tile_width, &cells[static_cast<size_t>(y) * tile_width]);
+      }
+
+      TiledMapTileEntry & entry = index[ty * tiles_x + tx];
+      encodeRunLength(cells, encoded);
+      entry.offset = offset;
+      if (encoded.size() < cells.size()) {
+        entry.encoding = TILE_RLE;
+        entry.size = encoded.size();
+        tile_data.insert(tile_data.end(), encoded.begin(), encoded.end());
+      } else {
+        entry.encoding = TILE_RAW;
+        entry.size = cells.size();
+        tile_data.insert(tile_data.end(), cells.begin(), cells.end());
+      }
+      offset += entry.size;
+    }
+  }
+
+  std::ofstream file(file_name, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(
+    reinterpret_cast<const char *>(index.data()), index.size() * sizeof(TiledMapTileEntry));
+  file.write(reinterpret_cast<const char *>(tile_data.data()), tile_data.size());
+  if (!file) {
+    throw std::runtime_error("Failed to write tiled map " + file_name);
+  }
+}
+
+bool isTiledMapFile(const std::string & file_name)
+{
+  const size_t dot = file_name.rfind('.');
+  if (dot == std::string::npos) {
+    return false;
+  }
+  std::string extension = file_name.substr(dot + 1);
+  std::transform(
+    extension.begin(), extension.end(), extension.begin(),
+    [](unsigned char c) {return std::tolower(c);});
+  return extension == TILED_MAP_EXTENSION;
+}
+
+}  // namespace nav2_map_server
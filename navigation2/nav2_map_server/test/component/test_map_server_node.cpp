@@ -19,9 +19,11 @@
 #include <memory>
 
 #include "test_constants/test_constants.h"
+#include "nav2_map_server/map_io.hpp"
 #include "nav2_map_server/map_server.hpp"
 #include "nav2_util/lifecycle_service_client.hpp"
 #include "nav2_msgs/srv/load_map.hpp"
+#include "nav2_msgs/srv/get_map_region.hpp"
 
 #define TEST_DIR TEST_DIRECTORY
 
@@ -116,6 +118,34 @@ TEST_F(MapServerTestFixture, GetMap)
   verifyMapMsg(resp->map);
 }
 
+// Send map region getting service requests: a box enclosing the whole map should
+// return all of it, a box away from the map nothing
+TEST_F(MapServerTestFixture, GetMapRegion)
+{
+  RCLCPP_INFO(node_->get_logger(), "Testing GetMapRegion service");
+  auto req = std::make_shared<nav2_msgs::srv::GetMapRegion::Request>();
+  auto client = node_->create_client<nav2_msgs::srv::GetMapRegion>(
+    "/map_server/map_region");
+
+  RCLCPP_INFO(node_->get_logger(), "Waiting for map_region service");
+  ASSERT_TRUE(client->wait_for_service());
+
+  req->min_x = -100.0;
+  req->min_y = -100.0;
+  req->max_x = 100.0;
+  req->max_y = 100.0;
+  auto resp = send_request<nav2_msgs::srv::GetMapRegion>(node_, client, req);
+
+  ASSERT_TRUE(resp->result);
+  verifyMapMsg(resp->map);
+
+  req->min_x = 50.0;
+  req->max_x = 60.0;
+  resp = send_request<nav2_msgs::srv::GetMapRegion>(node_, client, req);
+
+  ASSERT_FALSE(resp->result);
+}
+
 // Send map loading service request and verify obtained OccupancyGrid
 TEST_F(MapServerTestFixture, LoadMap)
 {
@@ -187,3 +217,53 @@ TEST_F(MapServerTestFixture, LoadMapInvalidImage)
 
   ASSERT_EQ(resp->result, nav2_msgs::srv::LoadMap::Response::RESULT_INVALID_MAP_DATA);
 }
+
+// Load a tiled map, then fail to load another map: the tiled map must still be
+// served, both whole and by region
+TEST_F(MapServerTestFixture, LoadMapInvalidImageKeepsTiledMap)
+{
+  RCLCPP_INFO(node_->get_logger(), "Testing LoadMap service with a tiled map");
+  nav_msgs::msg::OccupancyGrid map_msg;
+  ASSERT_EQ(
+    nav2_map_server::loadMapFromYaml(path(TEST_DIR) / path(g_valid_yaml_file), map_msg),
+    nav2_map_server::LOAD_MAP_SUCCESS);
+  nav2_map_server::SaveParameters save_parameters;
+  save_parameters.map_file_name = path(g_tmp_dir) / path("testmap_tiled");
+  save_parameters.image_format = "tmap";
+  save_parameters.free_thresh = g_default_free_thresh;
+  save_parameters.occupied_thresh = g_default_occupied_thresh;
+  ASSERT_TRUE(nav2_map_server::saveMapToFile(map_msg, save_parameters));
+
+  auto load_client = node_->create_client<nav2_msgs::srv::LoadMap>(
+    "/map_server/load_map");
+  auto region_client = node_->create_client<nav2_msgs::srv::GetMapRegion>(
+    "/map_server/map_region");
+  auto map_client = node_->create_client<nav_msgs::srv::GetMap>(
+    "/map_server/map");
+  ASSERT_TRUE(load_client->wait_for_service());
+  ASSERT_TRUE(region_client->wait_for_service());
+  ASSERT_TRUE(map_client->wait_for_service());
+
+  auto load_req = std::make_shared<nav2_msgs::srv::LoadMap::Request>();
+  load_req->map_url = path(g_tmp_dir) / path("testmap_tiled.yaml");
+  auto load_resp = send_request<nav2_msgs::srv::LoadMap>(node_, load_client, load_req);
+  ASSERT_EQ(load_resp->result, nav2_msgs::srv::LoadMap::Response::RESULT_SUCCESS);
+
+  load_req->map_url = path(TEST_DIR) / "invalid_image.yaml";
+  load_resp = send_request<nav2_msgs::srv::LoadMap>(node_, load_client, load_req);
+  ASSERT_EQ(load_resp->result, nav2_msgs::srv::LoadMap::Response::RESULT_INVALID_MAP_DATA);
+
+  auto region_req = std::make_shared<nav2_msgs::srv::GetMapRegion::Request>();
+  region_req->min_x = -100.0;
+  region_req->min_y = -100.0;
+  region_req->max_x = 100.0;
+  region_req->max_y = 100.0;
+  auto region_resp =
+    send_request<nav2_msgs::srv::GetMapRegion>(node_, region_client, region_req);
+  ASSERT_TRUE(region_resp->result);
+  verifyMapMsg(region_resp->map);
+
+  auto map_resp = send_request<nav_msgs::srv::GetMap>(
+    node_, map_client, std::make_shared<nav_msgs::srv::GetMap::Request>());
+  verifyMapMsg(map_resp->map);
+}
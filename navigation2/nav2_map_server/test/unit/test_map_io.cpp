@@ -40,9 +40,11 @@
 #include <iostream>
 #include <fstream>
 
+#include "Magick++.h"
 #include "yaml-cpp/yaml.h"
 #include "nav2_map_server/map_io.hpp"
 #include "nav2_map_server/map_server.hpp"
+#include "nav2_map_server/tiled_map.hpp"
 #include "nav2_util/lifecycle_node.hpp"
 #include "test_constants/test_constants.h"
 
@@ -197,6 +199,82 @@ TEST_F(MapIOTester, loadSaveValidBMP)
   verifyMapMsg(map_msg);
 }
 
+// Load a valid reference PGM file and save it as a tiled map with tiles smaller than the map.
+// Load back saved tiled map through its YAML and check for consistency, then read
+// a region spanning several tiles straight from the tiled map.
+// Succeeds all steps were passed without a problem or expection.
+TEST_F(MapIOTester, loadSaveValidTiled)
+{
+  // 1. Load reference map file
+  LoadParameters loadParameters;
+  fillLoadParameters(path(TEST_DIR) / path(g_valid_pgm_file), loadParameters);
+
+  nav_msgs::msg::OccupancyGrid map_msg;
+  ASSERT_NO_THROW(loadMapFromFile(loadParameters, map_msg));
+
+  // 2. Save OccupancyGrid into a tmp tiled map and its YAML
+  SaveParameters saveParameters;
+  fillSaveParameters(path(g_tmp_dir) / path(g_valid_map_name), "tmap", saveParameters);
+
+  ASSERT_TRUE(saveMapToFile(map_msg, saveParameters));
+
+  // 3. Load saved map and verify it
+  LOAD_MAP_STATUS status = loadMapFromYaml(path(g_tmp_dir) / path(g_valid_yaml_file), map_msg);
+  ASSERT_EQ(status, LOAD_MAP_SUCCESS);
+
+  verifyMapMsg(map_msg);
+
+  // 4. Rewrite it with 3x3 tiles and read a region crossing tile borders
+  std::string tiled_file = path(g_tmp_dir) / path(std::string(g_valid_map_name) + ".tmap");
+  ASSERT_NO_THROW(saveMapToTiledFile(map_msg, tiled_file, 3));
+
+  TiledMap tiled_map;
+  ASSERT_NO_THROW(tiled_map.open(tiled_file));
+  ASSERT_EQ(tiled_map.getWidth(), g_valid_image_width);
+  ASSERT_EQ(tiled_map.getHeight(), g_valid_image_height);
+
+  const unsigned int x0 = 2, y0 = 1, width = 7, height = 8;
+  std::vector<int8_t> cells(width * height);
+  ASSERT_NO_THROW(tiled_map.readCells(x0, y0, width, height, cells.data()));
+  for (unsigned int y = 0; y < height; y++) {
+    for (unsigned int x = 0; x < width; x++) {
+      ASSERT_EQ(
+        cells[y * width + x],
+        g_valid_image_content[(y0 + y) * g_valid_image_width + x0 + x]);
+    }
+  }
+
+  // 5. Regions outside of the map are refused
+  EXPECT_THROW(tiled_map.readCells(5, 5, 6, 1, cells.data()), std::runtime_error);
+
+  // 6. Open the tiled map through its YAML without decoding it
+  nav_msgs::msg::OccupancyGrid info_msg;
+  status = loadMapFromYaml(path(g_tmp_dir) / path(g_valid_yaml_file), info_msg, tiled_map);
+  ASSERT_EQ(status, LOAD_MAP_SUCCESS);
+  ASSERT_TRUE(tiled_map.isOpen());
+  EXPECT_TRUE(info_msg.data.empty());
+  ASSERT_EQ(info_msg.info.width, g_valid_image_width);
+  ASSERT_EQ(info_msg.info.height, g_valid_image_height);
+
+  ASSERT_NO_THROW(tiled_map.readMap(info_msg));
+  verifyMapMsg(info_msg);
+
+  // 7. A failed reload keeps the open tiled map and its metadata
+  nav_msgs::msg::OccupancyGrid failed_msg = info_msg;
+  status = loadMapFromYaml(path(TEST_DIR) / path("invalid_image.yaml"), failed_msg, tiled_map);
+  ASSERT_EQ(status, INVALID_MAP_DATA);
+  ASSERT_TRUE(tiled_map.isOpen());
+  EXPECT_EQ(failed_msg, info_msg);
+  ASSERT_NO_THROW(tiled_map.readCells(x0, y0, width, height, cells.data()));
+  EXPECT_EQ(cells[0], g_valid_image_content[y0 * g_valid_image_width + x0]);
+
+  // 8. Other images are decoded as usual, closing the tiled map
+  status = loadMapFromYaml(path(TEST_DIR) / path(g_valid_yaml_file), map_msg, tiled_map);
+  ASSERT_EQ(status, LOAD_MAP_SUCCESS);
+  EXPECT_FALSE(tiled_map.isOpen());
+  verifyMapMsg(map_msg);
+}
+
 // Load map from a valid file. Trying to save map with different modes.
 // Succeeds all steps were passed without a problem or expection.
 TEST_F(MapIOTester, loadSaveMapModes)
@@ -230,6 +308,53 @@ TEST_F(MapIOTester, loadSaveMapModes)
   ASSERT_EQ(status, LOAD_MAP_SUCCESS);
 
   verifyMapMsg(map_msg);
+
+  // 6. Save every occupancy value and an unknown cell in Scale mode
+  nav_msgs::msg::OccupancyGrid values_msg = map_msg;
+  values_msg.info.width = 102;
+  values_msg.info.height = 1;
+  values_msg.data.resize(102);
+  for (int8_t value = 0; value <= 100; value++) {
+    values_msg.data[value] = value;
+  }
+  values_msg.data[101] = -1;
+
+  saveParameters.mode = MapMode::Scale;
+  ASSERT_TRUE(saveMapToFile(values_msg, saveParameters));
+
+  // 7. Check the written pixels: gray levels truncate and unknown cells are transparent
+  Magick::InitializeMagick(nullptr);
+  Magick::Image image((path(g_tmp_dir) / path(g_valid_map_name + ".png")).string());
+  ASSERT_EQ(image.columns(), 102u);
+  ASSERT_EQ(image.rows(), 1u);
+  for (size_t x = 0; x < 102; x++) {
+    const Magick::Color pixel = image.pixelColor(x, 0);
+    const int gray = static_cast<int>(Magick::Color::scaleQuantumToDouble(pixel.redQuantum()) *
+      255.0 + 0.5);
+    if (x <= 100) {
+      EXPECT_EQ(gray, static_cast<int>((100.0 - x) / 100.0 * 255.0)) << "occupancy " << x;
+      EXPECT_EQ(pixel.alphaQuantum(), OpaqueOpacity) << "occupancy " << x;
+    } else {
+      EXPECT_EQ(gray, 127);
+      EXPECT_EQ(pixel.alphaQuantum(), TransparentOpacity);
+    }
+  }
+
+  // 8. Unknown cells load back as unknown
+  status = loadMapFromYaml(path(g_tmp_dir) / path(g_valid_yaml_file), map_msg);
+  ASSERT_EQ(status, LOAD_MAP_SUCCESS);
+  ASSERT_EQ(map_msg.data.size(), 102u);
+  EXPECT_EQ(map_msg.data[0], 0);
+  EXPECT_EQ(map_msg.data[100], 100);
+  EXPECT_EQ(map_msg.data[101], -1);
+
+  // 9. Raw mode keeps every occupancy value and unknown cells as they are
+  saveParameters.mode = MapMode::Raw;
+  ASSERT_TRUE(saveMapToFile(values_msg, saveParameters));
+
+  status = loadMapFromYaml(path(g_tmp_dir) / path(g_valid_yaml_file), map_msg);
+  ASSERT_EQ(status, LOAD_MAP_SUCCESS);
+  EXPECT_EQ(map_msg.data, values_msg.data);
 }
 
 // Try to load an invalid file with different ways.
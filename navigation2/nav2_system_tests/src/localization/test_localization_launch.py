@@ -52,7 +52,8 @@ def main(argv=sys.argv[1:]):
     run_amcl = launch_ros.actions.Node(
         package='nav2_amcl',
         executable='amcl',
-        output='screen')
+        output='screen',
+        parameters=[{'first_map_only_': False}])
     run_lifecycle_manager = launch_ros.actions.Node(
         package='nav2_lifecycle_manager',
         executable='lifecycle_manager',
@@ -17,8 +17,10 @@
 #include <memory>
 #include "nav2_amcl/amcl_node.hpp"
 #include "std_msgs/msg/string.hpp"
+#include "std_srvs/srv/empty.hpp"
 #include "geometry_msgs/msg/pose_array.hpp"
 #include "geometry_msgs/msg/pose_stamped.hpp"
+#include "nav_msgs/msg/occupancy_grid.hpp"
 
 using std::placeholders::_1;
 using namespace std::chrono_literals;
@@ -57,6 +59,7 @@ public:
   }
 
   bool defaultAmclTest();
+  bool mapSwitchAmclTest();
 
 protected:
   std::shared_ptr<rclcpp::Node> node;
@@ -97,6 +100,60 @@ bool TestAmclPose::defaultAmclTest()
   }
 }
 
+// Republish the map while scans keep arriving, so that amcl builds the new maps
+// in the background and swaps them in, then check that it still localizes
+bool TestAmclPose::mapSwitchAmclTest()
+{
+  if (!defaultAmclTest()) {
+    return false;
+  }
+
+  nav_msgs::msg::OccupancyGrid::SharedPtr map;
+  auto map_qos = rclcpp::QoS(rclcpp::KeepLast(1)).transient_local().reliable();
+  auto map_sub = node->create_subscription<nav_msgs::msg::OccupancyGrid>(
+    "map", map_qos,
+    [&map](const nav_msgs::msg::OccupancyGrid::SharedPtr msg) {map = msg;});
+  while (!map) {
+    std::this_thread::sleep_for(100ms);
+    rclcpp::spin_some(node);
+  }
+
+  auto map_pub = node->create_publisher<nav_msgs::msg::OccupancyGrid>("map", map_qos);
+  for (int i = 0; i < 5; i++) {
+    map->header.stamp = node->now();
+    map_pub->publish(*map);
+    std::this_thread::sleep_for(500ms);
+    rclcpp::spin_some(node);
+  }
+  // Let the last map be built and swapped in
+  std::this_thread::sleep_for(2s);
+
+  // The robot stands still, so force a filter update on the switched map
+  auto nomotion_client = node->create_client<std_srvs::srv::Empty>("request_nomotion_update");
+  if (!nomotion_client->wait_for_service(10s)) {
+    return false;
+  }
+  pose_callback_ = false;
+  auto result = nomotion_client->async_send_request(
+    std::make_shared<std_srvs::srv::Empty::Request>());
+  if (rclcpp::spin_until_future_complete(node, result, 10s) !=
+    rclcpp::FutureReturnCode::SUCCESS)
+  {
+    return false;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  while (!pose_callback_) {
+    if (std::chrono::steady_clock::now() - start > 30s) {
+      return false;
+    }
+    std::this_thread::sleep_for(100ms);
+    rclcpp::spin_some(node);
+  }
+  return std::abs(amcl_pose_x - testPose_.pose.pose.position.x) < tol_ &&
+         std::abs(amcl_pose_y - testPose_.pose.pose.position.y) < tol_;
+}
+
 void TestAmclPose::initTestPose()
 {
   testPose_.header.frame_id = "map";
@@ -120,3 +177,8 @@ TEST_F(TestAmclPose, SimpleAmclTest)
 {
   EXPECT_EQ(true, defaultAmclTest());
 }
+
+TEST_F(TestAmclPose, MapSwitchAmclTest)
+{
+  EXPECT_EQ(true, mapSwitchAmclTest());
+}
@@ -43,14 +43,17 @@
 #include <stdint.h>
 #include <math.h>
 #include <limits.h>
+#include <assert.h>
 #include <algorithm>
+#include <vector>
 #include "rclcpp/rclcpp.hpp"
 
 /**
- * @class VoxelGrid
+ * @class VoxelGridT
  * @brief A 3D grid structure that stores points as an integer array.
  *        X and Y index the array and Z selects which bit of the integer
- *        is used giving a limit of 16 vertical cells.
+ *        is used. The column type sets the number of vertical cells: half
+ *        of its bits, so 16 for a uint32_t column and 32 for a uint64_t one.
  */
 namespace nav2_voxel_grid
 {
@@ -62,29 +65,51 @@ enum VoxelStatus
   MARKED = 2,
 };
 
-class VoxelGrid
+template<typename ColumnT>
+class VoxelGridT
 {
 public:
+  /// @brief The number of z levels a column can hold
+  static constexpr unsigned int MAX_SIZE_Z = sizeof(ColumnT) * 4;
+
   /**
    * @brief  Constructor for a voxel grid
    * @param size_x The x size of the grid
    * @param size_y The y size of the grid
-   * @param size_z The z size of the grid, only sizes <= 16 are supported
+   * @param size_z The z size of the grid, only sizes <= MAX_SIZE_Z are supported
    */
-  VoxelGrid(unsigned int size_x, unsigned int size_y, unsigned int size_z);
+  VoxelGridT(unsigned int size_x, unsigned int size_y, unsigned int size_z);
 
-  ~VoxelGrid();
+  ~VoxelGridT();
 
   /**
    * @brief  Resizes a voxel grid to the desired size
    * @param size_x The x size of the grid
    * @param size_y The y size of the grid
-   * @param size_z The z size of the grid, only sizes <= 16 are supported
+   * @param size_z The z size of the grid, only sizes <= MAX_SIZE_Z are supported
    */
   void resize(unsigned int size_x, unsigned int size_y, unsigned int size_z);
 
   void reset();
-  uint32_t * getData() {return data_;}
+  ColumnT * getData() {return data_;}
+
+  /// @brief The mask of both bits of a z level
+  static inline ColumnT zMask(unsigned int z)
+  {
+    return ((ColumnT)1 << z << MAX_SIZE_Z) | ((ColumnT)1 << z);
+  }
+
+  /// @brief The bits of the z levels of a column that are marked
+  static inline ColumnT markedBits(ColumnT col)
+  {
+    return col >> MAX_SIZE_Z;
+  }
+
+  /// @brief The bits of the z levels of a column that are unknown
+  static inline ColumnT unknownBits(ColumnT col)
+  {
+    return ((col >> MAX_SIZE_Z) ^ col) & (~(ColumnT)0 >> MAX_SIZE_Z);
+  }
 
   inline void markVoxel(unsigned int x, unsigned int y, unsigned int z)
   {
@@ -92,8 +117,7 @@ public:
       RCLCPP_DEBUG(logger, "Error, voxel out of bounds.\n");
       return;
     }
-    uint32_t full_mask = ((uint32_t)1 << z << 16) | (1 << z);
-    data_[y * size_x_ + x] |= full_mask;  // clear unknown and mark cell
+    data_[y * size_x_ + x] |= zMask(z);  // clear unknown and mark cell
   }
 
   inline bool markVoxelInMap(
@@ -106,14 +130,11 @@ public:
     }
 
     int index = y * size_x_ + x;
-    uint32_t * col = &data_[index];
-    uint32_t full_mask = ((uint32_t)1 << z << 16) | (1 << z);
-    *col |= full_mask;  // clear unknown and mark cell
-
-    unsigned int marked_bits = *col >> 16;
+    ColumnT * col = &data_[index];
+    *col |= zMask(z);  // clear unknown and mark cell
 
     // make sure the number of bits in each is below our thesholds
-    return !bitsBelowThreshold(marked_bits, marked_threshold);
+    return !bitsBelowThreshold(markedBits(*col), marked_threshold);
   }
 
   inline void clearVoxel(unsigned int x, unsigned int y, unsigned int z)
@@ -122,8 +143,7 @@ public:
       RCLCPP_DEBUG(logger, "Error, voxel out of bounds.\n");
       return;
     }
-    uint32_t full_mask = ((uint32_t)1 << z << 16) | (1 << z);
-    data_[y * size_x_ + x] &= ~(full_mask);  // clear unknown and clear cell
+    data_[y * size_x_ + x] &= ~(zMask(z));  // clear unknown and clear cell
   }
 
   inline void clearVoxelColumn(unsigned int index)
@@ -139,50 +159,34 @@ public:
       return;
     }
     int index = y * size_x_ + x;
-    uint32_t * col = &data_[index];
-    uint32_t full_mask = ((uint32_t)1 << z << 16) | (1 << z);
-    *col &= ~(full_mask);  // clear unknown and clear cell
-
-    unsigned int unknown_bits = uint16_t(*col >> 16) ^ uint16_t(*col);
-    unsigned int marked_bits = *col >> 16;
+    ColumnT * col = &data_[index];
+    *col &= ~(zMask(z));  // clear unknown and clear cell
 
     // make sure the number of bits in each is below our thesholds
-    if (bitsBelowThreshold(unknown_bits, 1) && bitsBelowThreshold(marked_bits, 1)) {
+    if (bitsBelowThreshold(unknownBits(*col), 1) && bitsBelowThreshold(markedBits(*col), 1)) {
       costmap[index] = 0;
     }
   }
 
-  inline bool bitsBelowThreshold(unsigned int n, unsigned int bit_threshold)
+  static inline bool bitsBelowThreshold(ColumnT n, unsigned int bit_threshold)
   {
-    unsigned int bit_count;
-    for (bit_count = 0; n; ) {
-      ++bit_count;
-      if (bit_count > bit_threshold) {
-        return false;
-      }
-      n &= n - 1;  // clear the least significant bit set
-    }
-    return true;
+    return numBits(n) <= bit_threshold;
   }
 
-  static inline unsigned int numBits(unsigned int n)
+  static inline unsigned int numBits(ColumnT n)
   {
-    unsigned int bit_count;
-    for (bit_count = 0; n; ++bit_count) {
-      n &= n - 1;  // clear the least significant bit set
-    }
-    return bit_count;
+    // a single popcount instruction where the target supports it, rather than a bit loop
+    return __builtin_popcountll(static_cast<unsigned long long>(n));  // NOLINT
   }
 
   static VoxelStatus getVoxel(
     unsigned int x, unsigned int y, unsigned int z,
-    unsigned int size_x, unsigned int size_y, unsigned int size_z, const uint32_t * data)
+    unsigned int size_x, unsigned int size_y, unsigned int size_z, const ColumnT * data)
   {
     if (x >= size_x || y >= size_y || z >= size_z) {
       return UNKNOWN;
     }
-    uint32_t full_mask = ((uint32_t)1 << z << 16) | (1 << z);
-    uint32_t result = data[y * size_x + x] & full_mask;
+    ColumnT result = data[y * size_x + x] & zMask(z);
     unsigned int bits = numBits(result);
 
     // known marked: 11 = 2 bits, unknown: 01 = 1 bit, known free: 00 = 0 bits
@@ -207,6 +211,22 @@ public:
     unsigned char free_cost = 0, unsigned char unknown_cost = 255,
     unsigned int max_length = UINT_MAX);
 
+  /**
+   * @brief  Clears voxel lines from a common origin to a batch of endpoints, updating the 2D map,
+   *         on several threads. The result matches clearing the lines one by one.
+   * @param x0 The x origin of the lines in grid coordinates
+   * @param y0 The y origin of the lines in grid coordinates
+   * @param z0 The z origin of the lines in grid coordinates
+   * @param endpoints The x, y, z grid coordinates of each line end, packed one after the other
+   * @param map_2d The 2D map to update from the cleared columns
+   * @param num_threads The number of threads to trace the lines on
+   */
+  void clearVoxelLinesInMap(
+    double x0, double y0, double z0, const std::vector<double> & endpoints,
+    unsigned char * map_2d, unsigned int unknown_threshold, unsigned int mark_threshold,
+    unsigned char free_cost = 0, unsigned char unknown_cost = 255,
+    unsigned int max_length = UINT_MAX, int num_threads = 1);
+
   VoxelStatus getVoxel(unsigned int x, unsigned int y, unsigned int z);
 
   // Are there any obstacles at that (x, y) location in the grid?
@@ -237,7 +257,7 @@ public:
     int offset_dy = sign(dy) * size_x_;
     int offset_dz = sign(dz);
 
-    unsigned int z_mask = ((1 << 16) | 1) << (unsigned int)z0;
+    ColumnT z_mask = zMask((unsigned int)z0);
     unsigned int offset = (unsigned int)y0 * size_x_ + (unsigned int)x0;
 
     GridOffset grid_off(offset);
@@ -286,7 +306,7 @@ private:
     ActionType at, OffA off_a, OffB off_b, OffC off_c,
     unsigned int abs_da, unsigned int abs_db, unsigned int abs_dc,
     int error_b, int error_c, int offset_a, int offset_b, int offset_c, unsigned int & offset,
-    unsigned int & z_mask, unsigned int max_length = UINT_MAX)
+    ColumnT & z_mask, unsigned int max_length = UINT_MAX)
   {
     unsigned int end = std::min(max_length, abs_da);
     for (unsigned int i = 0; i < end; ++i) {
@@ -316,8 +336,13 @@ private:
     return x > y ? x : y;
   }
 
+  /**
+   * @brief  Fills every column of the grid with the all unknown column
+   */
+  void fillUnknown();
+
   unsigned int size_x_, size_y_, size_z_;
-  uint32_t * data_;
+  ColumnT * data_;
   unsigned char * costmap;
   rclcpp::Logger logger;
 
@@ -326,36 +351,36 @@ private:
   class MarkVoxel
   {
 public:
-    explicit MarkVoxel(uint32_t * data)
+    explicit MarkVoxel(ColumnT * data)
     : data_(data) {}
-    inline void operator()(unsigned int offset, unsigned int z_mask)
+    inline void operator()(unsigned int offset, ColumnT z_mask)
     {
       data_[offset] |= z_mask;  // clear unknown and mark cell
     }
 
 private:
-    uint32_t * data_;
+    ColumnT * data_;
   };
 
   class ClearVoxel
   {
 public:
-    explicit ClearVoxel(uint32_t * data)
+    explicit ClearVoxel(ColumnT * data)
     : data_(data) {}
-    inline void operator()(unsigned int offset, unsigned int z_mask)
+    inline void operator()(unsigned int offset, ColumnT z_mask)
     {
       data_[offset] &= ~(z_mask);  // clear unknown and clear cell
     }
 
 private:
-    uint32_t * data_;
+    ColumnT * data_;
   };
 
   class ClearVoxelInMap
   {
 public:
     ClearVoxelInMap(
-      uint32_t * data, unsigned char * costmap,
+      ColumnT * data, unsigned char * costmap,
       unsigned int unknown_clear_threshold, unsigned int marked_clear_threshold,
       unsigned char free_cost = 0, unsigned char unknown_cost = 255)
     : data_(data), costmap_(costmap),
@@ -365,17 +390,21 @@ public:
     {
     }
 
-    inline void operator()(unsigned int offset, unsigned int z_mask)
+    inline void operator()(unsigned int offset, ColumnT z_mask)
     {
-      uint32_t * col = &data_[offset];
+      ColumnT * col = &data_[offset];
       *col &= ~(z_mask);  // clear unknown and clear cell
+      updateMap(offset, *col);
+    }
 
-      unsigned int unknown_bits = uint16_t(*col >> 16) ^ uint16_t(*col);
-      unsigned int marked_bits = *col >> 16;
-
+    /**
+     * @brief  Sets the 2D map cost of a column from its voxels
+     */
+    inline void updateMap(unsigned int offset, ColumnT col)
+    {
       // make sure the number of bits in each is below our thesholds
-      if (bitsBelowThreshold(marked_bits, marked_clear_threshold_)) {
-        if (bitsBelowThreshold(unknown_bits, unknown_clear_threshold_)) {
+      if (bitsBelowThreshold(markedBits(col), marked_clear_threshold_)) {
+        if (bitsBelowThreshold(unknownBits(col), unknown_clear_threshold_)) {
           costmap_[offset] = free_cost_;
         } else {
           costmap_[offset] = unknown_cost_;
@@ -384,25 +413,33 @@ public:
     }
 
 private:
-    inline bool bitsBelowThreshold(unsigned int n, unsigned int bit_threshold)
-    {
-      unsigned int bit_count;
-      for (bit_count = 0; n; ) {
-        ++bit_count;
-        if (bit_count > bit_threshold) {
-          return false;
-        }
-        n &= n - 1;  // clear the least significant bit set
-      }
-      return true;
-    }
-
-    uint32_t * data_;
+    ColumnT * data_;
     unsigned char * costmap_;
     unsigned int unknown_clear_threshold_, marked_clear_threshold_;
     unsigned char free_cost_, unknown_cost_;
   };
 
+  /**
+   * @brief  Clears voxels with atomic updates so lines can be traced concurrently,
+   *         remembering the touched columns so their map cells can be set once all
+   *         lines are cleared
+   */
+  class AtomicClearVoxel
+  {
+public:
+    AtomicClearVoxel(ColumnT * data, std::vector<unsigned int> & touched)
+    : data_(data), touched_(touched) {}
+    inline void operator()(unsigned int offset, ColumnT z_mask)
+    {
+      __atomic_fetch_and(&data_[offset], ~(z_mask), __ATOMIC_RELAXED);
+      touched_.push_back(offset);
+    }
+
+private:
+    ColumnT * data_;
+    std::vector<unsigned int> & touched_;
+  };
+
   class GridOffset
   {
 public:
@@ -420,7 +457,7 @@ private:
   class ZOffset
   {
 public:
-    explicit ZOffset(unsigned int & z_mask)
+    explicit ZOffset(ColumnT & z_mask)
     : z_mask_(z_mask) {}
     inline void operator()(int offset_val)
     {
@@ -428,10 +465,19 @@ public:
     }
 
 private:
-    unsigned int & z_mask_;
+    ColumnT & z_mask_;
   };
 };
 
+/// @brief The classic voxel grid with 16 z levels per 32 bit column
+typedef VoxelGridT<uint32_t> VoxelGrid;
+
+/// @brief A voxel grid with 32 z levels per 64 bit column
+typedef VoxelGridT<uint64_t> VoxelGrid64;
+
+extern template class VoxelGridT<uint32_t>;
+extern template class VoxelGridT<uint64_t>;
+
 }  // namespace nav2_voxel_grid
 
 #endif  // NAV2_VOXEL_GRID__VOXEL_GRID_HPP_
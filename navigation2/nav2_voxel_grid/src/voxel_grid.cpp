@@ -36,32 +36,34 @@
 *********************************************************************/
 #include <nav2_voxel_grid/voxel_grid.hpp>
 
+#include <vector>
+
 namespace nav2_voxel_grid
 {
-VoxelGrid::VoxelGrid(unsigned int size_x, unsigned int size_y, unsigned int size_z)
+template<typename ColumnT>
+constexpr unsigned int VoxelGridT<ColumnT>::MAX_SIZE_Z;
+
+template<typename ColumnT>
+VoxelGridT<ColumnT>::VoxelGridT(unsigned int size_x, unsigned int size_y, unsigned int size_z)
 : logger(rclcpp::get_logger("voxel_grid"))
 {
   size_x_ = size_x;
   size_y_ = size_y;
   size_z_ = size_z;
 
-  if (size_z_ > 16) {
+  if (size_z_ > MAX_SIZE_Z) {
     RCLCPP_INFO(
-      logger, "Error, this implementation can only support up to 16 z values (%d)",
-      size_z_);
-    size_z_ = 16;
+      logger, "Error, this implementation can only support up to %u z values (%d)",
+      MAX_SIZE_Z, size_z_);
+    size_z_ = MAX_SIZE_Z;
   }
 
-  data_ = new uint32_t[size_x_ * size_y_];
-  uint32_t unknown_col = ~((uint32_t)0) >> 16;
-  uint32_t * col = data_;
-  for (unsigned int i = 0; i < size_x_ * size_y_; ++i) {
-    *col = unknown_col;
-    ++col;
-  }
+  data_ = new ColumnT[size_x_ * size_y_];
+  fillUnknown();
 }
 
-void VoxelGrid::resize(unsigned int size_x, unsigned int size_y, unsigned int size_z)
+template<typename ColumnT>
+void VoxelGridT<ColumnT>::resize(unsigned int size_x, unsigned int size_y, unsigned int size_z)
 {
   // if we're not actually changing the size, we can just reset things
   if (size_x == size_x_ && size_y == size_y_ && size_z == size_z_) {
@@ -74,38 +76,38 @@ void VoxelGrid::resize(unsigned int size_x, unsigned int size_y, unsigned int si
   size_y_ = size_y;
   size_z_ = size_z;
 
-  if (size_z_ > 16) {
+  if (size_z_ > MAX_SIZE_Z) {
     RCLCPP_INFO(
-      logger, "Error, this implementation can only support up to 16 z values (%d)",
-      size_z);
-    size_z_ = 16;
+      logger, "Error, this implementation can only support up to %u z values (%d)",
+      MAX_SIZE_Z, size_z);
+    size_z_ = MAX_SIZE_Z;
   }
 
-  data_ = new uint32_t[size_x_ * size_y_];
-  uint32_t unknown_col = ~((uint32_t)0) >> 16;
-  uint32_t * col = data_;
-  for (unsigned int i = 0; i < size_x_ * size_y_; ++i) {
-    *col = unknown_col;
-    ++col;
-  }
+  data_ = new ColumnT[size_x_ * size_y_];
+  fillUnknown();
 }
 
-VoxelGrid::~VoxelGrid()
+template<typename ColumnT>
+VoxelGridT<ColumnT>::~VoxelGridT()
 {
   delete[] data_;
 }
 
-void VoxelGrid::reset()
+template<typename ColumnT>
+void VoxelGridT<ColumnT>::reset()
 {
-  uint32_t unknown_col = ~((uint32_t)0) >> 16;
-  uint32_t * col = data_;
-  for (unsigned int i = 0; i < size_x_ * size_y_; ++i) {
-    *col = unknown_col;
-    ++col;
-  }
+  fillUnknown();
+}
+
+template<typename ColumnT>
+void VoxelGridT<ColumnT>::fillUnknown()
+{
+  ColumnT unknown_col = ~((ColumnT)0) >> MAX_SIZE_Z;
+  std::fill(data_, data_ + size_x_ * size_y_, unknown_col);
 }
 
-void VoxelGrid::markVoxelLine(
+template<typename ColumnT>
+void VoxelGridT<ColumnT>::markVoxelLine(
   double x0, double y0, double z0, double x1, double y1, double z1,
   unsigned int max_length)
 {
@@ -124,7 +126,8 @@ void VoxelGrid::markVoxelLine(
   raytraceLine(mv, x0, y0, z0, x1, y1, z1, max_length);
 }
 
-void VoxelGrid::clearVoxelLine(
+template<typename ColumnT>
+void VoxelGridT<ColumnT>::clearVoxelLine(
   double x0, double y0, double z0, double x1, double y1, double z1,
   unsigned int max_length)
 {
@@ -143,7 +146,8 @@ void VoxelGrid::clearVoxelLine(
   raytraceLine(cv, x0, y0, z0, x1, y1, z1, max_length);
 }
 
-void VoxelGrid::clearVoxelLineInMap(
+template<typename ColumnT>
+void VoxelGridT<ColumnT>::clearVoxelLineInMap(
   double x0, double y0, double z0, double x1, double y1, double z1, unsigned char * map_2d,
   unsigned int unknown_threshold, unsigned int mark_threshold, unsigned char free_cost,
   unsigned char unknown_cost, unsigned int max_length)
@@ -169,14 +173,67 @@ void VoxelGrid::clearVoxelLineInMap(
   raytraceLine(cvm, x0, y0, z0, x1, y1, z1, max_length);
 }
 
-VoxelStatus VoxelGrid::getVoxel(unsigned int x, unsigned int y, unsigned int z)
+template<typename ColumnT>
+void VoxelGridT<ColumnT>::clearVoxelLinesInMap(
+  double x0, double y0, double z0, const std::vector<double> & endpoints,
+  unsigned char * map_2d, unsigned int unknown_threshold, unsigned int mark_threshold,
+  unsigned char free_cost, unsigned char unknown_cost, unsigned int max_length,
+  int num_threads)
+{
+  const int num_lines = static_cast<int>(endpoints.size() / 3);
+  if (num_threads <= 1 || map_2d == NULL) {
+    for (int i = 0; i < num_lines; ++i) {
+      clearVoxelLineInMap(
+        x0, y0, z0, endpoints[3 * i], endpoints[3 * i + 1], endpoints[3 * i + 2], map_2d,
+        unknown_threshold, mark_threshold, free_cost, unknown_cost, max_length);
+    }
+    return;
+  }
+
+  if (x0 >= size_x_ || y0 >= size_y_ || z0 >= size_z_) {
+    RCLCPP_DEBUG(
+      logger, "Error, line origin out of bounds. (%.2f, %.2f, %.2f),  size: (%d, %d, %d)",
+      x0, y0, z0, size_x_, size_y_, size_z_);
+    return;
+  }
+
+  costmap = map_2d;
+  ClearVoxelInMap cvm(data_, costmap, unknown_threshold, mark_threshold, free_cost, unknown_cost);
+
+  // Clearing only ever removes bits, so once every line is cleared each column holds the
+  // same voxels as after clearing the lines one by one, and the last serial update of a
+  // column's map cell is the one computed from that final column. The lines are therefore
+  // cleared with atomic updates first, and the map cells of the touched columns are set
+  // from the final columns after all threads are done.
+  #pragma omp parallel num_threads(num_threads)
+  {
+    std::vector<unsigned int> touched;
+    AtomicClearVoxel acv(data_, touched);
+
+    #pragma omp for schedule(static)
+    for (int i = 0; i < num_lines; ++i) {
+      double x1 = endpoints[3 * i], y1 = endpoints[3 * i + 1], z1 = endpoints[3 * i + 2];
+      if (x1 >= size_x_ || y1 >= size_y_ || z1 >= size_z_) {
+        continue;
+      }
+      raytraceLine(acv, x0, y0, z0, x1, y1, z1, max_length);
+    }
+
+    // the implicit barrier of the loop above makes every cleared column visible here
+    for (unsigned int offset : touched) {
+      cvm.updateMap(offset, data_[offset]);
+    }
+  }
+}
+
+template<typename ColumnT>
+VoxelStatus VoxelGridT<ColumnT>::getVoxel(unsigned int x, unsigned int y, unsigned int z)
 {
   if (x >= size_x_ || y >= size_y_ || z >= size_z_) {
     RCLCPP_DEBUG(logger, "Error, voxel out of bounds. (%d, %d, %d)\n", x, y, z);
     return UNKNOWN;
   }
-  uint32_t full_mask = ((uint32_t)1 << z << 16) | (1 << z);
-  uint32_t result = data_[y * size_x_ + x] & full_mask;
+  ColumnT result = data_[y * size_x_ + x] & zMask(z);
   unsigned int bits = numBits(result);
 
   // known marked: 11 = 2 bits, unknown: 01 = 1 bit, known free: 00 = 0 bits
@@ -191,7 +248,8 @@ VoxelStatus VoxelGrid::getVoxel(unsigned int x, unsigned int y, unsigned int z)
   return MARKED;
 }
 
-VoxelStatus VoxelGrid::getVoxelColumn(
+template<typename ColumnT>
+VoxelStatus VoxelGridT<ColumnT>::getVoxelColumn(
   unsigned int x, unsigned int y,
   unsigned int unknown_threshold, unsigned int marked_threshold)
 {
@@ -200,40 +258,41 @@ VoxelStatus VoxelGrid::getVoxelColumn(
     return UNKNOWN;
   }
 
-  uint32_t * col = &data_[y * size_x_ + x];
-
-  unsigned int unknown_bits = uint16_t(*col >> 16) ^ uint16_t(*col);
-  unsigned int marked_bits = *col >> 16;
+  ColumnT col = data_[y * size_x_ + x];
 
   // check if the number of marked bits qualifies the col as marked
-  if (!bitsBelowThreshold(marked_bits, marked_threshold)) {
+  if (!bitsBelowThreshold(markedBits(col), marked_threshold)) {
     return MARKED;
   }
 
   // check if the number of unkown bits qualifies the col as unknown
-  if (!bitsBelowThreshold(unknown_bits, unknown_threshold)) {
+  if (!bitsBelowThreshold(unknownBits(col), unknown_threshold)) {
     return UNKNOWN;
   }
 
   return FREE;
 }
 
-unsigned int VoxelGrid::sizeX()
+template<typename ColumnT>
+unsigned int VoxelGridT<ColumnT>::sizeX()
 {
   return size_x_;
 }
 
-unsigned int VoxelGrid::sizeY()
+template<typename ColumnT>
+unsigned int VoxelGridT<ColumnT>::sizeY()
 {
   return size_y_;
 }
 
-unsigned int VoxelGrid::sizeZ()
+template<typename ColumnT>
+unsigned int VoxelGridT<ColumnT>::sizeZ()
 {
   return size_z_;
 }
 
-void VoxelGrid::printVoxelGrid()
+template<typename ColumnT>
+void VoxelGridT<ColumnT>::printVoxelGrid()
 {
   for (unsigned int z = 0; z < size_z_; z++) {
     printf("Layer z = %u:\n", z);
@@ -246,14 +305,18 @@ void VoxelGrid::printVoxelGrid()
   }
 }
 
-void VoxelGrid::printColumnGrid()
+template<typename ColumnT>
+void VoxelGridT<ColumnT>::printColumnGrid()
 {
   printf("Column view:\n");
   for (unsigned int y = 0; y < size_y_; y++) {
     for (unsigned int x = 0; x < size_x_; x++) {
-      printf((getVoxelColumn(x, y, 16, 0) == nav2_voxel_grid::MARKED) ? "#" : " ");
+      printf((getVoxelColumn(x, y, MAX_SIZE_Z, 0) == nav2_voxel_grid::MARKED) ? "#" : " ");
     }
     printf("|\n");
   }
 }
+
+template class VoxelGridT<uint32_t>;
+template class VoxelGridT<uint64_t>;
 }  // namespace nav2_voxel_grid
@@ -37,6 +37,8 @@
 #include <nav2_voxel_grid/voxel_grid.hpp>
 #include <gtest/gtest.h>
 
+#include <vector>
+
 TEST(voxel_grid, basicMarkingAndClearing) {
   int size_x = 50, size_y = 10, size_z = 16;
   nav2_voxel_grid::VoxelGrid vg(size_x, size_y, size_z);
@@ -187,6 +189,50 @@ TEST(voxel_grid, GetVoxelData) {
   delete[] data;
 }
 
+TEST(voxel_grid, TallColumns) {
+  int size_x = 10, size_y = 10, size_z = 32;
+  nav2_voxel_grid::VoxelGrid64 vg(size_x, size_y, size_z);
+  EXPECT_EQ(vg.sizeZ(), 32u);
+
+  vg.markVoxelLine(0, 0, 0, 0, 0, 31);
+  for (unsigned int i = 0; i < vg.sizeZ(); ++i) {
+    EXPECT_EQ(vg.getVoxel(0, 0, i), nav2_voxel_grid::MARKED);
+  }
+  EXPECT_EQ(vg.getVoxel(1, 0, 31), nav2_voxel_grid::UNKNOWN);
+  EXPECT_EQ(vg.getVoxelColumn(0, 0, 0, 31), nav2_voxel_grid::MARKED);
+
+  vg.clearVoxelLine(0, 0, 0, 0, 0, 31);
+  for (unsigned int i = 0; i < vg.sizeZ(); ++i) {
+    EXPECT_EQ(vg.getVoxel(0, 0, i), nav2_voxel_grid::FREE);
+  }
+}
+
+TEST(voxel_grid, clearVoxelLinesInMapMatchesSerial) {
+  int size_x = 40, size_y = 40, size_z = 16;
+  nav2_voxel_grid::VoxelGrid serial(size_x, size_y, size_z);
+  nav2_voxel_grid::VoxelGrid parallel(size_x, size_y, size_z);
+
+  std::vector<double> endpoints;
+  for (int i = 0; i < size_x; ++i) {
+    for (int k = 0; k < size_z; k += 3) {
+      serial.markVoxel(i, size_y - 1, k);
+      parallel.markVoxel(i, size_y - 1, k);
+      endpoints.insert(endpoints.end(), {i + 0.5, size_y - 0.5, k + 0.5});
+    }
+  }
+
+  std::vector<unsigned char> serial_map(size_x * size_y, 254);
+  std::vector<unsigned char> parallel_map(size_x * size_y, 254);
+  serial.clearVoxelLinesInMap(0.5, 0.5, 8.5, endpoints, serial_map.data(), 16, 0, 0, 255);
+  parallel.clearVoxelLinesInMap(
+    0.5, 0.5, 8.5, endpoints, parallel_map.data(), 16, 0, 0, 255, UINT_MAX, 4);
+
+  EXPECT_EQ(serial_map, parallel_map);
+  for (int i = 0; i < size_x * size_y; ++i) {
+    EXPECT_EQ(serial.getData()[i], parallel.getData()[i]);
+  }
+}
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -114,6 +114,7 @@ protected:
   nav2_util::LifecycleNode::SharedPtr _node;
   nav2_costmap_2d::Costmap2D * _costmap;
   std::unique_ptr<CostmapDownsampler> _costmap_downsampler;
+  nav2_costmap_2d::CostmapPyramid * _costmap_pyramid;
   std::string _global_frame, _name;
   float _tolerance;
   int _downsampling_factor;
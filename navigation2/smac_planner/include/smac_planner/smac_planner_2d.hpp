@@ -106,6 +106,7 @@ protected:
   std::unique_ptr<Smoother> _smoother;
   nav2_costmap_2d::Costmap2D * _costmap;
   std::unique_ptr<CostmapDownsampler> _costmap_downsampler;
+  nav2_costmap_2d::CostmapPyramid * _costmap_pyramid;
   nav2_util::LifecycleNode::SharedPtr _node;
   std::string _global_frame, _name;
   float _tolerance;
@@ -31,6 +31,7 @@ SmacPlanner2D::SmacPlanner2D()
   _smoother(nullptr),
   _costmap(nullptr),
   _costmap_downsampler(nullptr),
+  _costmap_pyramid(nullptr),
   _node(nullptr)
 {
 }
@@ -130,7 +131,20 @@ void SmacPlanner2D::configure(
     _smoother->initialize(_optimizer_params);
   }
 
-  if (_downsample_costmap && _downsampling_factor > 1) {
+  // Reuse the costmap's max-pooled pyramid when it has our downsampling factor,
+  // it is then kept up to date with the costmap rather than rebuilt per plan
+  _costmap_pyramid = costmap_ros->getCostmapPyramid();
+  if (!_downsample_costmap || _downsampling_factor <= 1 ||
+    (_costmap_pyramid && !_costmap_pyramid->getLevelForFactor(_downsampling_factor)))
+  {
+    _costmap_pyramid = nullptr;
+  }
+
+  if (_costmap_pyramid) {
+    RCLCPP_INFO(
+      _node->get_logger(), "Using costmap pyramid level for downsampling factor %i",
+      _downsampling_factor);
+  } else if (_downsample_costmap && _downsampling_factor > 1) {
     std::string topic_name = "downsampled_costmap";
     _costmap_downsampler = std::make_unique<CostmapDownsampler>(_node);
     _costmap_downsampler->initialize(_global_frame, topic_name, _costmap, _downsampling_factor);
@@ -177,6 +191,7 @@ void SmacPlanner2D::cleanup()
   _a_star.reset();
   _smoother.reset();
   _costmap_downsampler.reset();
+  _costmap_pyramid = nullptr;
   _raw_plan_publisher.reset();
 }
 
@@ -190,7 +205,9 @@ nav_msgs::msg::Path SmacPlanner2D::createPlan(
 
   // Downsample costmap, if required
   nav2_costmap_2d::Costmap2D * costmap = _costmap;
-  if (_costmap_downsampler) {
+  if (_costmap_pyramid) {
+    costmap = _costmap_pyramid->getLevelForFactor(_downsampling_factor);
+  } else if (_costmap_downsampler) {
     costmap = _costmap_downsampler->downsample(_downsampling_factor);
   }
 